@@ -0,0 +1,226 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - build_pipeline.h
+
+    This header declares the parallel feature-extraction pipeline used by
+    build_db: decoder threads, a feature worker pool, and a single writer
+    that appends rows in input order. Input files come from a list, or are
+    streamed in batches from a directory scan or manifest (dir_scan.h) so
+    decoding starts before the listing ends. Images can be decoded at reduced
+    resolution (decode_image) for features that tolerate it.
+*/
+
+#ifndef BUILD_PIPELINE_H
+#define BUILD_PIPELINE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "dir_scan.h"
+#include "feature_db.h"
+#include "task_registry.h"
+#include "work_queue.h"
+
+/*
+    BuildOptions
+
+    Pipeline settings. threads <= 1 runs everything on the calling thread.
+    decode_scale > 1 shrinks every image by that factor while decoding.
+*/
+struct BuildOptions {
+    int threads = 1;
+    bool verbose = false;
+    int decode_scale = 1; // 1, 2, 4 or 8
+};
+
+/*
+    BuildStats
+
+    Per-stage counters. Stage seconds are summed over that stage's threads,
+    so busy/wall shows how many cores a stage kept occupied.
+*/
+struct BuildStats {
+    size_t decoded = 0;
+    size_t extracted = 0;
+    size_t written = 0;
+    size_t skipped = 0;
+    double decode_sec = 0.0;
+    double feature_sec = 0.0;
+    double write_sec = 0.0;
+    double wall_sec = 0.0;
+};
+
+/*
+    UpdateStats
+
+    Row counts for an incremental rebuild.
+*/
+struct UpdateStats {
+    size_t reused = 0;  // unchanged files, rows copied from the old database
+    size_t changed = 0; // stamp differs, re-extracted
+    size_t added = 0;   // not in the old database, extracted
+    size_t dropped = 0; // old rows whose files are gone
+};
+
+/*
+    DecodeShift
+
+    How far one task's features move when images are decoded at the
+    task's reduced scale instead of full resolution, over a sample.
+*/
+struct DecodeShift {
+    int task_id = 0;
+    int scale = 1;              // reduced decode factor
+    size_t images = 0;          // samples with a feature both ways
+    double mean_abs = 0.0;      // mean |reduced - full| per value
+    double max_abs = 0.0;       // largest |reduced - full| of any value
+    double mean_dist = 0.0;     // mean task distance, reduced vs full
+    double max_dist = 0.0;      // largest task distance, reduced vs full
+    double neighbor_dist = 0.0; // mean full-res distance between samples
+    double full_sec = 0.0;      // decode seconds at full resolution
+    double reduced_sec = 0.0;   // decode seconds at the reduced scale
+};
+
+/*
+    decode_image
+
+    Decode an image file as build_db does: unchanged at full resolution,
+    or shrunk by `scale` while decoding (JPEG DCT scaling), which always
+    yields 3-channel BGR. EXIF orientation is ignored either way.
+
+    Arguments:
+        const std::string &path - image file.
+        int scale - 1, 2, 4 or 8 (other values decode at full size).
+
+    Returns:
+        decoded image, empty on failure.
+*/
+cv::Mat decode_image(const std::string &path, int scale);
+
+/*
+    extract_features
+
+    Decode every file, compute its task feature, and append the rows to
+    `db` in the order of `files` (failed images are skipped).
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - filenames relative to dir.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        FeatureDB &db - database to append to.
+        BuildStats &stats - output stage counters.
+
+    Returns:
+        void.
+*/
+void extract_features(const std::string &dir,
+                      const std::vector<std::string> &files,
+                      const TaskSpec &spec, const BuildOptions &opt,
+                      FeatureDB &db, BuildStats &stats);
+
+/*
+    extract_features_stream
+
+    Like extract_features, but take the files from batches streamed by
+    scan_image_files or read_manifest, starting as soon as the first batch
+    arrives. Rows are sorted by filename at the end, so the database
+    matches a build from the sorted listing.
+
+    Arguments:
+        const std::string &dir - image directory.
+        WorkQueue<PathBatch> &batches - paths relative to dir; read until
+            the producer closes it.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        FeatureDB &db - database to append to (empty on entry).
+        BuildStats &stats - output stage counters.
+
+    Returns:
+        void.
+*/
+void extract_features_stream(const std::string &dir,
+                             WorkQueue<PathBatch> &batches,
+                             const TaskSpec &spec, const BuildOptions &opt,
+                             FeatureDB &db, BuildStats &stats);
+
+/*
+    update_features
+
+    Incremental build: reuse rows of `old_db` whose file mtime and size are
+    unchanged, extract features only for new or changed files, and drop
+    rows whose files no longer exist. Output rows follow `files` order.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - current filenames.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        const FeatureDBView &old_db - previous database (may be empty).
+        FeatureDB &db - output database (empty on entry).
+        BuildStats &stats - stage counters for the extracted subset.
+        UpdateStats &update - reuse/extract/drop counts.
+
+    Returns:
+        void.
+*/
+void update_features(const std::string &dir,
+                     const std::vector<std::string> &files,
+                     const TaskSpec &spec, const BuildOptions &opt,
+                     const FeatureDBView &old_db, FeatureDB &db,
+                     BuildStats &stats, UpdateStats &update);
+
+/*
+    measure_decode_shift
+
+    Decode `samples` files spread evenly over `files` at full resolution
+    and at each task's decode_scale, both as BGR so only the resolution
+    differs, and compare the features.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - filenames relative to dir.
+        const std::vector<int> &task_ids - tasks with an image feature.
+        size_t samples - files to decode.
+        std::vector<DecodeShift> &shifts - output, one per task.
+
+    Returns:
+        void.
+*/
+void measure_decode_shift(const std::string &dir,
+                          const std::vector<std::string> &files,
+                          const std::vector<int> &task_ids, size_t samples,
+                          std::vector<DecodeShift> &shifts);
+
+/*
+    print_decode_shift
+
+    Print a measure_decode_shift report to stdout.
+
+    Arguments:
+        const std::vector<DecodeShift> &shifts - per-task results.
+
+    Returns:
+        void.
+*/
+void print_decode_shift(const std::vector<DecodeShift> &shifts);
+
+/*
+    print_build_stats
+
+    Print per-stage counts, busy time and throughput to stdout.
+
+    Arguments:
+        const BuildStats &stats - counters from extract_features.
+
+    Returns:
+        void.
+*/
+void print_build_stats(const BuildStats &stats);
+
+#endif // BUILD_PIPELINE_H
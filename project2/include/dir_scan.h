@@ -6,39 +6,137 @@
 
     This header declares directory-scanning helpers for discovering
     image files used by the project’s database build and query tools.
+
+    Scans can recurse into subdirectories, split the tree across threads,
+    and stream the paths they find in batches through a WorkQueue, so the
+    build can start decoding before the listing is finished. Entry types
+    come from readdir's d_type; a file is only stat'ed when the filesystem
+    does not report its type. A manifest (one path per line) can stand in
+    for the scan.
 */
 
 #ifndef DIR_SCAN_H
 #define DIR_SCAN_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "work_queue.h"
+
+/*
+    FileStamp
+
+    File modification time and size, used to detect changed images when
+    rebuilding a database incrementally.
+*/
+struct FileStamp {
+    int64_t mtime_ns;
+    uint64_t size;
+};
+
+/*
+    PathBatch
+
+    A group of image paths, relative to the scanned directory, handed
+    from a scanner to its consumer in one queue operation.
+*/
+using PathBatch = std::vector<std::string>;
+
+/*
+    ScanOptions
+
+    Directory scan settings. Subdirectories are only entered when
+    `recursive` is set; symbolic links are listed but never followed.
+*/
+struct ScanOptions {
+    bool recursive = false;
+    int threads = 1;     // directories scanned in parallel (recursive only)
+    size_t batch = 1024; // paths per PathBatch
+};
+
 /*
     list_image_files
 
-    List image filenames (not full paths) in `dir` and store them in `files`.
+    List image paths relative to `dir` (plain filenames unless recursive)
+    and store them in `files`, in discovery order.
 
     Arguments:
         const std::string &dir - directory path to scan.
-        std::vector<std::string> &files - output list of filenames.
+        const ScanOptions &opt - recursion and threads.
+        std::vector<std::string> &files - output list of paths.
 
     Returns:
-        true on success, false on failure.
+        true on success, false if `dir` cannot be opened.
 */
-bool list_image_files(const std::string &dir, std::vector<std::string> &files);
+bool list_image_files(const std::string &dir, const ScanOptions &opt,
+                      std::vector<std::string> &files);
+
+/*
+    scan_image_files
+
+    Scan `dir` and push the image paths found, relative to `dir`, to
+    `out` in batches as they are discovered. `out` is closed when the
+    scan ends; if the consumer closes it first, the scan stops early.
+
+    Arguments:
+        const std::string &dir - directory path to scan.
+        const ScanOptions &opt - recursion, threads and batch size.
+        WorkQueue<PathBatch> &out - output batches.
+
+    Returns:
+        true on success, false if `dir` cannot be opened.
+*/
+bool scan_image_files(const std::string &dir, const ScanOptions &opt,
+                      WorkQueue<PathBatch> &out);
+
+/*
+    read_manifest
+
+    Stream the paths listed in a manifest file to `out` in batches while
+    reading it. Each line holds one path relative to the image directory;
+    blank lines and lines starting with '#' are skipped. `out` is closed
+    at the end of the file.
+
+    Arguments:
+        const std::string &path - manifest file.
+        size_t batch - paths per PathBatch.
+        WorkQueue<PathBatch> &out - output batches.
+
+    Returns:
+        true on success, false if the manifest cannot be read.
+*/
+bool read_manifest(const std::string &path, size_t batch,
+                   WorkQueue<PathBatch> &out);
 
 /*
     is_image_filename
 
-    Check by filename suffix whether the name appears to be an image file.
+    Check by filename suffix, ignoring case, whether the name appears to
+    be an image file.
 
     Arguments:
-        const std::string &name - filename to test.
+        std::string_view name - filename to test.
 
     Returns:
         true if the filename has a supported image extension.
 */
-bool is_image_filename(const std::string &name);
+bool is_image_filename(std::string_view name);
+
+/*
+    stat_file
+
+    Read the modification time and size of a file.
+
+    Arguments:
+        const std::string &path - file path.
+        FileStamp &stamp - output stamp.
+
+    Returns:
+        true on success, false if the file cannot be stat'ed.
+*/
+bool stat_file(const std::string &path, FileStamp &stamp);
 
 #endif // DIR_SCAN_H
@@ -0,0 +1,231 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - distance_kernels.h
+
+    This header declares the low-level vector kernels behind the distance
+    metrics in ranking.h. Each kernel has scalar, SSE, AVX2 and AVX-512
+    implementations; the fastest one the CPU supports is picked at runtime
+    (CPUID), and the CBIR_SIMD environment variable can force a level
+    ("scalar", "sse", "avx2", "avx512") for comparisons.
+
+    Kernels accumulate in float lanes and combine the lanes with a
+    compensated (Neumaier) sum, so results agree with the double-precision
+    reference loops to within float rounding. The integer kernels for
+    quantized histograms sum exactly, so they agree across ISAs bit for
+    bit.
+*/
+
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+    kernel_ssd
+
+    Sum of squared differences of two float arrays.
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of (a[i] - b[i])^2.
+*/
+float kernel_ssd(const float *a, const float *b, size_t n);
+
+/*
+    kernel_min_sum
+
+    Histogram intersection similarity: sum of element-wise minima.
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of min(a[i], b[i]).
+*/
+float kernel_min_sum(const float *a, const float *b, size_t n);
+
+/*
+    kernel_dot
+
+    Dot product of two float arrays (cosine distance of unit vectors).
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of a[i] * b[i].
+*/
+float kernel_dot(const float *a, const float *b, size_t n);
+
+/*
+    kernel_dot_norms
+
+    Dot product and squared norms in one pass (for cosine distance).
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+        float &dot - output sum of a[i] * b[i].
+        float &na - output sum of a[i]^2.
+        float &nb - output sum of b[i]^2.
+
+    Returns:
+        void.
+*/
+void kernel_dot_norms(const float *a, const float *b, size_t n, float &dot,
+                      float &na, float &nb);
+
+/*
+    kernel_ssd_batch / kernel_min_sum_batch / kernel_dot_batch
+
+    Batched forms of kernel_ssd, kernel_min_sum and kernel_dot: compare
+    the query with n rows of a row-major matrix. Only `len` values of each
+    row are used, starting at `rows`, so callers can score one segment of
+    every row by offsetting both pointers. out[r] is bit-identical to the
+    single-pair kernel on the same data.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_ssd_batch(const float *q, const float *rows, size_t n,
+                      size_t stride, size_t len, float *out);
+void kernel_min_sum_batch(const float *q, const float *rows, size_t n,
+                          size_t stride, size_t len, float *out);
+void kernel_dot_batch(const float *q, const float *rows, size_t n,
+                      size_t stride, size_t len, float *out);
+
+/*
+    kernel_ssd_bounded_batch / kernel_min_sum_bounded_batch
+
+    Early-abandoning forms of kernel_ssd_batch and kernel_min_sum_batch
+    for ranking with a known cut-off. Every 64 values a row's partial sum
+    is checked: SSD stops once it must end above `bound`; the
+    intersection stops once even the query's remaining mass could not
+    lift it to `floor` (values must be non-negative, as histograms are).
+    A row that runs to the end gets the exact unbounded value; a stopped
+    row gets some value past the limit. The checks read the vector
+    accumulators without leaving the SIMD loop.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float bound / floor - limit; rows past it may stop early.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_ssd_bounded_batch(const float *q, const float *rows, size_t n,
+                              size_t stride, size_t len, float bound,
+                              float *out);
+void kernel_min_sum_bounded_batch(const float *q, const float *rows, size_t n,
+                                  size_t stride, size_t len, float floor,
+                                  float *out);
+
+/*
+    kernel_min_sum_u8_batch / kernel_min_sum_u16_batch
+
+    Histogram intersection of quantized histograms: the sum of
+    element-wise minima of integer codes, for n rows of a row-major code
+    matrix. 16-bit codes must not exceed 32767 (the SIMD forms add pairs
+    of minima as signed words). Sums are exact while they fit in 32 bits.
+
+    Arguments:
+        const uint8_t / uint16_t *q - query codes (len values).
+        const uint8_t / uint16_t *rows - first row (segment) of the codes.
+        size_t n - number of rows.
+        size_t stride - codes between consecutive rows.
+        size_t len - codes compared per row.
+        uint32_t *out - output, one sum per row.
+
+    Returns:
+        void.
+*/
+void kernel_min_sum_u8_batch(const uint8_t *q, const uint8_t *rows, size_t n,
+                             size_t stride, size_t len, uint32_t *out);
+void kernel_min_sum_u16_batch(const uint16_t *q, const uint16_t *rows,
+                              size_t n, size_t stride, size_t len,
+                              uint32_t *out);
+
+/*
+    kernel_dot_norms_batch
+
+    Batched form of kernel_dot_norms over n rows of a row-major matrix.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *dot - output dot products, one per row.
+        float &nq - output squared norm of the query.
+        float *nr - output squared norms of the rows.
+
+    Returns:
+        void.
+*/
+void kernel_dot_norms_batch(const float *q, const float *rows, size_t n,
+                            size_t stride, size_t len, float *dot, float &nq,
+                            float *nr);
+
+/*
+    kernel_dot_tile
+
+    Dot products of a tile of queries with a tile of rows, the inner
+    kernel of multi-query ranking (a small matrix product). The AVX2 and
+    AVX-512 variants work in 2 x 2 register blocks so each load feeds two
+    products; every value is bit-identical to kernel_dot on the same pair.
+
+    Arguments:
+        const float *q - first query.
+        size_t nq - number of queries.
+        size_t q_stride - floats between consecutive queries.
+        const float *rows - first row.
+        size_t nr - number of rows.
+        size_t r_stride - floats between consecutive rows.
+        size_t len - values per dot product.
+        float *out - output, out[i * ldo + j] = q_i . row_j.
+        size_t ldo - floats between consecutive output rows.
+
+    Returns:
+        void.
+*/
+void kernel_dot_tile(const float *q, size_t nq, size_t q_stride,
+                     const float *rows, size_t nr, size_t r_stride,
+                     size_t len, float *out, size_t ldo);
+
+/*
+    distance_kernel_isa
+
+    Name of the instruction set the kernels dispatch to.
+
+    Returns:
+        "avx512", "avx2", "sse" or "scalar".
+*/
+const char *distance_kernel_isa();
+
+#endif // DISTANCE_KERNELS_H
@@ -0,0 +1,392 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - feature_db.h
+
+    This header declares the binary feature database used by the build and
+    query tools, plus CSV import/export so existing databases keep working.
+    Query tools map binary databases read-only and rank directly against
+    the mapped matrix (see map_feature_db).
+
+    File layout (little-endian, native float):
+        [FeatureDBHeader, 128 bytes]
+        [name offsets: uint64 x (rows + 1), relative to the packed names]
+        [packed names: names_bytes chars, no terminators]
+        [padding up to a 64-byte boundary]
+        [feature matrix: rows x dim floats, row-major]
+        [file stamps: rows x FileStamp, version 2+, optional]
+        [row norms: rows x float, if FDB_FLAG_NORMALIZED]
+
+    Databases of cosine-compared embeddings can be stored L2-normalized
+    (FDB_FLAG_NORMALIZED): every row has unit length and its original norm
+    is kept in the norms section. Cosine distances are unchanged, so older
+    readers that ignore the flag still rank correctly; newer ones rank
+    with a plain dot product.
+
+    Databases built from reduced-resolution decodes (build_db --reduced)
+    record the downscale factor, so queries decode targets the same way.
+    Older files leave the field zero, which reads as full resolution.
+*/
+
+#ifndef FEATURE_DB_H
+#define FEATURE_DB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dir_scan.h"
+
+// magic bytes at the start of every binary feature database
+#define FDB_MAGIC "CBIRFDB"
+#define FDB_VERSION 2
+#define FDB_ALIGN 64
+
+// FeatureDBHeader::flags bits
+#define FDB_FLAG_NORMALIZED 0x1u // rows have unit L2 norm; norms stored
+
+/*
+    FeatureDBHeader
+
+    On-disk header of a binary feature database (fixed 128 bytes).
+*/
+struct FeatureDBHeader {
+    char magic[8];          // FDB_MAGIC, NUL padded
+    uint32_t version;       // FDB_VERSION
+    int32_t task_id;        // task that produced the features (0 = unknown)
+    uint32_t dim;           // floats per row
+    uint32_t flags;         // FDB_FLAG_* bits
+    uint64_t rows;          // number of rows
+    uint64_t names_offset;  // file offset of the name offset table
+    uint64_t names_bytes;   // size of the packed name characters
+    uint64_t matrix_offset; // file offset of the matrix (FDB_ALIGN aligned)
+    uint64_t stamps_offset; // file offset of per-row FileStamps, 0 if none
+    uint64_t norms_offset;  // file offset of per-row norms, 0 if none
+    uint32_t decode_scale;  // images shrunk this much at decode, 0/1 = none
+    uint32_t reserved32;
+    uint64_t reserved[6];
+};
+
+static_assert(sizeof(FeatureDBHeader) == 128, "FeatureDBHeader must be 128B");
+
+/*
+    FeatureDB
+
+    In-memory feature database. Names are packed into one string with an
+    offset table, and all feature rows share one contiguous row-major
+    matrix, mirroring the on-disk layout.
+*/
+struct FeatureDB {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t rows = 0;
+    std::vector<uint64_t> name_offsets{0}; // rows + 1 entries
+    std::string name_chars;
+    std::vector<float> data; // rows * dim floats
+    std::vector<FileStamp> stamps; // one per row, or empty if unknown
+    bool normalized = false;       // rows scaled to unit L2 norm
+    std::vector<float> norms;      // original row norms if normalized
+    int decode_scale = 1;          // image downscale used at decode
+};
+
+/*
+    FeatureDBView
+
+    Read-only view of a database's names and matrix. The pointers refer
+    either into a memory-mapped file or into a FeatureDB's storage.
+*/
+struct FeatureDBView {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t rows = 0;
+    const uint64_t *name_offsets = nullptr; // rows + 1 entries
+    const char *name_chars = nullptr;
+    const float *data = nullptr; // rows * dim floats
+    const FileStamp *stamps = nullptr; // rows entries, or nullptr
+    bool normalized = false;           // rows scaled to unit L2 norm
+    const float *norms = nullptr;      // original row norms if normalized
+    int decode_scale = 1;              // image downscale used at decode
+};
+
+/*
+    MappedFeatureDB
+
+    An opened database: a read-only mmap of a binary file, or, for CSV
+    input, an in-memory FeatureDB. Either way `view` is what queries use.
+    Unmapped automatically on destruction.
+*/
+struct MappedFeatureDB {
+    FeatureDBView view;
+    FeatureDB owned; // CSV fallback storage
+    void *map_base = nullptr;
+    size_t map_length = 0;
+
+    MappedFeatureDB() = default;
+    MappedFeatureDB(const MappedFeatureDB &) = delete;
+    MappedFeatureDB &operator=(const MappedFeatureDB &) = delete;
+    ~MappedFeatureDB();
+};
+
+/*
+    feature_db_append
+
+    Append one row to the database. The first row fixes the dimension.
+
+    Arguments:
+        FeatureDB &db - database to append to.
+        const std::string &name - image filename.
+        const std::vector<float> &feat - feature vector.
+
+    Returns:
+        true on success, false if the dimension does not match.
+*/
+bool feature_db_append(FeatureDB &db, const std::string &name,
+                       const std::vector<float> &feat);
+
+/*
+    feature_db_append_row
+
+    Append one row from a raw pointer, optionally with the source file's
+    stamp. Stamps are kept only while every row has one. Rows appended to
+    a normalized database are normalized.
+
+    Arguments:
+        FeatureDB &db - database to append to.
+        std::string_view name - image filename.
+        const float *feat - dim feature values.
+        size_t dim - number of values.
+        const FileStamp *stamp - file stamp, or nullptr if unknown.
+
+    Returns:
+        true on success, false if the dimension does not match.
+*/
+bool feature_db_append_row(FeatureDB &db, std::string_view name,
+                           const float *feat, size_t dim,
+                           const FileStamp *stamp);
+
+/*
+    normalize_l2
+
+    Scale a vector to unit L2 norm in place (a zero vector is left as is).
+
+    Arguments:
+        float *v - vector to scale.
+        size_t dim - number of values.
+
+    Returns:
+        the vector's norm before scaling.
+*/
+float normalize_l2(float *v, size_t dim);
+
+/*
+    feature_db_normalize
+
+    Scale every row of a database to unit L2 norm, recording the original
+    norms, and mark it normalized. Rows appended later are normalized as
+    they are added. Only meaningful for cosine-compared features.
+
+    Arguments:
+        FeatureDB &db - database to normalize.
+
+    Returns:
+        void.
+*/
+void feature_db_normalize(FeatureDB &db);
+
+/*
+    feature_db_name
+
+    Return the filename of row i (view into the packed name storage).
+
+    Arguments:
+        const FeatureDB &db - database.
+        size_t i - row index.
+
+    Returns:
+        filename view, valid while the database is unchanged.
+*/
+std::string_view feature_db_name(const FeatureDB &db, size_t i);
+
+/*
+    feature_db_row
+
+    Return a pointer to the dim floats of row i.
+
+    Arguments:
+        const FeatureDB &db - database.
+        size_t i - row index.
+
+    Returns:
+        pointer to the first feature value of the row.
+*/
+const float *feature_db_row(const FeatureDB &db, size_t i);
+
+/*
+    feature_db_find
+
+    Find the row index of a filename (linear scan).
+
+    Arguments:
+        const FeatureDB &db - database.
+        std::string_view name - filename to look up.
+        size_t &index - output row index.
+
+    Returns:
+        true if found, false otherwise.
+*/
+bool feature_db_find(const FeatureDB &db, std::string_view name,
+                     size_t &index);
+
+/*
+    feature_db_view
+
+    Build a read-only view over an in-memory database.
+
+    Arguments:
+        const FeatureDB &db - database (must outlive the view).
+
+    Returns:
+        view of the database.
+*/
+FeatureDBView feature_db_view(const FeatureDB &db);
+
+/*
+    feature_db_name / feature_db_row / feature_db_find (view overloads)
+
+    Same as the FeatureDB versions, but over a view (e.g. a mapped file).
+*/
+std::string_view feature_db_name(const FeatureDBView &db, size_t i);
+const float *feature_db_row(const FeatureDBView &db, size_t i);
+bool feature_db_find(const FeatureDBView &db, std::string_view name,
+                     size_t &index);
+
+/*
+    is_feature_db_file
+
+    Check whether a file starts with the binary feature database magic.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true if the file is a binary feature database.
+*/
+bool is_feature_db_file(const std::string &path);
+
+/*
+    write_feature_db
+
+    Write a database in the binary format.
+
+    Arguments:
+        const std::string &path - output file path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_feature_db(const std::string &path, const FeatureDB &db);
+
+/*
+    read_feature_db
+
+    Read a binary feature database into memory.
+
+    Arguments:
+        const std::string &path - input file path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_feature_db(const std::string &path, FeatureDB &db);
+
+/*
+    read_csv_db
+
+    Import a CSV feature file (filename,f1,f2,...). Rows whose dimension
+    differs from the first valid row are skipped.
+
+    Arguments:
+        const std::string &path - input CSV path.
+        FeatureDB &db - output database (task id left at 0).
+
+    Returns:
+        true on success, false if the file cannot be opened or has no rows.
+*/
+bool read_csv_db(const std::string &path, FeatureDB &db);
+
+/*
+    write_csv_db
+
+    Export a database as CSV rows (filename,f1,f2,...).
+
+    Arguments:
+        const std::string &path - output CSV path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_csv_db(const std::string &path, const FeatureDB &db);
+
+/*
+    load_feature_db
+
+    Load a database from either format, detected by the file magic.
+
+    Arguments:
+        const std::string &path - binary database or CSV path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool load_feature_db(const std::string &path, FeatureDB &db);
+
+/*
+    map_feature_db
+
+    Open a database for querying. Binary files are mmap'ed read-only and
+    used in place (no copy, no parsing); CSV files are loaded into memory.
+
+    Arguments:
+        const std::string &path - binary database or CSV path.
+        MappedFeatureDB &db - output handle; db.view is set on success.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool map_feature_db(const std::string &path, MappedFeatureDB &db);
+
+/*
+    unmap_feature_db
+
+    Release a mapping or in-memory fallback and reset the view.
+
+    Arguments:
+        MappedFeatureDB &db - handle to release.
+
+    Returns:
+        void.
+*/
+void unmap_feature_db(MappedFeatureDB &db);
+
+/*
+    save_feature_db
+
+    Save a database, choosing CSV for a ".csv" path and binary otherwise.
+
+    Arguments:
+        const std::string &path - output path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool save_feature_db(const std::string &path, const FeatureDB &db);
+
+#endif // FEATURE_DB_H
@@ -52,7 +52,7 @@ bool compute_task2_feature(const cv::Mat &img,
     Arguments:
         const cv::Mat &img - input image (BGR).
         std::vector<float> &feat - output feature vector.
-        int bins - number of bins per channel.
+        int bins - number of bins per channel (1..256).
 
     Returns:
         true on success, false on failure.
@@ -78,10 +78,11 @@ bool compute_task3_feature(const cv::Mat &img, std::vector<float> &feat);
     compute_task4_feature
 
     Task 4 feature: whole-image color histogram plus texture histograms
-    (magnitude and orientation).
+    (magnitude and orientation), computed in two walks over the rows: the
+    first finds the largest gradient magnitude the second normalizes by.
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
+        const cv::Mat &img - input image (BGR, 8-bit).
         std::vector<float> &feat - output feature vector.
 
     Returns:
@@ -0,0 +1,156 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - hnsw.h
+
+    This header declares a Hierarchical Navigable Small World (HNSW) graph
+    index over the rows of a feature database, used for approximate
+    nearest-neighbor search on Task 5 embeddings. The index stores only
+    the graph; vectors are read from the (mapped) database it was built
+    from, and distances come from the task's batch distance function, so
+    a returned distance equals the brute-force one for the same row.
+
+    File layout (little-endian):
+        [HnswHeader, 64 bytes]
+        [levels: rows x uint8, top level of each node]
+        [level 0 links: rows x (1 + 2M) uint32, count then neighbor ids]
+        [upper links: for each node, levels[i] x (1 + M) uint32]
+*/
+
+#ifndef HNSW_H
+#define HNSW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "feature_db.h"
+#include "search.h"
+
+// magic bytes at the start of every HNSW index file
+#define HNSW_MAGIC "CBIRHNS"
+#define HNSW_VERSION 1
+
+/*
+    HnswHeader
+
+    On-disk header of an HNSW index (fixed 64 bytes).
+*/
+struct HnswHeader {
+    char magic[8];            // HNSW_MAGIC, NUL padded
+    uint32_t version;         // HNSW_VERSION
+    int32_t task_id;          // task of the indexed database
+    uint32_t dim;             // feature dimension of the indexed database
+    uint32_t M;               // links per node on upper levels (2M on 0)
+    uint64_t rows;            // rows of the indexed database
+    uint32_t ef_construction; // build-time candidate list size
+    int32_t max_level;        // top level of the graph, -1 if empty
+    uint32_t entry;           // entry point node
+    uint32_t reserved[5];
+};
+
+static_assert(sizeof(HnswHeader) == 64, "HnswHeader must be 64 bytes");
+
+/*
+    HnswParams
+
+    Build settings. Larger M and ef_construction give a better graph
+    (higher recall for the same efSearch) at the cost of build time and
+    index size.
+*/
+struct HnswParams {
+    size_t M = 16;
+    size_t ef_construction = 200;
+    uint64_t seed = 42; // level assignment, fixed for reproducible builds
+};
+
+/*
+    HnswIndex
+
+    In-memory HNSW graph. Node ids are database row indices.
+*/
+struct HnswIndex {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t rows = 0;
+    size_t M = 16;
+    size_t ef_construction = 200;
+    int max_level = -1;
+    uint32_t entry = 0;
+    std::vector<uint8_t> levels;              // top level of each node
+    std::vector<uint32_t> links0;             // rows x (1 + 2M)
+    std::vector<std::vector<uint32_t>> upper; // per node: levels x (1 + M)
+};
+
+/*
+    hnsw_build
+
+    Build an HNSW graph over every row of a database.
+
+    Arguments:
+        const FeatureDBView &db - database to index.
+        BatchDistFunc dist - task distance (called with n = 1).
+        const HnswParams &params - build settings.
+        HnswIndex &index - output index.
+
+    Returns:
+        true on success, false if the database is empty or too large.
+*/
+bool hnsw_build(const FeatureDBView &db, BatchDistFunc dist,
+                const HnswParams &params, HnswIndex &index);
+
+/*
+    hnsw_search
+
+    Approximate k nearest rows to a query. The candidate list has
+    max(ef, k + 1) entries; larger ef raises recall and latency.
+
+    Arguments:
+        const HnswIndex &index - index built over `db`.
+        const FeatureDBView &db - database the index was built from.
+        BatchDistFunc dist - task distance (same as at build time).
+        const float *query - query feature (db.dim values).
+        size_t k - number of matches to return.
+        size_t ef - search candidate list size (efSearch).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        number of distance evaluations performed.
+*/
+size_t hnsw_search(const HnswIndex &index, const FeatureDBView &db,
+                   BatchDistFunc dist, const float *query, size_t k,
+                   size_t ef, size_t skip_row,
+                   std::vector<RowMatch> &matches);
+
+/*
+    write_hnsw_index
+
+    Write an index to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const HnswIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_hnsw_index(const std::string &path, const HnswIndex &index);
+
+/*
+    read_hnsw_index
+
+    Read an index from disk.
+
+    Arguments:
+        const std::string &path - input file path.
+        HnswIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_hnsw_index(const std::string &path, HnswIndex &index);
+
+#endif // HNSW_H
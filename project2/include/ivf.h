@@ -0,0 +1,158 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - ivf.h
+
+    This header declares an inverted-file (IVF) index over the rows of a
+    feature database, used to rank histogram features (Tasks 2-4) without
+    scanning every row. k-means centroids split the feature space into
+    nlist cells and each cell keeps a posting list of the rows nearest to
+    it; a query scores the centroids with the task's own distance and
+    scans only the rows of the nprobe closest cells. Vectors are read from
+    the database the index was built from, so a returned distance equals
+    the exhaustive one for the same row.
+
+    File layout (little-endian):
+        [IvfHeader, 64 bytes]
+        [centroids: nlist x dim floats]
+        [list offsets: (nlist + 1) x uint64]
+        [row ids: rows x uint32, grouped by cell, ascending within a cell]
+*/
+
+#ifndef IVF_H
+#define IVF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "feature_db.h"
+#include "search.h"
+#include "task_registry.h"
+
+// magic bytes at the start of every IVF index file
+#define IVF_MAGIC "CBIRIVF"
+#define IVF_VERSION 1
+
+/*
+    IvfHeader
+
+    On-disk header of an IVF index (fixed 64 bytes).
+*/
+struct IvfHeader {
+    char magic[8];    // IVF_MAGIC, NUL padded
+    uint32_t version; // IVF_VERSION
+    int32_t task_id;  // task whose distance assigned the rows
+    uint32_t dim;     // feature dimension of the indexed database
+    uint32_t nlist;   // number of cells
+    uint64_t rows;    // rows of the indexed database
+    uint64_t reserved[4];
+};
+
+static_assert(sizeof(IvfHeader) == 64, "IvfHeader must be 64 bytes");
+
+/*
+    IvfParams
+
+    Build settings. nlist = 0 picks about sqrt(rows) cells; train_rows = 0
+    trains on up to 64 rows per cell, sampled evenly from the database.
+*/
+struct IvfParams {
+    size_t nlist = 0;
+    size_t train_rows = 0;
+    size_t iters = 20;
+    int threads = 1; // assignment threads, <= 0 = all cores
+    uint64_t seed = 42;
+};
+
+/*
+    IvfIndex
+
+    Centroids and per-cell posting lists. Row ids of cell c are
+    ids[offsets[c]] .. ids[offsets[c + 1] - 1].
+*/
+struct IvfIndex {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t nlist = 0;
+    size_t rows = 0;
+    std::vector<float> centroids;  // nlist x dim
+    std::vector<uint64_t> offsets; // nlist + 1
+    std::vector<uint32_t> ids;     // rows
+};
+
+/*
+    ivf_build
+
+    Train centroids on a database (k-means, squared L2) and file every row
+    under the centroid closest to it by the task's distance, the same
+    distance used to choose cells at query time.
+
+    Arguments:
+        const FeatureDBView &db - database to index.
+        const TaskSpec &spec - task whose batch distance assigns rows.
+        const IvfParams &params - build settings.
+        IvfIndex &index - output index.
+
+    Returns:
+        true on success, false if the database is empty or too large for
+        32-bit row ids.
+*/
+bool ivf_build(const FeatureDBView &db, const TaskSpec &spec,
+               const IvfParams &params, IvfIndex &index);
+
+/*
+    ivf_search
+
+    Rank the rows of the nprobe cells closest to a query.
+
+    Arguments:
+        const IvfIndex &index - index over `db`.
+        const FeatureDBView &db - database the index was built from.
+        const TaskSpec &spec - task whose batch distance ranks rows.
+        const std::vector<float> &query - query feature (db.dim values).
+        size_t k - number of matches to return.
+        size_t nprobe - cells to scan (clamped to nlist).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        number of rows scanned.
+*/
+size_t ivf_search(const IvfIndex &index, const FeatureDBView &db,
+                  const TaskSpec &spec, const std::vector<float> &query,
+                  size_t k, size_t nprobe, size_t skip_row,
+                  std::vector<RowMatch> &matches);
+
+/*
+    write_ivf_index
+
+    Write an IVF index to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const IvfIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_ivf_index(const std::string &path, const IvfIndex &index);
+
+/*
+    read_ivf_index
+
+    Read an IVF index from disk, validating offsets and row ids.
+
+    Arguments:
+        const std::string &path - input file path.
+        IvfIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, size, or
+        posting lists).
+*/
+bool read_ivf_index(const std::string &path, IvfIndex &index);
+
+#endif // IVF_H
@@ -0,0 +1,68 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - kmeans.h
+
+    This header declares the k-means clustering used to train the
+    quantizers behind the compressed and partitioned search indexes.
+*/
+
+#ifndef KMEANS_H
+#define KMEANS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    KMeansParams
+
+    Lloyd iteration settings. Centroids are seeded with k-means++ from a
+    fixed seed, so training is reproducible.
+*/
+struct KMeansParams {
+    size_t k = 256;
+    size_t iters = 20;
+    uint64_t seed = 42;
+};
+
+/*
+    kmeans_train
+
+    Cluster n points into k centroids (squared L2 distance). Points are
+    `dim` floats starting every `stride` floats, so one slice of each row
+    of a wider matrix can be clustered in place.
+
+    Arguments:
+        const float *data - first point.
+        size_t n - number of points (must be >= k).
+        size_t dim - values per point.
+        size_t stride - floats between consecutive points.
+        const KMeansParams &params - clustering settings.
+        std::vector<float> &centroids - output, k x dim row-major.
+
+    Returns:
+        true on success, false if there are fewer points than clusters.
+*/
+bool kmeans_train(const float *data, size_t n, size_t dim, size_t stride,
+                  const KMeansParams &params, std::vector<float> &centroids);
+
+/*
+    kmeans_nearest
+
+    Index of the centroid closest to a point (squared L2 distance).
+
+    Arguments:
+        const float *x - point (dim values).
+        const float *centroids - k x dim centroids, row-major.
+        size_t k - number of centroids.
+        size_t dim - values per point.
+
+    Returns:
+        index of the nearest centroid.
+*/
+size_t kmeans_nearest(const float *x, const float *centroids, size_t k,
+                      size_t dim);
+
+#endif // KMEANS_H
@@ -0,0 +1,161 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - pq.h
+
+    This header declares the product-quantized (PQ) embedding store used
+    for compressed Task 5 search. Each embedding is L2-normalized and its
+    dim values are split into m sub-vectors; each sub-vector is replaced
+    by the index of its nearest of 256 trained centroids, so a row costs
+    m bytes (32 or 64 for 512-d embeddings) instead of 4 * dim.
+
+    Queries are not quantized (asymmetric distance): a per-query lookup
+    table holds the dot product of each query sub-vector with every
+    centroid, and a row's approximate cosine similarity is the sum of m
+    table entries. The best candidates can then be re-ranked exactly from
+    the full vectors in the mapped database.
+
+    File layout (little-endian):
+        [PQHeader, 64 bytes]
+        [codebooks: m x 256 x (dim / m) floats]
+        [codes: rows x m uint8]
+*/
+
+#ifndef PQ_H
+#define PQ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "feature_db.h"
+#include "search.h"
+
+// magic bytes at the start of every PQ file
+#define PQ_MAGIC "CBIRPQ"
+#define PQ_VERSION 1
+// centroids per sub-quantizer (one byte per code)
+#define PQ_KSUB 256
+
+/*
+    PQHeader
+
+    On-disk header of a PQ file (fixed 64 bytes).
+*/
+struct PQHeader {
+    char magic[8];     // PQ_MAGIC, NUL padded
+    uint32_t version;  // PQ_VERSION
+    int32_t task_id;   // task of the encoded database
+    uint32_t dim;      // embedding dimension
+    uint32_t m;        // sub-quantizers = bytes per row
+    uint32_t ksub;     // PQ_KSUB
+    uint32_t flags;    // reserved, 0
+    uint64_t rows;     // encoded rows
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(PQHeader) == 64, "PQHeader must be 64 bytes");
+
+/*
+    PQParams
+
+    Training settings. Codebooks are trained on up to train_rows rows
+    sampled evenly from the database; every row is then encoded.
+*/
+struct PQParams {
+    size_t m = 32;
+    size_t train_rows = 20000;
+    size_t iters = 20;
+    int threads = 1; // training/encoding threads, <= 0 = all cores
+    uint64_t seed = 42;
+};
+
+/*
+    PQIndex
+
+    Trained codebooks and the codes of every database row.
+*/
+struct PQIndex {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t m = 0;
+    size_t dsub = 0; // dim / m
+    size_t rows = 0;
+    std::vector<float> codebooks; // m x PQ_KSUB x dsub
+    std::vector<uint8_t> codes;   // rows x m
+};
+
+/*
+    pq_train
+
+    Train codebooks on a database and encode all of its rows.
+
+    Arguments:
+        const FeatureDBView &db - embeddings to encode.
+        const PQParams &params - training settings.
+        PQIndex &index - output index.
+
+    Returns:
+        true on success, false if m does not divide the dimension or
+        there are fewer than 256 rows to train on.
+*/
+bool pq_train(const FeatureDBView &db, const PQParams &params,
+              PQIndex &index);
+
+/*
+    pq_search
+
+    Rank every row by asymmetric (lookup-table) cosine distance, then
+    optionally re-rank the best `rerank` candidates with exact distances
+    from the full vectors.
+
+    Arguments:
+        const PQIndex &index - codes of `db`.
+        const FeatureDBView &db - full embeddings (read only for re-rank).
+        BatchDistFunc dist - exact distance used for re-ranking.
+        const float *query - query embedding (index.dim values).
+        size_t k - number of matches to return.
+        size_t rerank - candidates to re-rank exactly (0 = none; the
+            returned distances are then approximate).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        void.
+*/
+void pq_search(const PQIndex &index, const FeatureDBView &db,
+               BatchDistFunc dist, const float *query, size_t k,
+               size_t rerank, size_t skip_row,
+               std::vector<RowMatch> &matches);
+
+/*
+    write_pq_index
+
+    Write codebooks and codes to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const PQIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_pq_index(const std::string &path, const PQIndex &index);
+
+/*
+    read_pq_index
+
+    Read codebooks and codes from disk.
+
+    Arguments:
+        const std::string &path - input file path.
+        PQIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_pq_index(const std::string &path, PQIndex &index);
+
+#endif // PQ_H
@@ -0,0 +1,272 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - qhist.h
+
+    This header declares the quantized histogram store used for compact
+    Task 2-4 search. Every histogram bin is stored as an 8-bit code, or a
+    16-bit code of at most 15 bits, instead of a float, so a row costs
+    dim or 2 * dim bytes instead of 4 * dim.
+
+    Each histogram segment of the task (one for Task 2, whole and center
+    for Task 3, color, magnitude and orientation for Task 4) has one
+    scale shared by all rows: code = round(value / scale), with the scale
+    set so the largest value in the database maps to the top code. A
+    shared scale keeps min(a, b) in the integer domain, so intersections
+    are summed with integer kernels and scaled once per segment.
+
+    Queries are quantized with the same scales (bins past the top code
+    are clamped, which does not change any minimum). Each bin's minimum
+    is then off by at most scale / 2, so a distance is off by at most the
+    sum over segments of weight * bins * scale / 2; the best candidates
+    can be re-ranked exactly from the float rows.
+
+    The file carries the row names and decode scale of the database it
+    was built from, so it can be queried on its own without re-ranking,
+    and the float database can be dropped.
+
+    File layout (little-endian):
+        [QHistHeader, 64 bytes]
+        [name offsets: uint64 x (rows + 1), relative to the packed names]
+        [packed names: names_bytes chars, no terminators]
+        [codes: rows x dim uint8 or uint16]
+*/
+
+#ifndef QHIST_H
+#define QHIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "feature_db.h"
+#include "search.h"
+
+// magic bytes at the start of every quantized histogram file
+#define QHIST_MAGIC "CBIRQH"
+#define QHIST_VERSION 2
+// most histogram segments of any supported task (Task 4)
+#define QHIST_MAX_SEGMENTS 3
+
+/*
+    QHistHeader
+
+    On-disk header of a quantized histogram file (fixed 64 bytes).
+*/
+struct QHistHeader {
+    char magic[8];      // QHIST_MAGIC, NUL padded
+    uint32_t version;   // QHIST_VERSION
+    int32_t task_id;    // task of the encoded database
+    uint32_t dim;       // histogram bins per row
+    uint32_t bits;      // code width, 8 or 16
+    uint32_t segments;  // histogram segments of the task
+    uint32_t decode_scale; // images shrunk this much at decode, 0/1 = none
+    uint64_t rows;      // encoded rows
+    uint64_t names_bytes; // size of the packed name characters
+    float scales[QHIST_MAX_SEGMENTS]; // value of one code, per segment
+    uint32_t reserved;
+};
+
+static_assert(sizeof(QHistHeader) == 64, "QHistHeader must be 64 bytes");
+
+/*
+    QHistSegment
+
+    One histogram of a task's feature: its bins, its weight in the
+    distance, and the value of one code.
+*/
+struct QHistSegment {
+    size_t offset = 0;
+    size_t len = 0;
+    double weight = 1.0;
+    float scale = 1.0f;
+};
+
+/*
+    QHistIndex
+
+    Segment scales, row names and the codes of every database row. Only
+    the code vector matching `bits` is filled.
+*/
+struct QHistIndex {
+    int task_id = 0;
+    size_t dim = 0;
+    int bits = 8;
+    size_t rows = 0;
+    int decode_scale = 1; // image downscale used at decode
+    std::vector<QHistSegment> segments;
+    std::vector<uint64_t> name_offsets{0}; // rows + 1 entries
+    std::string name_chars;
+    std::vector<uint8_t> codes8;   // rows x dim, bits == 8
+    std::vector<uint16_t> codes16; // rows x dim, bits == 16
+};
+
+/*
+    QHistCheck
+
+    Agreement of quantized and float distances on a sample of queries.
+*/
+struct QHistCheck {
+    size_t queries = 0;      // sampled query rows
+    size_t pairs = 0;        // distances compared
+    double max_error = 0.0;  // largest |quantized - float| distance
+    double mean_error = 0.0; // mean |quantized - float| distance
+    double bound = 0.0;      // guaranteed limit on the error
+    double recall = 1.0;     // top-k overlap of the two rankings
+};
+
+/*
+    qhist_build
+
+    Quantize every row of a Task 2, 3 or 4 histogram database, keeping
+    its row names and decode scale.
+
+    Arguments:
+        const FeatureDBView &db - histograms to encode.
+        int task_id - task of the rows (sets the segment layout).
+        int bits - code width, 8 or 16.
+        QHistIndex &index - output index.
+
+    Returns:
+        true on success, false for an unsupported task, dimension or
+        width, or a negative bin value.
+*/
+bool qhist_build(const FeatureDBView &db, int task_id, int bits,
+                 QHistIndex &index);
+
+/*
+    qhist_error_bound
+
+    Largest possible difference between a quantized and a float distance.
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+
+    Returns:
+        sum over segments of weight * bins * scale / 2.
+*/
+double qhist_error_bound(const QHistIndex &index);
+
+/*
+    qhist_check
+
+    Compare quantized with float distances: rank every row against
+    `queries` rows sampled evenly from the database both ways, and record
+    the distance errors and the top-k recall.
+
+    Arguments:
+        const QHistIndex &index - codes of `db`.
+        const FeatureDBView &db - float histograms.
+        BatchDistFunc dist - the task's float distance.
+        size_t queries - query rows to sample.
+        size_t k - ranking depth for the recall.
+        QHistCheck &check - output statistics.
+
+    Returns:
+        true if every error is within the bound (plus float rounding).
+*/
+bool qhist_check(const QHistIndex &index, const FeatureDBView &db,
+                 BatchDistFunc dist, size_t queries, size_t k,
+                 QHistCheck &check);
+
+/*
+    qhist_search
+
+    Rank every row by quantized distance, then optionally re-rank the best
+    `rerank` candidates with exact distances from the float rows.
+
+    Arguments:
+        const QHistIndex &index - codes of `db`.
+        const FeatureDBView &db - float histograms (read only for re-rank;
+            may be empty when rerank is 0).
+        BatchDistFunc dist - exact distance used for re-ranking.
+        const float *query - query histogram (index.dim values).
+        size_t k - number of matches to return.
+        size_t rerank - candidates to re-rank exactly (0 = none; the
+            returned distances are then approximate).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        void.
+*/
+void qhist_search(const QHistIndex &index, const FeatureDBView &db,
+                  BatchDistFunc dist, const float *query, size_t k,
+                  size_t rerank, size_t skip_row,
+                  std::vector<RowMatch> &matches);
+
+/*
+    qhist_name
+
+    Return the filename of row i (view into the packed name storage).
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+        size_t i - row index.
+
+    Returns:
+        filename view, valid while the index is unchanged.
+*/
+std::string_view qhist_name(const QHistIndex &index, size_t i);
+
+/*
+    qhist_find
+
+    Find the row index of a filename (linear scan).
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+        std::string_view name - filename to look up.
+        size_t &row - output row index.
+
+    Returns:
+        true if found, false otherwise.
+*/
+bool qhist_find(const QHistIndex &index, std::string_view name, size_t &row);
+
+/*
+    is_qhist_file
+
+    Check whether a file starts with the quantized histogram magic.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true if the file is a quantized histogram file.
+*/
+bool is_qhist_file(const std::string &path);
+
+/*
+    write_qhist_index
+
+    Write segment scales, row names and codes to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const QHistIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_qhist_index(const std::string &path, const QHistIndex &index);
+
+/*
+    read_qhist_index
+
+    Read segment scales, row names and codes from disk.
+
+    Arguments:
+        const std::string &path - input file path.
+        QHistIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, task,
+        layout, or size).
+*/
+bool read_qhist_index(const std::string &path, QHistIndex &index);
+
+#endif // QHIST_H
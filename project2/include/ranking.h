@@ -11,6 +11,7 @@
 #ifndef RANKING_H
 #define RANKING_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -24,6 +25,18 @@ struct Match {
     float dist;
 };
 
+/*
+    RowMatch
+
+    Database row index and its distance score. Rankings over a feature
+    database keep only the row index; filenames are looked up for the
+    rows that are actually printed.
+*/
+struct RowMatch {
+    size_t row;
+    float dist;
+};
+
 /*
     ssd_distance
 
@@ -126,6 +139,103 @@ float task4_distance(const std::vector<float> &a, const std::vector<float> &b);
 */
 float cosine_distance(const std::vector<float> &a, const std::vector<float> &b);
 
+/*
+    ssd_distance_batch / hist_intersection_distance_batch /
+    task4_distance_batch / cosine_distance_batch
+
+    Batched forms of the metrics above: distances from one query to n rows
+    stored row-major in one buffer (e.g. a feature database matrix). Each
+    out[r] is bit-identical to the pairwise function on the same row.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void ssd_distance_batch(const float *query, const float *rows, size_t n,
+                        size_t dim, float *out);
+void hist_intersection_distance_batch(const float *query, const float *rows,
+                                      size_t n, size_t dim, float *out);
+void task4_distance_batch(const float *query, const float *rows, size_t n,
+                          size_t dim, float *out);
+void cosine_distance_batch(const float *query, const float *rows, size_t n,
+                           size_t dim, float *out);
+
+/*
+    ssd_distance_bounded_batch / hist_intersection_distance_bounded_batch
+
+    Early-abandoning forms of ssd_distance_batch and
+    hist_intersection_distance_batch for ranking against a known cut-off
+    (the worst distance of a full top-K). A row whose distance is at most
+    `bound` gets the same value as the unbounded form; a row that cannot
+    come in under the bound may stop early and gets some value above it.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float bound - current cut-off distance.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void ssd_distance_bounded_batch(const float *query, const float *rows,
+                                size_t n, size_t dim, float bound,
+                                float *out);
+void hist_intersection_distance_bounded_batch(const float *query,
+                                              const float *rows, size_t n,
+                                              size_t dim, float bound,
+                                              float *out);
+
+/*
+    cosine_unit_distance / cosine_unit_distance_batch
+
+    Cosine distance of vectors already scaled to unit length, where it
+    reduces to 1 - dot product (no norms). Used when an embedding
+    database stores L2-normalized rows; the query must be normalized too.
+
+    Arguments:
+        const float *a / query - first vector (dim values, unit length).
+        const float *b / rows - second vector, or the first of n rows.
+        size_t n - number of rows (batch form).
+        size_t dim - feature dimension.
+        float *out - output distances, one per row (batch form).
+
+    Returns:
+        cosine distance (pairwise form), or void.
+*/
+float cosine_unit_distance(const float *a, const float *b, size_t dim);
+void cosine_unit_distance_batch(const float *query, const float *rows,
+                                size_t n, size_t dim, float *out);
+
+/*
+    task3_multi_hist_distance_batch
+
+    Batched task3_multi_hist_distance with configurable weights.
+
+    Arguments:
+        const float *query - query multi-histogram (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float w_whole - weight for whole-image histogram distance.
+        float w_center - weight for center-region histogram distance.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void task3_multi_hist_distance_batch(const float *query, const float *rows,
+                                     size_t n, size_t dim, float w_whole,
+                                     float w_center, float *out);
+
 /*
     grass_distance
 
@@ -140,4 +250,22 @@ float cosine_distance(const std::vector<float> &a, const std::vector<float> &b);
 */
 float grass_distance(const std::vector<float> &a, const std::vector<float> &b);
 
+/*
+    grass_distance_batch
+
+    Batched grass_distance: query against n 5D rows of a row-major matrix.
+
+    Arguments:
+        const float *query - query grass feature (5 values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension (must be 5).
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void grass_distance_batch(const float *query, const float *rows, size_t n,
+                          size_t dim, float *out);
+
 #endif // RANKING_H
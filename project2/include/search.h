@@ -0,0 +1,177 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - search.h
+
+    This header declares the ranking engine shared by the query tools and
+    the query server: score every row of a feature database against a
+    query vector and keep the best (or worst) K rows. Composite tasks
+    rank several databases, one per fused feature, as one.
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "feature_db.h"
+#include "ranking.h"
+#include "task_registry.h"
+
+// row index meaning "do not skip any row"
+#define NO_ROW ((size_t)-1)
+
+/*
+    RankOptions
+
+    Ranking settings. threads <= 0 uses every hardware thread; small
+    databases are always scanned on the calling thread.
+*/
+struct RankOptions {
+    size_t top_k = 0; // matches to return, 0 = all rows
+    bool bottom = false; // return the largest distances instead
+    int threads = 1;
+    size_t cascade = 0; // composite tasks: rows the first component passes
+                        // on to the others, 0 = all (exact)
+};
+
+/*
+    StageCount
+
+    Rows passing through one component of a composite ranking. Rows not
+    scored were dropped by the component's filter; rows scored but not
+    passed on could not reach the top-K (or fell outside the cascade).
+*/
+struct StageCount {
+    size_t in = 0;     // candidates reaching the component
+    size_t scored = 0; // distances computed
+    size_t out = 0;    // candidates passed on (last: offered to the top-K)
+};
+
+/*
+    rank_database
+
+    Compute the distance from `query` to every row of `db` and return the
+    top_k closest rows (or farthest, with `bottom`), best first. Equal
+    distances are ordered by row index, so the result is the same for any
+    thread count.
+
+    Arguments:
+        const FeatureDBView &db - database to scan.
+        const std::vector<float> &query - query feature (db.dim values).
+        const TaskSpec &spec - task distance functions; the batch form is
+            used when the task provides one.
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        true on success, false if the query dimension does not match.
+*/
+bool rank_database(const FeatureDBView &db, const std::vector<float> &query,
+                   const TaskSpec &spec, size_t skip_row,
+                   const RankOptions &opt, std::vector<RowMatch> &matches);
+
+/*
+    rank_database_batch
+
+    Rank many queries against the same database. Equivalent to calling
+    rank_database once per query, but for a cosine task on a normalized
+    database all similarities are computed as a tiled matrix product
+    (queries x rows, see kernel_dot_tile): each block of rows is loaded
+    once for a whole tile of queries instead of once per query. Results
+    are identical to the one-query path on the same database. Threads
+    split the queries.
+
+    Arguments:
+        const FeatureDBView &db - database to scan.
+        const std::vector<std::vector<float>> &queries - query features.
+        const TaskSpec &spec - task distance functions.
+        const std::vector<size_t> &skip_rows - row to leave out for each
+            query (NO_ROW for none); empty skips nothing.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<std::vector<RowMatch>> &results - output matches per
+            query, best first.
+
+    Returns:
+        true on success, false if a query dimension does not match.
+*/
+bool rank_database_batch(const FeatureDBView &db,
+                         const std::vector<std::vector<float>> &queries,
+                         const TaskSpec &spec,
+                         const std::vector<size_t> &skip_rows,
+                         const RankOptions &opt,
+                         std::vector<std::vector<RowMatch>> &results);
+
+/*
+    CompositeDB
+
+    The databases of a composite task, one per TaskComponent, with rows
+    matched by filename. Rows of dbs[0] (the base) are the rows ranked
+    and returned; rows[c][i] is the row of base row i in dbs[c], or
+    NO_ROW if that image is missing there (rows[0] is empty).
+*/
+struct CompositeDB {
+    std::vector<const FeatureDBView *> dbs;
+    std::vector<TaskSpec> specs; // get_task of each component
+    std::vector<std::vector<size_t>> rows;
+};
+
+/*
+    composite_db_build
+
+    Check a composite task's databases against its components and match
+    their rows by filename.
+
+    Arguments:
+        const TaskSpec &spec - composite task.
+        const std::vector<const FeatureDBView *> &dbs - one database per
+            component, in component order (must outlive `cdb`).
+        CompositeDB &cdb - output.
+
+    Returns:
+        true on success, false if the task is not composite or a database
+        is missing or has the wrong dimension.
+*/
+bool composite_db_build(const TaskSpec &spec,
+                        const std::vector<const FeatureDBView *> &dbs,
+                        CompositeDB &cdb);
+
+/*
+    rank_composite
+
+    Rank the base rows of a composite task by fused distance: the
+    weighted sum of each component's distance, computed a block of rows
+    at a time in component order. Rows failing a component's filter, or
+    that can no longer reach the top_k, skip the remaining components.
+    Threads, ordering and ties are as in rank_database.
+
+    With opt.cascade = C > 0 the ranking is a cascade: the first
+    component alone ranks every row and only its C best go on to the
+    other components. This bounds the expensive work at C rows but may
+    miss rows the first component ranks poorly; `stages` reports the
+    rows at each component for tuning C against recall.
+
+    Arguments:
+        const CompositeDB &cdb - the task's databases.
+        const std::vector<std::vector<float>> &queries - query feature per
+            component.
+        const TaskSpec &spec - composite task.
+        size_t skip_row - base row to leave out (e.g. the target), or
+            NO_ROW.
+        const RankOptions &opt - top-K, order, thread and cascade settings.
+        std::vector<RowMatch> &matches - output base rows, best first.
+        std::vector<StageCount> &stages - output counts per component.
+
+    Returns:
+        true on success, false if a query dimension does not match.
+*/
+bool rank_composite(const CompositeDB &cdb,
+                    const std::vector<std::vector<float>> &queries,
+                    const TaskSpec &spec, size_t skip_row,
+                    const RankOptions &opt, std::vector<RowMatch> &matches,
+                    std::vector<StageCount> &stages);
+
+#endif // SEARCH_H
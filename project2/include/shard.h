@@ -0,0 +1,225 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - shard.h
+
+    This header declares sharded feature databases: one logical database
+    split into several binary database files plus a small text manifest
+    that lists them. build_db writes shards by filename hash or by row
+    count, and the query tools rank every shard in parallel and merge the
+    per-shard top-K, so a query's latency follows the shard size rather
+    than the corpus size.
+
+    Manifest layout (text, one item per line):
+        CBIRSHARDS 1
+        task <task_id>
+        dim <floats per row>
+        by <hash|count>
+        shards <n>
+        <shard file 0, relative to the manifest's directory>
+        ...
+
+    Every shard's header must match the manifest's task and dimension.
+    Rows get global indices in shard order (shard 0's rows first), so a
+    count-sharded database ranks exactly like the unsharded one, ties
+    included.
+*/
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "feature_db.h"
+#include "search.h"
+#include "task_registry.h"
+
+// first word of every shard manifest
+#define SHARD_MAGIC "CBIRSHARDS"
+#define SHARD_VERSION 1
+
+/*
+    ShardedDB
+
+    An opened sharded database, or a plain database as a single shard.
+    offsets[s] is the global index of shard s's first row; the last entry
+    is the total row count.
+*/
+struct ShardedDB {
+    int task_id = 0;
+    size_t dim = 0;
+    size_t rows = 0;
+    int decode_scale = 1;
+    std::string by; // "hash" or "count", empty for a plain database
+    std::vector<std::unique_ptr<MappedFeatureDB>> shards;
+    std::vector<size_t> offsets{0};
+};
+
+/*
+    shard_of_name
+
+    Shard a filename belongs to under hash sharding (64-bit FNV-1a), so a
+    file stays in the same shard as others are added or removed.
+
+    Arguments:
+        std::string_view name - row filename.
+        size_t shards - number of shards (> 0).
+
+    Returns:
+        shard index in [0, shards).
+*/
+size_t shard_of_name(std::string_view name, size_t shards);
+
+/*
+    split_feature_db
+
+    Partition the rows of a database into `n` shards, keeping row order
+    within each shard. By hash, rows go to shard_of_name; by count, shard
+    s holds the s-th contiguous run of rows, sizes differing by at most 1.
+
+    Arguments:
+        const FeatureDB &db - database to split.
+        size_t n - number of shards (> 0).
+        bool by_hash - hash sharding instead of count sharding.
+        std::vector<FeatureDB> &shards - output shards.
+
+    Returns:
+        void.
+*/
+void split_feature_db(const FeatureDB &db, size_t n, bool by_hash,
+                      std::vector<FeatureDB> &shards);
+
+/*
+    write_sharded_db
+
+    Split a database into `n` binary shard files named <path>.shard<i>
+    and write the manifest to `path`. Every file is written next to its
+    target, and only once all are written are they renamed, the manifest
+    last; shards left over from an earlier split into more files are then
+    removed.
+
+    Arguments:
+        const std::string &path - manifest path.
+        const FeatureDB &db - database to write.
+        size_t n - number of shards (> 0).
+        bool by_hash - hash sharding instead of count sharding.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_sharded_db(const std::string &path, const FeatureDB &db, size_t n,
+                      bool by_hash);
+
+/*
+    remove_stale_shards
+
+    Delete the shard files <path>.shard<keep> onwards, e.g. after `path`
+    was rewritten with fewer shards or as a plain database.
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        size_t keep - number of shards still in use (0 = remove all).
+
+    Returns:
+        void.
+*/
+void remove_stale_shards(const std::string &path, size_t keep);
+
+/*
+    is_shard_manifest
+
+    Check whether a file starts with SHARD_MAGIC.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true for shard manifests.
+*/
+bool is_shard_manifest(const std::string &path);
+
+/*
+    open_sharded_db
+
+    Map every shard listed by a manifest, or a plain database (binary or
+    CSV) as one shard. Each shard's header must match the manifest's task
+    and dimension, and the shards must share a decode scale.
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        ShardedDB &db - output database.
+
+    Returns:
+        true on success, false if a file cannot be read or the shards
+        disagree.
+*/
+bool open_sharded_db(const std::string &path, ShardedDB &db);
+
+/*
+    read_sharded_db
+
+    Read every row of a manifest's shards, or of a plain database, into
+    one in-memory database (shard order).
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool read_sharded_db(const std::string &path, FeatureDB &db);
+
+/*
+    sharded_db_name / sharded_db_row / sharded_db_find
+
+    Filename, feature values, and name lookup by global row index.
+*/
+std::string_view sharded_db_name(const ShardedDB &db, size_t row);
+const float *sharded_db_row(const ShardedDB &db, size_t row);
+bool sharded_db_find(const ShardedDB &db, std::string_view name,
+                     size_t &row);
+
+/*
+    default_shard_threads
+
+    Threads to rank with when the user gives no --threads: one per shard,
+    at most the hardware thread count.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+
+    Returns:
+        thread count (1 for an unsharded database).
+*/
+int default_shard_threads(const ShardedDB &db);
+
+/*
+    rank_sharded
+
+    Rank every shard with rank_database and merge the per-shard top-K.
+    Shards are scanned in parallel, up to opt.threads at a time; a single
+    shard gets all the threads. Matches carry global row indices and ties
+    are ordered by them, so the result does not depend on the threads.
+
+    Arguments:
+        const ShardedDB &db - database to scan.
+        const std::vector<float> &query - query feature (db.dim values).
+        const TaskSpec &spec - task distance functions.
+        size_t skip_row - global row to leave out, or NO_ROW.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        true on success, false if the query dimension does not match.
+*/
+bool rank_sharded(const ShardedDB &db, const std::vector<float> &query,
+                  const TaskSpec &spec, size_t skip_row,
+                  const RankOptions &opt, std::vector<RowMatch> &matches);
+
+#endif // SHARD_H
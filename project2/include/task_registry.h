@@ -5,12 +5,15 @@
     CS5330 Project 2 - task_registry.h
 
     This header defines function pointer types and the task registry used
-    to map task ids to feature and distance implementations.
+    to map task ids to feature and distance implementations. A composite
+    task fuses the distances of several tasks' features (see
+    TaskComponent); search.h ranks both kinds.
 */
 
 #ifndef TASK_REGISTRY_H
 #define TASK_REGISTRY_H
 
+#include <cstddef>
 #include <opencv2/opencv.hpp>
 #include <vector>
 
@@ -43,14 +46,106 @@ using FeatureFunc = bool (*)(const cv::Mat &img, std::vector<float> &feat);
 using DistFunc = float (*)(const std::vector<float> &a,
                            const std::vector<float> &b);
 
+/*
+    BatchDistFunc
+
+    Function pointer type for computing distances from one query to many
+    feature vectors stored row-major in a single buffer.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+using BatchDistFunc = void (*)(const float *query, const float *rows,
+                               size_t n, size_t dim, float *out);
+
+/*
+    BoundedBatchDistFunc
+
+    Function pointer type for a batch distance that may stop early on rows
+    that cannot come in under a cut-off.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float bound - cut-off distance.
+        float *out - output distances; exact where <= bound, otherwise
+            some value above it.
+
+    Returns:
+        void.
+*/
+using BoundedBatchDistFunc = void (*)(const float *query, const float *rows,
+                                      size_t n, size_t dim, float bound,
+                                      float *out);
+
+/*
+    RowFilter
+
+    Function pointer type for a pre-filter on one stored feature row.
+
+    Arguments:
+        const float *row - feature values.
+        size_t dim - number of values.
+
+    Returns:
+        true to keep the row, false to leave it out of the ranking.
+*/
+using RowFilter = bool (*)(const float *row, size_t dim);
+
+/*
+    TaskComponent
+
+    One feature source of a composite task: the features of task
+    `task_id`, compared with that task's distance and scaled by `weight`.
+    The fused distance is the weighted sum over components, accumulated
+    in component order, so cheap components go first: a row failing a
+    filter, or whose partial sum plus the remaining components'
+    `min_dist` bounds already exceeds the current top-K, is dropped
+    before the later components are computed.
+*/
+struct TaskComponent {
+    int task_id;      // task whose features and distance are used
+    size_t dim;       // required feature dimension, 0 = any
+    float weight;     // must be >= 0
+    float min_dist;   // smallest value the task's distance returns
+    RowFilter filter; // rows to keep, or nullptr for all
+};
+
 /*
     TaskSpec
 
     Bundle of feature and distance functions for a specific task.
+    `feature` is nullptr for tasks whose features are precomputed
+    outside this project (Task 5 embeddings). `batch_dist`, when set,
+    must give the same result as `dist` for every row. `unit_batch_dist`
+    is set for cosine tasks: the same distance for unit-length query and
+    rows, used on databases stored L2-normalized. `bounded_batch_dist`,
+    when set, is `batch_dist` with early abandoning: ranking passes the
+    worst distance of a full top-K and rows past it may stop early
+    (monotone metrics: SSD, intersection). `decode_scale` is the largest
+    factor (1, 2, 4 or 8) by which images may be shrunk while decoding
+    for this feature (build_db --reduced); 1 means full resolution only.
+    `components` is empty except for composite tasks, whose ranking fuses
+    the listed sources; the other fields then describe the task's own
+    stored feature.
 */
 struct TaskSpec {
     FeatureFunc feature;
     DistFunc dist;
+    BatchDistFunc batch_dist;
+    BatchDistFunc unit_batch_dist;
+    BoundedBatchDistFunc bounded_batch_dist;
+    int decode_scale;
+    std::vector<TaskComponent> components;
 };
 
 /*
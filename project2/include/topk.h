@@ -0,0 +1,131 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - topk.h
+
+    This header declares the bounded top-K selector used by the ranking
+    engine. Only the K best (row, distance) pairs are kept, in a max-heap
+    keyed on the worst kept match, so scanning N rows costs O(N log K)
+    instead of a full O(N log N) sort, and no filenames are touched until
+    the K winners are printed.
+*/
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <cstddef>
+#include <vector>
+
+#include "ranking.h"
+
+/*
+    TopK
+
+    Keeps the K best matches seen so far. "Best" is the smallest distance,
+    or the largest with `bottom`; equal distances are ordered by row index
+    so the result does not depend on the order rows are pushed in.
+*/
+class TopK {
+  public:
+    /*
+        TopK
+
+        Arguments:
+            size_t k - number of matches to keep (0 keeps every match).
+            bool bottom - keep the largest distances instead of the smallest.
+    */
+    explicit TopK(size_t k, bool bottom = false);
+
+    /*
+        push
+
+        Offer one match; it is kept if it beats the current worst.
+
+        Arguments:
+            size_t row - database row index.
+            float dist - distance of that row.
+
+        Returns:
+            void.
+    */
+    void push(size_t row, float dist) {
+        const RowMatch m{row, dist};
+        if (k_ != 0 && heap_.size() == k_) {
+            if (!better(m, heap_.front()))
+                return;
+            replace_worst(m);
+            return;
+        }
+        insert(m);
+    }
+
+    /*
+        merge
+
+        Offer every match kept by another selector (e.g. a thread's share).
+
+        Arguments:
+            const TopK &other - selector to merge in.
+
+        Returns:
+            void.
+    */
+    void merge(const TopK &other);
+
+    /*
+        full
+
+        Returns:
+            true once K matches are kept (never for k == 0).
+    */
+    bool full() const { return k_ != 0 && heap_.size() == k_; }
+
+    /*
+        worst
+
+        Distance of the worst kept match; only meaningful when full().
+
+        Returns:
+            distance a new match must beat to be kept.
+    */
+    float worst() const { return heap_.front().dist; }
+
+    /*
+        bottom
+
+        Returns:
+            true if the largest distances are kept.
+    */
+    bool bottom() const { return bottom_; }
+
+    /*
+        sorted
+
+        Return the kept matches, best first.
+
+        Arguments:
+            std::vector<RowMatch> &out - output matches.
+
+        Returns:
+            void.
+    */
+    void sorted(std::vector<RowMatch> &out) const;
+
+  private:
+    // a ranks before b: smaller distance (larger if bottom_), then lower row
+    bool better(const RowMatch &a, const RowMatch &b) const {
+        if (a.dist != b.dist)
+            return bottom_ ? a.dist > b.dist : a.dist < b.dist;
+        return a.row < b.row;
+    }
+
+    void insert(const RowMatch &m);
+    void replace_worst(const RowMatch &m);
+
+    size_t k_;
+    bool bottom_;
+    std::vector<RowMatch> heap_; // max-heap by better(): worst at front
+};
+
+#endif // TOPK_H
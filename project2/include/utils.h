@@ -25,4 +25,22 @@
 */
 std::string basename_only(const std::string &path);
 
+/*
+    image_row_name
+
+    Name that build_db gives the image at `path` when it scans
+    `image_dir`: the path relative to image_dir if the image lies inside
+    it (e.g. "sub/b.jpg" for a --recursive build), otherwise the basename.
+
+    Arguments:
+        const std::string &path - image path.
+        const std::string &image_dir - directory the database was built
+            from, or "" if unknown.
+
+    Returns:
+        row name to look the image up by.
+*/
+std::string image_row_name(const std::string &path,
+                           const std::string &image_dir);
+
 #endif // UTILS_H
@@ -0,0 +1,99 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - work_queue.h
+
+    This header defines a small bounded blocking queue used to connect the
+    stages of the parallel database build pipeline.
+*/
+
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/*
+    WorkQueue
+
+    Bounded multi-producer/multi-consumer FIFO. push() blocks while the
+    queue is full; pop() blocks while it is empty and returns false once
+    the queue is closed and drained.
+*/
+template <typename T> class WorkQueue {
+  public:
+    explicit WorkQueue(size_t capacity) : capacity_(capacity) {}
+
+    /*
+        push
+
+        Add an item, waiting for space.
+
+        Arguments:
+            T item - item to enqueue.
+
+        Returns:
+            false if the queue was closed, true otherwise.
+    */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock,
+                       [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+            return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /*
+        pop
+
+        Remove the oldest item, waiting until one is available.
+
+        Arguments:
+            T &item - output item.
+
+        Returns:
+            false once the queue is closed and empty, true otherwise.
+    */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    /*
+        close
+
+        Stop accepting items and wake all waiters.
+
+        Returns:
+            void.
+    */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+  private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+#endif // WORK_QUEUE_H
@@ -4,29 +4,113 @@
 
     CS5330 Project 2 - build_db.cpp
 
-    This file builds a feature database CSV for a specified task by scanning
-    an image directory and computing per-image feature vectors.
+    This file builds a feature database for a specified task by scanning
+    an image directory and computing per-image feature vectors. The output
+    is written as CSV for a ".csv" path and as a binary database otherwise.
+    With --incremental an existing binary database is updated in place:
+    only new or changed images (by mtime and size) are decoded. With
+    --reduced images are shrunk while decoding by the task's decode_scale,
+    and --decode-report measures what that does to every task's features.
+    Files are streamed to the build as they are found; --recursive scans
+    subdirectories (in parallel with --threads), and --manifest reads the
+    file list from a file instead of scanning. --shards N writes N shard
+    files plus a manifest at the output path (see shard.h).
 */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
+#include <sys/stat.h>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include <opencv2/opencv.hpp>
-
-#include "../include/csv_io.h"
+#include "../include/build_pipeline.h"
 #include "../include/dir_scan.h"
-#include "../include/features.h"
+#include "../include/feature_db.h"
+#include "../include/shard.h"
 #include "../include/task_registry.h"
+#include "../include/work_queue.h"
+
+/*
+    list_inputs
+
+    Stream the input paths to `out`: the manifest's lines if one is given,
+    otherwise the images found by scanning the directory. Closes `out`.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::string &manifest - manifest file, or "" to scan.
+        const ScanOptions &scan - scan settings.
+        WorkQueue<PathBatch> &out - output batches.
+
+    Returns:
+        true on success, false if the directory or manifest cannot be read.
+*/
+static bool list_inputs(const std::string &dir, const std::string &manifest,
+                        const ScanOptions &scan, WorkQueue<PathBatch> &out) {
+    if (!manifest.empty())
+        return read_manifest(manifest, scan.batch, out);
+    return scan_image_files(dir, scan, out);
+}
+
+/*
+    collect_inputs
+
+    Gather every input path (see list_inputs) into `files`, sorted, for
+    the modes that need the whole list before they start.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::string &manifest - manifest file, or "" to scan.
+        const ScanOptions &scan - scan settings.
+        std::vector<std::string> &files - output paths.
+
+    Returns:
+        true on success, false if the directory or manifest cannot be read.
+*/
+static bool collect_inputs(const std::string &dir,
+                           const std::string &manifest,
+                           const ScanOptions &scan,
+                           std::vector<std::string> &files) {
+    if (manifest.empty() && !list_image_files(dir, scan, files))
+        return false;
+    if (!manifest.empty()) {
+        WorkQueue<PathBatch> batches(64);
+        bool ok = false;
+        std::thread reader(
+            [&] { ok = read_manifest(manifest, scan.batch, batches); });
+        files.clear();
+        PathBatch batch;
+        while (batches.pop(batch))
+            files.insert(files.end(), batch.begin(), batch.end());
+        reader.join();
+        if (!ok)
+            return false;
+    }
+    // readdir order depends on the filesystem; sort for stable output
+    std::sort(files.begin(), files.end());
+    return true;
+}
 
 /*
     main
 
-    Build a feature database from images in a directory and write to a CSV.
-    Usage: ./build_db <image_dir> <output_csv> [task_id]
+    Build a feature database from images in a directory and write it out.
+    Usage: ./build_db <image_dir> <output_db|output_csv> [task_id]
+                      [--threads N] [--incremental] [--reduced] [--verbose]
+                      [--recursive] [--manifest <file>]
+                      [--shards N [--shard-by hash|count]]
+           ./build_db <image_dir> --decode-report [N]
+    --threads 0 uses every hardware thread; the default is 1. Rows of
+    images in subdirectories (--recursive) are named by their path
+    relative to image_dir, as are manifest entries. --shard-by hash (the
+    default) keeps each file in the same shard across rebuilds; count
+    splits the sorted rows into equal runs. --reduced
+    decodes at the task's decode_scale and records it in the database.
+    --decode-report decodes N sampled images (default 50) both ways and
+    prints how far each task's features move, without building anything.
 
     Arguments:
         int argc - argument count.
@@ -36,23 +120,89 @@
         0 on success, negative value on error.
 */
 int main(int argc, char *argv[]) {
-    if (argc < 3) {
-        std::fprintf(stderr, "usage: %s <directory path> <output csv>\n",
-                     argv[0]);
+    BuildOptions opt;
+    bool incremental = false;
+    bool reduced = false;
+    size_t report_samples = 0;
+    ScanOptions scan;
+    std::string manifest;
+    size_t shards = 1;
+    bool shard_by_hash = true;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            opt.threads = std::atoi(argv[++i]);
+        else if (arg == "--verbose")
+            opt.verbose = true;
+        else if (arg == "--incremental")
+            incremental = true;
+        else if (arg == "--reduced")
+            reduced = true;
+        else if (arg == "--recursive")
+            scan.recursive = true;
+        else if (arg == "--manifest" && i + 1 < argc)
+            manifest = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc)
+            shards = (size_t)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--shard-by" && i + 1 < argc)
+            shard_by_hash = std::string(argv[++i]) != "count";
+        else if (arg == "--decode-report")
+            report_samples = (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+                                 ? (size_t)std::atoi(argv[++i])
+                                 : 50;
+        else
+            args.push_back(arg);
+    }
+
+    if (args.size() < (report_samples > 0 ? 1u : 2u)) {
+        std::fprintf(stderr,
+                     "usage: %s <directory path> <output db|csv> [task_id] "
+                     "[--threads N] [--incremental] [--reduced] "
+                     "[--verbose] [--recursive] [--manifest <file>] "
+                     "[--shards N [--shard-by hash|count]]\n"
+                     "       %s <directory path> --decode-report [N]\n",
+                     argv[0], argv[0]);
         return -1;
     }
+    if (opt.threads <= 0)
+        opt.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    scan.threads = opt.threads;
 
-    const std::string dirname = argv[1];
-    const std::string out_csv = argv[2];
+    const std::string dirname = args[0];
+    const std::string input = manifest.empty() ? dirname : manifest;
 
-    std::ofstream out(out_csv);
-    if (!out.is_open()) {
-        std::cerr << "Cannot open output csv: " << out_csv << "\n";
+    if (report_samples > 0) {
+        std::vector<std::string> files;
+        if (!collect_inputs(dirname, manifest, scan, files)) {
+            std::cerr << "Cannot read " << input << "\n";
+            return -1;
+        }
+        // every task that computes its feature from the image
+        std::vector<int> task_ids;
+        for (int t : {1, 2, 3, 4, 7})
+            if (get_task(t).feature)
+                task_ids.push_back(t);
+        std::vector<DecodeShift> shifts;
+        measure_decode_shift(dirname, files, task_ids, report_samples,
+                             shifts);
+        std::printf("Reduced vs full-resolution decoding, %zu of %zu "
+                    "images:\n",
+                    std::min(report_samples, files.size()), files.size());
+        print_decode_shift(shifts);
+        return 0;
+    }
+
+    const std::string out_path = args[1];
+    const bool csv = out_path.size() >= 4 &&
+                     out_path.compare(out_path.size() - 4, 4, ".csv") == 0;
+    if (csv && shards > 1) {
+        std::cerr << "Sharded databases are binary; drop the .csv suffix\n";
         return -1;
     }
 
     // task id optional (default = 1)
-    const int task_id = (argc > 3) ? std::atoi(argv[3]) : 1;
+    const int task_id = (args.size() > 2) ? std::atoi(args[2].c_str()) : 1;
     TaskSpec spec;
     try {
         spec = get_task(task_id);
@@ -61,38 +211,105 @@ int main(int argc, char *argv[]) {
                   << ")\n";
         return -1;
     }
-
-    std::vector<std::string> files;
-    if (!list_image_files(dirname, files)) {
-        std::cerr << "Cannot open directory " << dirname << "\n";
+    if (!spec.feature) {
+        std::cerr << "Task " << task_id
+                  << " features are precomputed and cannot be built here\n";
         return -1;
     }
+    if (reduced)
+        opt.decode_scale = spec.decode_scale;
 
-    int written = 0;
-    int skipped = 0;
-
-    for (const std::string &name : files) {
-        std::printf("processing image file: %s\n", name.c_str());
-
-        const std::string full = dirname + "/" + name;
-        std::printf("full path name: %s\n", full.c_str());
+    FeatureDB db;
+    db.task_id = task_id;
+    db.decode_scale = opt.decode_scale;
+    BuildStats stats;
+    UpdateStats update;
+    if (incremental) {
+        std::vector<std::string> files;
+        if (!collect_inputs(dirname, manifest, scan, files)) {
+            std::cerr << "Cannot read " << input << "\n";
+            return -1;
+        }
+        // the previous output only counts if it was built for this task;
+        // a sharded one is gathered back into memory
+        MappedFeatureDB old_db;
+        FeatureDB old_shards;
+        FeatureDBView old;
+        struct stat st;
+        if (stat(out_path.c_str(), &st) == 0) {
+            const bool ok = is_shard_manifest(out_path)
+                                ? read_sharded_db(out_path, old_shards)
+                                : map_feature_db(out_path, old_db);
+            if (!ok) {
+                std::cerr << "Cannot read existing database: " << out_path
+                          << "\n";
+                return -1;
+            }
+            old = old_shards.rows > 0 ? feature_db_view(old_shards)
+                                      : old_db.view;
+        }
+        if (old.task_id > 0 && old.task_id != task_id) {
+            std::cerr << "  existing database is not task " << task_id
+                      << "; rebuilding everything\n";
+            old = FeatureDBView();
+        } else if (old.rows > 0 && old.decode_scale != opt.decode_scale) {
+            std::cerr << "  existing database was decoded at 1/"
+                      << old.decode_scale << " scale, not 1/"
+                      << opt.decode_scale << "; rebuilding everything\n";
+            old = FeatureDBView();
+        } else if (old.rows > 0 && !old.stamps) {
+            std::cerr << "  existing database has no file stamps; "
+                         "rebuilding everything\n";
+        }
+        update_features(dirname, files, spec, opt, old, db, stats, update);
+    } else {
+        // extract while the listing is still running
+        WorkQueue<PathBatch> batches(64);
+        bool listed = false;
+        std::thread lister(
+            [&] { listed = list_inputs(dirname, manifest, scan, batches); });
+        extract_features_stream(dirname, batches, spec, opt, db, stats);
+        lister.join();
+        if (!listed) {
+            std::cerr << "Cannot read " << input << "\n";
+            return -1;
+        }
+    }
 
-        cv::Mat img = cv::imread(full, cv::IMREAD_UNCHANGED);
-        std::vector<float> feat;
-        if (!spec.feature(img, feat)) {
-            std::cerr << "  [skip] failed to compute feature for " << name
+    // write next to the target and rename, so a failed or interrupted run
+    // never leaves a truncated database behind (keep the .csv suffix so the
+    // format choice is unchanged)
+    const std::string tmp_path = out_path + (csv ? ".tmp.csv" : ".tmp");
+    if (csv && opt.decode_scale > 1)
+        std::cerr << "  CSV files do not record the decode scale; queries "
+                     "will decode targets at full resolution\n";
+    if (shards > 1) {
+        if (!write_sharded_db(out_path, db, shards, shard_by_hash)) {
+            std::cerr << "Cannot write sharded database: " << out_path
                       << "\n";
-            skipped++;
-            continue;
+            return -1;
         }
-
-        write_csv_row(out, name, feat);
-        written++;
+        std::printf("Wrote %zu shards (by %s) and manifest %s\n", shards,
+                    shard_by_hash ? "hash" : "count", out_path.c_str());
+    } else if (!save_feature_db(tmp_path, db) ||
+               std::rename(tmp_path.c_str(), out_path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        std::cerr << "Cannot write output database: " << out_path << "\n";
+        return -1;
+    } else {
+        // the output may have been a shard manifest before
+        remove_stale_shards(out_path, 0);
     }
-
-    out.close();
-    std::printf("Wrote %d feature rows to %s (skipped %d)\n", written,
-                out_csv.c_str(), skipped);
+    std::printf("Wrote %zu feature rows to %s (skipped %zu, %d threads, "
+                "decoded at 1/%d scale)\n",
+                db.rows, out_path.c_str(), stats.skipped, opt.threads,
+                opt.decode_scale);
+    if (incremental)
+        std::printf("  incremental: %zu reused, %zu changed, %zu added, "
+                    "%zu dropped\n",
+                    update.reused, update.changed, update.added,
+                    update.dropped);
+    print_build_stats(stats);
     std::printf("Terminating\n");
     return 0;
-}
\ No newline at end of file
+}
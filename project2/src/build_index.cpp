@@ -0,0 +1,377 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - build_index.cpp
+
+    This file builds approximate search indexes over an existing feature
+    database. Indexes are stored in their own files next to the database
+    and refer to its rows, so the database must not change after the
+    index is built.
+
+    Index kinds:
+        hnsw - HNSW graph for Task 5 embeddings (query_task5 --hnsw)
+        pq   - product-quantized Task 5 embeddings (query_task5 --pq)
+        ivf  - inverted file for Task 1-4 histograms (query_db --ivf)
+        qhist - 8/16-bit quantized Task 2-4 histograms (query_db --qhist)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/feature_db.h"
+#include "../include/hnsw.h"
+#include "../include/ivf.h"
+#include "../include/pq.h"
+#include "../include/qhist.h"
+#include "../include/task_registry.h"
+
+/*
+    build_hnsw
+
+    Build and save an HNSW index.
+    Usage: build_index hnsw <db> <out_index> [--M N] [--ef-construction N]
+                            [--task N]
+
+    Arguments:
+        const std::vector<std::string> &args - arguments after "hnsw".
+
+    Returns:
+        0 on success, negative value on error.
+*/
+static int build_hnsw(const std::vector<std::string> &args) {
+    HnswParams params;
+    int task_id = 0;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--M" && i + 1 < args.size())
+            params.M = std::atoi(args[++i].c_str());
+        else if (args[i] == "--ef-construction" && i + 1 < args.size())
+            params.ef_construction = std::atoi(args[++i].c_str());
+        else if (args[i] == "--task" && i + 1 < args.size())
+            task_id = std::atoi(args[++i].c_str());
+        else
+            paths.push_back(args[i]);
+    }
+    if (paths.size() < 2) {
+        std::cerr << "usage: build_index hnsw <db> <out_index> [--M N] "
+                     "[--ef-construction N] [--task N]\n";
+        return -1;
+    }
+
+    MappedFeatureDB mapped;
+    if (!map_feature_db(paths[0], mapped)) {
+        std::cerr << "Cannot load feature database: " << paths[0] << "\n";
+        return -1;
+    }
+    const FeatureDBView &db = mapped.view;
+
+    // distance of the database's task, Task 5 (cosine) for untagged CSVs
+    if (task_id == 0)
+        task_id = db.task_id > 0 ? db.task_id : 5;
+    TaskSpec spec;
+    try {
+        spec = get_task(task_id);
+    } catch (const std::exception &e) {
+        std::cerr << "Invalid task id: " << task_id << " (" << e.what()
+                  << ")\n";
+        return -1;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    HnswIndex index;
+    if (!hnsw_build(db, spec.batch_dist, params, index)) {
+        std::cerr << "Cannot build HNSW index (empty database or bad M)\n";
+        return -1;
+    }
+    index.task_id = task_id;
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+
+    if (!write_hnsw_index(paths[1], index)) {
+        std::cerr << "Cannot write index: " << paths[1] << "\n";
+        return -1;
+    }
+    std::printf("HNSW index: %zu rows, M=%zu, efConstruction=%zu, "
+                "%d levels, built in %.2f s -> %s\n",
+                index.rows, index.M, index.ef_construction,
+                index.max_level + 1, sec, paths[1].c_str());
+    return 0;
+}
+
+/*
+    build_pq
+
+    Train and save a product-quantized copy of a database's embeddings.
+    Usage: build_index pq <db> <out_index> [--m N] [--train N] [--iters N]
+                          [--threads N]
+
+    Arguments:
+        const std::vector<std::string> &args - arguments after "pq".
+
+    Returns:
+        0 on success, negative value on error.
+*/
+static int build_pq(const std::vector<std::string> &args) {
+    PQParams params;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--m" && i + 1 < args.size())
+            params.m = std::atoi(args[++i].c_str());
+        else if (args[i] == "--train" && i + 1 < args.size())
+            params.train_rows = std::atoi(args[++i].c_str());
+        else if (args[i] == "--iters" && i + 1 < args.size())
+            params.iters = std::atoi(args[++i].c_str());
+        else if (args[i] == "--threads" && i + 1 < args.size())
+            params.threads = std::atoi(args[++i].c_str());
+        else
+            paths.push_back(args[i]);
+    }
+    if (paths.size() < 2) {
+        std::cerr << "usage: build_index pq <db> <out_index> [--m N] "
+                     "[--train N] [--iters N] [--threads N]\n";
+        return -1;
+    }
+
+    MappedFeatureDB mapped;
+    if (!map_feature_db(paths[0], mapped)) {
+        std::cerr << "Cannot load feature database: " << paths[0] << "\n";
+        return -1;
+    }
+    const FeatureDBView &db = mapped.view;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    PQIndex index;
+    if (!pq_train(db, params, index)) {
+        std::cerr << "Cannot train PQ (need >= " << PQ_KSUB
+                  << " rows and m dividing dim " << db.dim << ")\n";
+        return -1;
+    }
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+
+    if (!write_pq_index(paths[1], index)) {
+        std::cerr << "Cannot write index: " << paths[1] << "\n";
+        return -1;
+    }
+    std::printf("PQ index: %zu rows, m=%zu (%zu bytes/row vs %zu), "
+                "trained in %.2f s -> %s\n",
+                index.rows, index.m, index.m, index.dim * sizeof(float), sec,
+                paths[1].c_str());
+    return 0;
+}
+
+/*
+    build_ivf
+
+    Build and save an inverted-file index.
+    Usage: build_index ivf <db> <out_index> [--nlist N] [--train N]
+                           [--iters N] [--threads N] [--task N]
+
+    Arguments:
+        const std::vector<std::string> &args - arguments after "ivf".
+
+    Returns:
+        0 on success, negative value on error.
+*/
+static int build_ivf(const std::vector<std::string> &args) {
+    IvfParams params;
+    int task_id = 0;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--nlist" && i + 1 < args.size())
+            params.nlist = std::atoi(args[++i].c_str());
+        else if (args[i] == "--train" && i + 1 < args.size())
+            params.train_rows = std::atoi(args[++i].c_str());
+        else if (args[i] == "--iters" && i + 1 < args.size())
+            params.iters = std::atoi(args[++i].c_str());
+        else if (args[i] == "--threads" && i + 1 < args.size())
+            params.threads = std::atoi(args[++i].c_str());
+        else if (args[i] == "--task" && i + 1 < args.size())
+            task_id = std::atoi(args[++i].c_str());
+        else
+            paths.push_back(args[i]);
+    }
+    if (paths.size() < 2) {
+        std::cerr << "usage: build_index ivf <db> <out_index> [--nlist N] "
+                     "[--train N] [--iters N] [--threads N] [--task N]\n";
+        return -1;
+    }
+
+    MappedFeatureDB mapped;
+    if (!map_feature_db(paths[0], mapped)) {
+        std::cerr << "Cannot load feature database: " << paths[0] << "\n";
+        return -1;
+    }
+    const FeatureDBView &db = mapped.view;
+
+    // distance of the database's task, Task 1 for untagged CSVs
+    if (task_id == 0)
+        task_id = db.task_id > 0 ? db.task_id : 1;
+    TaskSpec spec;
+    try {
+        spec = get_task(task_id);
+    } catch (const std::exception &e) {
+        std::cerr << "Invalid task id: " << task_id << " (" << e.what()
+                  << ")\n";
+        return -1;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    IvfIndex index;
+    if (!ivf_build(db, spec, params, index)) {
+        std::cerr << "Cannot build IVF index (empty database)\n";
+        return -1;
+    }
+    index.task_id = task_id;
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+
+    if (!write_ivf_index(paths[1], index)) {
+        std::cerr << "Cannot write index: " << paths[1] << "\n";
+        return -1;
+    }
+    size_t largest = 0;
+    for (size_t c = 0; c < index.nlist; c++)
+        largest = std::max<size_t>(largest,
+                                   index.offsets[c + 1] - index.offsets[c]);
+    std::printf("IVF index: %zu rows, task %d, nlist=%zu (largest cell "
+                "%zu rows), built in %.2f s -> %s\n",
+                index.rows, task_id, index.nlist, largest, sec,
+                paths[1].c_str());
+    return 0;
+}
+
+/*
+    build_qhist
+
+    Quantize a histogram database and check the quantized distances
+    against the float ones on a sample of query rows.
+    Usage: build_index qhist <db> <out_index> [--bits 8|16] [--check N]
+                             [--task N]
+
+    Arguments:
+        const std::vector<std::string> &args - arguments after "qhist".
+
+    Returns:
+        0 on success, negative value on error.
+*/
+static int build_qhist(const std::vector<std::string> &args) {
+    int bits = 8;
+    size_t check_queries = 20;
+    int task_id = 0;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--bits" && i + 1 < args.size())
+            bits = std::atoi(args[++i].c_str());
+        else if (args[i] == "--check" && i + 1 < args.size())
+            check_queries = std::max(0, std::atoi(args[++i].c_str()));
+        else if (args[i] == "--task" && i + 1 < args.size())
+            task_id = std::atoi(args[++i].c_str());
+        else
+            paths.push_back(args[i]);
+    }
+    if (paths.size() < 2 || (bits != 8 && bits != 16)) {
+        std::cerr << "usage: build_index qhist <db> <out_index> "
+                     "[--bits 8|16] [--check N] [--task N]\n";
+        return -1;
+    }
+
+    MappedFeatureDB mapped;
+    if (!map_feature_db(paths[0], mapped)) {
+        std::cerr << "Cannot load feature database: " << paths[0] << "\n";
+        return -1;
+    }
+    const FeatureDBView &db = mapped.view;
+
+    // histogram task of the database, Task 2 for untagged CSVs
+    if (task_id == 0)
+        task_id = db.task_id > 0 ? db.task_id : 2;
+    TaskSpec spec;
+    try {
+        spec = get_task(task_id);
+    } catch (const std::exception &e) {
+        std::cerr << "Invalid task id: " << task_id << " (" << e.what()
+                  << ")\n";
+        return -1;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    QHistIndex index;
+    if (!qhist_build(db, task_id, bits, index)) {
+        std::cerr << "Cannot quantize " << paths[0] << ": task " << task_id
+                  << " with " << db.dim
+                  << " values is not a Task 2-4 histogram\n";
+        return -1;
+    }
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+
+    if (!write_qhist_index(paths[1], index)) {
+        std::cerr << "Cannot write index: " << paths[1] << "\n";
+        return -1;
+    }
+    std::printf("Quantized histograms: %zu rows, task %d, %d-bit codes "
+                "(%zu bytes/row vs %zu), built in %.2f s -> %s\n",
+                index.rows, task_id, bits, index.dim * (bits / 8),
+                index.dim * sizeof(float), sec, paths[1].c_str());
+
+    if (check_queries == 0)
+        return 0;
+    QHistCheck check;
+    const bool ok = qhist_check(index, db, spec.batch_dist, check_queries,
+                                10, check);
+    std::printf("Check: %zu queries x %zu rows, distance error max %.3g "
+                "mean %.3g (bound %.3g), recall@10 = %.3f\n",
+                check.queries, check.pairs / std::max<size_t>(1, check.queries),
+                check.max_error, check.mean_error, check.bound, check.recall);
+    if (!ok) {
+        std::cerr << "Quantized distances exceed the error bound\n";
+        return -1;
+    }
+    return 0;
+}
+
+/*
+    main
+
+    Build an index over a feature database.
+    Usage: ./build_index <kind> <db> <out_index> [options]
+
+    Arguments:
+        int argc - argument count.
+        char **argv - argument values.
+
+    Returns:
+        0 on success, negative value on error.
+*/
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " <hnsw|pq|ivf|qhist> <db> <out_index> [options]\n";
+        return -1;
+    }
+
+    const std::string kind = argv[1];
+    const std::vector<std::string> args(argv + 2, argv + argc);
+    if (kind == "hnsw")
+        return build_hnsw(args);
+    if (kind == "pq")
+        return build_pq(args);
+    if (kind == "ivf")
+        return build_ivf(args);
+    if (kind == "qhist")
+        return build_qhist(args);
+
+    std::cerr << "Unknown index kind: " << kind << "\n";
+    return -1;
+}
@@ -0,0 +1,680 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - build_pipeline.cpp
+
+    This file implements the parallel feature-extraction pipeline used by
+    build_db. Decoder threads read images, a worker pool computes features,
+    and the calling thread writes rows back in input order so the output
+    is identical for any thread count. Files come from a list or are
+    streamed in batches by a directory scanner or manifest reader. It also
+    measures how much reduced-resolution decoding moves each task's
+    features.
+*/
+
+#include "../include/build_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+
+#include "../include/dir_scan.h"
+#include "../include/work_queue.h"
+
+using Clock = std::chrono::steady_clock;
+
+/*
+    DecodedImage / ExtractedRow
+
+    Items passed between pipeline stages, tagged with the input position.
+*/
+struct DecodedImage {
+    size_t seq;
+    std::string name;
+    cv::Mat img;
+    bool has_stamp;
+    FileStamp stamp;
+};
+
+struct ExtractedRow {
+    size_t seq;
+    std::string name;
+    bool ok;
+    std::vector<float> feat;
+    bool has_stamp;
+    FileStamp stamp;
+};
+
+/*
+    FileSource
+
+    Hands out the files to extract one at a time, numbered in the order
+    they are handed out, from a list or from batches streamed through a
+    queue. Decoder threads share one source.
+*/
+class FileSource {
+  public:
+    explicit FileSource(const std::vector<std::string> &files)
+        : files_(&files) {}
+    explicit FileSource(WorkQueue<PathBatch> &batches) : batches_(&batches) {}
+
+    /*
+        next
+
+        Take the next file, waiting for the next batch if streaming.
+
+        Arguments:
+            size_t &seq - output position of the file in the input.
+            std::string &name - output path relative to the directory.
+
+        Returns:
+            false once every file has been handed out, true otherwise.
+    */
+    bool next(size_t &seq, std::string &name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (files_) {
+            if (seq_ >= files_->size())
+                return false;
+            name = (*files_)[seq_];
+        } else {
+            while (pos_ == batch_.size()) {
+                if (!batches_->pop(batch_))
+                    return false;
+                pos_ = 0;
+            }
+            name = std::move(batch_[pos_++]);
+        }
+        seq = seq_++;
+        return true;
+    }
+
+  private:
+    const std::vector<std::string> *files_ = nullptr;
+    WorkQueue<PathBatch> *batches_ = nullptr;
+    std::mutex mutex_;
+    PathBatch batch_;
+    size_t pos_ = 0;
+    size_t seq_ = 0;
+};
+
+/*
+    elapsed_ns
+
+    Nanoseconds elapsed since t0.
+
+    Arguments:
+        Clock::time_point t0 - start time.
+
+    Returns:
+        elapsed nanoseconds.
+*/
+static int64_t elapsed_ns(Clock::time_point t0) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                t0)
+        .count();
+}
+
+/*
+    decode_image
+
+    Decode an image file as build_db does: unchanged at full resolution,
+    or shrunk by `scale` while decoding, which always yields 3-channel
+    BGR. EXIF orientation is ignored either way.
+
+    Arguments:
+        const std::string &path - image file.
+        int scale - 1, 2, 4 or 8 (other values decode at full size).
+
+    Returns:
+        decoded image, empty on failure.
+*/
+cv::Mat decode_image(const std::string &path, int scale) {
+    // libjpeg scales in the DCT; other formats are resized after decoding
+    int flags;
+    switch (scale) {
+    case 2:
+        flags = cv::IMREAD_REDUCED_COLOR_2;
+        break;
+    case 4:
+        flags = cv::IMREAD_REDUCED_COLOR_4;
+        break;
+    case 8:
+        flags = cv::IMREAD_REDUCED_COLOR_8;
+        break;
+    default:
+        return cv::imread(path, cv::IMREAD_UNCHANGED);
+    }
+    return cv::imread(path, flags | cv::IMREAD_IGNORE_ORIENTATION);
+}
+
+/*
+    write_row
+
+    Append one extracted row to the database, or count it as skipped.
+
+    Arguments:
+        FeatureDB &db - output database.
+        const std::string &name - image filename.
+        const ExtractedRow &row - extraction result.
+        BuildStats &stats - counters to update.
+
+    Returns:
+        void.
+*/
+static void write_row(FeatureDB &db, const std::string &name,
+                      const ExtractedRow &row, BuildStats &stats) {
+    if (!row.ok) {
+        std::fprintf(stderr, "  [skip] failed to compute feature for %s\n",
+                     name.c_str());
+        stats.skipped++;
+        return;
+    }
+    if (!feature_db_append_row(db, name, row.feat.data(), row.feat.size(),
+                               row.has_stamp ? &row.stamp : nullptr)) {
+        std::fprintf(stderr, "  [skip] feature dimension mismatch for %s\n",
+                     name.c_str());
+        stats.skipped++;
+        return;
+    }
+    stats.written++;
+}
+
+/*
+    extract_serial
+
+    Single-threaded pipeline: decode, extract and write one image at a time.
+
+    Arguments:
+        const std::string &dir - image directory.
+        FileSource &files - files to extract, relative to dir.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - logging options.
+        FeatureDB &db - database to append to.
+        BuildStats &stats - counters to update.
+
+    Returns:
+        void.
+*/
+static void extract_serial(const std::string &dir, FileSource &files,
+                           const TaskSpec &spec, const BuildOptions &opt,
+                           FeatureDB &db, BuildStats &stats) {
+    int64_t decode_ns = 0, feature_ns = 0, write_ns = 0;
+    ExtractedRow row;
+    while (files.next(row.seq, row.name)) {
+        const std::string full = dir + "/" + row.name;
+        if (opt.verbose)
+            std::printf("processing image file: %s\n", full.c_str());
+
+        Clock::time_point t = Clock::now();
+        row.has_stamp = stat_file(full, row.stamp);
+        cv::Mat img = decode_image(full, opt.decode_scale);
+        decode_ns += elapsed_ns(t);
+        if (!img.empty())
+            stats.decoded++;
+
+        t = Clock::now();
+        row.ok = spec.feature(img, row.feat);
+        feature_ns += elapsed_ns(t);
+        if (row.ok)
+            stats.extracted++;
+
+        t = Clock::now();
+        write_row(db, row.name, row, stats);
+        write_ns += elapsed_ns(t);
+    }
+    stats.decode_sec = decode_ns * 1e-9;
+    stats.feature_sec = feature_ns * 1e-9;
+    stats.write_sec = write_ns * 1e-9;
+}
+
+/*
+    extract_parallel
+
+    Threaded pipeline. Decoders claim files from the shared source,
+    workers compute features, and the calling thread reorders results by
+    input position before appending them.
+
+    Arguments:
+        const std::string &dir - image directory.
+        FileSource &files - files to extract, relative to dir.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        FeatureDB &db - database to append to.
+        BuildStats &stats - counters to update.
+
+    Returns:
+        void.
+*/
+static void extract_parallel(const std::string &dir, FileSource &files,
+                             const TaskSpec &spec, const BuildOptions &opt,
+                             FeatureDB &db, BuildStats &stats) {
+    // JPEG decoding usually dominates, so split threads evenly
+    const int n_decode = std::max(1, opt.threads / 2);
+    const int n_feature = std::max(1, opt.threads - n_decode);
+
+    WorkQueue<DecodedImage> decoded(2 * opt.threads);
+    WorkQueue<ExtractedRow> extracted(4 * opt.threads);
+
+    std::atomic<int> decoders_left{n_decode};
+    std::atomic<int> workers_left{n_feature};
+    std::atomic<size_t> n_decoded{0}, n_extracted{0};
+    std::atomic<int64_t> decode_ns{0}, feature_ns{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_decode; t++) {
+        threads.emplace_back([&]() {
+            DecodedImage item;
+            while (files.next(item.seq, item.name)) {
+                const std::string full = dir + "/" + item.name;
+                if (opt.verbose)
+                    std::printf("processing image file: %s\n", full.c_str());
+
+                const Clock::time_point t0 = Clock::now();
+                item.has_stamp = stat_file(full, item.stamp);
+                item.img = decode_image(full, opt.decode_scale);
+                decode_ns += elapsed_ns(t0);
+                if (!item.img.empty())
+                    n_decoded++;
+                decoded.push(std::move(item));
+            }
+            if (--decoders_left == 0)
+                decoded.close();
+        });
+    }
+
+    for (int t = 0; t < n_feature; t++) {
+        threads.emplace_back([&]() {
+            DecodedImage item;
+            while (decoded.pop(item)) {
+                ExtractedRow row;
+                row.seq = item.seq;
+                row.name = std::move(item.name);
+                row.has_stamp = item.has_stamp;
+                row.stamp = item.stamp;
+                const Clock::time_point t0 = Clock::now();
+                row.ok = spec.feature(item.img, row.feat);
+                feature_ns += elapsed_ns(t0);
+                if (row.ok)
+                    n_extracted++;
+                item.img.release();
+                extracted.push(std::move(row));
+            }
+            if (--workers_left == 0)
+                extracted.close();
+        });
+    }
+
+    // single writer: hold early arrivals until their turn comes
+    std::map<size_t, ExtractedRow> pending;
+    size_t next_seq = 0;
+    int64_t write_ns = 0;
+    ExtractedRow row;
+    while (extracted.pop(row)) {
+        const size_t seq = row.seq;
+        pending.emplace(seq, std::move(row));
+        const Clock::time_point t0 = Clock::now();
+        for (auto it = pending.begin();
+             it != pending.end() && it->first == next_seq;
+             it = pending.erase(it), next_seq++)
+            write_row(db, it->second.name, it->second, stats);
+        write_ns += elapsed_ns(t0);
+    }
+
+    for (std::thread &t : threads)
+        t.join();
+
+    stats.decoded = n_decoded;
+    stats.extracted = n_extracted;
+    stats.decode_sec = decode_ns * 1e-9;
+    stats.feature_sec = feature_ns * 1e-9;
+    stats.write_sec = write_ns * 1e-9;
+}
+
+/*
+    extract_features
+
+    Decode every file, compute its task feature, and append the rows to
+    `db` in the order of `files`.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - filenames relative to dir.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        FeatureDB &db - database to append to.
+        BuildStats &stats - output stage counters.
+
+    Returns:
+        void.
+*/
+void extract_features(const std::string &dir,
+                      const std::vector<std::string> &files,
+                      const TaskSpec &spec, const BuildOptions &opt,
+                      FeatureDB &db, BuildStats &stats) {
+    stats = BuildStats();
+    const Clock::time_point t0 = Clock::now();
+    FileSource source(files);
+    if (opt.threads <= 1)
+        extract_serial(dir, source, spec, opt, db, stats);
+    else
+        extract_parallel(dir, source, spec, opt, db, stats);
+    stats.wall_sec = elapsed_ns(t0) * 1e-9;
+}
+
+/*
+    sort_rows_by_name
+
+    Reorder the rows of a database by filename, keeping each row's stamp.
+
+    Arguments:
+        FeatureDB &db - database to reorder (not normalized).
+
+    Returns:
+        void.
+*/
+static void sort_rows_by_name(FeatureDB &db) {
+    std::vector<size_t> order(db.rows);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return feature_db_name(db, a) < feature_db_name(db, b);
+    });
+
+    FeatureDB sorted;
+    sorted.task_id = db.task_id;
+    sorted.decode_scale = db.decode_scale;
+    const bool has_stamps = db.stamps.size() == db.rows;
+    for (size_t r : order)
+        feature_db_append_row(sorted, feature_db_name(db, r),
+                              feature_db_row(db, r), db.dim,
+                              has_stamps ? &db.stamps[r] : nullptr);
+    db = std::move(sorted);
+}
+
+/*
+    extract_features_stream
+
+    Decode and extract files as a scanner or manifest reader streams them
+    in, then sort the rows by filename.
+
+    Arguments:
+        const std::string &dir - image directory.
+        WorkQueue<PathBatch> &batches - paths relative to dir; read until
+            the producer closes it.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        FeatureDB &db - database to append to (empty on entry).
+        BuildStats &stats - output stage counters.
+
+    Returns:
+        void.
+*/
+void extract_features_stream(const std::string &dir,
+                             WorkQueue<PathBatch> &batches,
+                             const TaskSpec &spec, const BuildOptions &opt,
+                             FeatureDB &db, BuildStats &stats) {
+    stats = BuildStats();
+    const Clock::time_point t0 = Clock::now();
+    FileSource source(batches);
+    if (opt.threads <= 1)
+        extract_serial(dir, source, spec, opt, db, stats);
+    else
+        extract_parallel(dir, source, spec, opt, db, stats);
+
+    // arrival order depends on the scan; sorting makes it reproducible
+    const Clock::time_point t1 = Clock::now();
+    sort_rows_by_name(db);
+    stats.write_sec += elapsed_ns(t1) * 1e-9;
+    stats.wall_sec = elapsed_ns(t0) * 1e-9;
+}
+
+/*
+    update_features
+
+    Incremental build: reuse rows of `old_db` whose file stamp still
+    matches, extract features only for new or changed files, and drop rows
+    whose files are gone. The merged rows follow the order of `files`.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - current filenames.
+        const TaskSpec &spec - task feature function.
+        const BuildOptions &opt - thread count and logging.
+        const FeatureDBView &old_db - previous database (may be empty).
+        FeatureDB &db - output database (empty on entry).
+        BuildStats &stats - stage counters for the extracted subset.
+        UpdateStats &update - reuse/extract/drop counts.
+
+    Returns:
+        void.
+*/
+void update_features(const std::string &dir,
+                     const std::vector<std::string> &files,
+                     const TaskSpec &spec, const BuildOptions &opt,
+                     const FeatureDBView &old_db, FeatureDB &db,
+                     BuildStats &stats, UpdateStats &update) {
+    update = UpdateStats();
+
+    // rows without stamps can never be trusted, so they are all re-extracted
+    std::unordered_map<std::string_view, size_t> old_rows;
+    if (old_db.stamps) {
+        old_rows.reserve(old_db.rows);
+        for (size_t i = 0; i < old_db.rows; i++)
+            old_rows.emplace(feature_db_name(old_db, i), i);
+    }
+
+    // plan: NO_REUSE marks files that need extraction
+    const size_t NO_REUSE = (size_t)-1;
+    std::vector<size_t> reuse(files.size(), NO_REUSE);
+    std::vector<std::string> todo;
+    size_t matched = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        const auto it = old_rows.find(files[i]);
+        FileStamp st;
+        if (it != old_rows.end()) {
+            matched++;
+            const FileStamp &prev = old_db.stamps[it->second];
+            if (stat_file(dir + "/" + files[i], st) &&
+                st.mtime_ns == prev.mtime_ns && st.size == prev.size) {
+                reuse[i] = it->second;
+                update.reused++;
+                continue;
+            }
+            update.changed++;
+        } else {
+            update.added++;
+        }
+        todo.push_back(files[i]);
+    }
+    update.dropped = old_rows.size() - matched;
+
+    FeatureDB fresh;
+    extract_features(dir, todo, spec, opt, fresh, stats);
+
+    // merge in file order; fresh rows appear in `todo` order minus skips
+    size_t next_fresh = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (reuse[i] != NO_REUSE) {
+            const size_t r = reuse[i];
+            feature_db_append_row(db, files[i], feature_db_row(old_db, r),
+                                  old_db.dim, &old_db.stamps[r]);
+        } else if (next_fresh < fresh.rows &&
+                   feature_db_name(fresh, next_fresh) == files[i]) {
+            const FileStamp *st = fresh.stamps.empty()
+                                      ? nullptr
+                                      : &fresh.stamps[next_fresh];
+            feature_db_append_row(db, files[i],
+                                  feature_db_row(fresh, next_fresh),
+                                  fresh.dim, st);
+            next_fresh++;
+        }
+    }
+}
+
+/*
+    measure_decode_shift
+
+    Decode `samples` files spread evenly over `files` at full resolution
+    (as BGR, like the reduced decode) and at each task's decode_scale, and
+    compare the features: per-value shifts, the task distance between an
+    image's two features, and as a yardstick the full-resolution distance
+    between consecutive samples.
+
+    Arguments:
+        const std::string &dir - image directory.
+        const std::vector<std::string> &files - filenames relative to dir.
+        const std::vector<int> &task_ids - tasks with an image feature.
+        size_t samples - files to decode.
+        std::vector<DecodeShift> &shifts - output, one per task.
+
+    Returns:
+        void.
+*/
+void measure_decode_shift(const std::string &dir,
+                          const std::vector<std::string> &files,
+                          const std::vector<int> &task_ids, size_t samples,
+                          std::vector<DecodeShift> &shifts) {
+    std::vector<TaskSpec> specs;
+    shifts.assign(task_ids.size(), DecodeShift());
+    for (size_t t = 0; t < task_ids.size(); t++) {
+        specs.push_back(get_task(task_ids[t]));
+        shifts[t].task_id = task_ids[t];
+        shifts[t].scale = specs[t].decode_scale;
+    }
+
+    samples = std::min(samples, files.size());
+    std::vector<size_t> values(task_ids.size(), 0);
+    std::vector<size_t> neighbors(task_ids.size(), 0);
+    std::vector<std::vector<float>> prev(task_ids.size());
+    std::map<int, cv::Mat> reduced; // one decode per distinct scale
+    std::map<int, int64_t> reduced_ns;
+    int64_t full_ns = 0;
+    std::vector<float> full_feat, small_feat;
+    for (size_t s = 0; s < samples; s++) {
+        const std::string path = dir + "/" + files[s * files.size() / samples];
+        // decode the reference to BGR, as the reduced flags do, so the two
+        // decodes differ only in resolution
+        Clock::time_point t0 = Clock::now();
+        const cv::Mat full =
+            cv::imread(path, cv::IMREAD_COLOR | cv::IMREAD_IGNORE_ORIENTATION);
+        const int64_t decode_ns = elapsed_ns(t0);
+        full_ns += decode_ns;
+        reduced.clear();
+        for (const TaskSpec &spec : specs) {
+            if (reduced.count(spec.decode_scale))
+                continue;
+            if (spec.decode_scale <= 1) {
+                reduced[spec.decode_scale] = full;
+                reduced_ns[spec.decode_scale] += decode_ns;
+                continue;
+            }
+            t0 = Clock::now();
+            reduced[spec.decode_scale] = decode_image(path, spec.decode_scale);
+            reduced_ns[spec.decode_scale] += elapsed_ns(t0);
+        }
+
+        for (size_t t = 0; t < specs.size(); t++) {
+            DecodeShift &sh = shifts[t];
+            const TaskSpec &spec = specs[t];
+            if (!spec.feature(full, full_feat) ||
+                !spec.feature(reduced[spec.decode_scale], small_feat) ||
+                small_feat.size() != full_feat.size())
+                continue;
+            sh.images++;
+            for (size_t i = 0; i < full_feat.size(); i++) {
+                const double d = std::fabs((double)small_feat[i] -
+                                           full_feat[i]);
+                sh.mean_abs += d;
+                sh.max_abs = std::max(sh.max_abs, d);
+            }
+            values[t] += full_feat.size();
+            const double dist = spec.dist(full_feat, small_feat);
+            sh.mean_dist += dist;
+            sh.max_dist = std::max(sh.max_dist, dist);
+            if (prev[t].size() == full_feat.size()) {
+                sh.neighbor_dist += spec.dist(prev[t], full_feat);
+                neighbors[t]++;
+            }
+            prev[t] = full_feat;
+        }
+    }
+
+    for (size_t t = 0; t < shifts.size(); t++) {
+        DecodeShift &sh = shifts[t];
+        if (values[t] > 0)
+            sh.mean_abs /= values[t];
+        if (sh.images > 0)
+            sh.mean_dist /= sh.images;
+        if (neighbors[t] > 0)
+            sh.neighbor_dist /= neighbors[t];
+        sh.full_sec = full_ns * 1e-9;
+        sh.reduced_sec = reduced_ns[sh.scale] * 1e-9;
+    }
+}
+
+/*
+    print_decode_shift
+
+    Print a measure_decode_shift report to stdout: one line per task with
+    its value and distance shifts, the typical distance between different
+    images for comparison, and the decode speedup of its scale.
+
+    Arguments:
+        const std::vector<DecodeShift> &shifts - per-task results.
+
+    Returns:
+        void.
+*/
+void print_decode_shift(const std::vector<DecodeShift> &shifts) {
+    std::printf("  %-4s %5s %6s %10s %10s %10s %10s %10s %8s\n", "task",
+                "scale", "images", "mean|dv|", "max|dv|", "mean dist",
+                "max dist", "neighbor", "speedup");
+    for (const DecodeShift &sh : shifts)
+        std::printf("  %-4d %5d %6zu %10.3g %10.3g %10.3g %10.3g %10.3g "
+                    "%7.2fx\n",
+                    sh.task_id, sh.scale, sh.images, sh.mean_abs, sh.max_abs,
+                    sh.mean_dist, sh.max_dist, sh.neighbor_dist,
+                    sh.reduced_sec > 0.0 ? sh.full_sec / sh.reduced_sec
+                                         : 0.0);
+    std::printf("  dv: reduced minus full-resolution feature value; dist: "
+                "task distance between\n  an image's two features; "
+                "neighbor: mean distance between different images\n");
+}
+
+/*
+    print_build_stats
+
+    Print per-stage counts, busy time and throughput to stdout.
+
+    Arguments:
+        const BuildStats &stats - counters from extract_features.
+
+    Returns:
+        void.
+*/
+void print_build_stats(const BuildStats &stats) {
+    // per-stage rate is per busy second, i.e. what one core sustains
+    auto rate = [](size_t n, double sec) { return sec > 0.0 ? n / sec : 0.0; };
+    std::printf("  %-8s %8s %10s %14s\n", "stage", "images", "busy(s)",
+                "images/busy-s");
+    std::printf("  %-8s %8zu %10.3f %14.1f\n", "decode", stats.decoded,
+                stats.decode_sec, rate(stats.decoded, stats.decode_sec));
+    std::printf("  %-8s %8zu %10.3f %14.1f\n", "feature", stats.extracted,
+                stats.feature_sec, rate(stats.extracted, stats.feature_sec));
+    std::printf("  %-8s %8zu %10.3f %14.1f\n", "write", stats.written,
+                stats.write_sec, rate(stats.written, stats.write_sec));
+    std::printf("  wall %.3f s, %.1f images/s overall, %zu skipped\n",
+                stats.wall_sec, rate(stats.written, stats.wall_sec),
+                stats.skipped);
+}
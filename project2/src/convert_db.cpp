@@ -0,0 +1,82 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - convert_db.cpp
+
+    This file converts feature databases between the CSV and binary formats
+    so existing CSV databases keep working with the binary query path.
+    --normalize stores embedding rows L2-normalized for dot-product cosine
+    ranking.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/feature_db.h"
+
+/*
+    main
+
+    Convert a feature database. The input format is detected from the file
+    magic; the output format follows the extension (".csv" or binary).
+    Usage: ./convert_db <input_db|csv> <output_db|csv> [task_id]
+                        [--normalize]
+    --normalize scales every row to unit length and keeps the original
+    norms (binary output only); use it for Task 5 embedding databases.
+
+    Arguments:
+        int argc - argument count.
+        char **argv - argument values.
+
+    Returns:
+        0 on success, negative value on error.
+*/
+int main(int argc, char **argv) {
+    bool normalize = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--normalize")
+            normalize = true;
+        else
+            args.push_back(arg);
+    }
+
+    if (args.size() < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " <input_db|csv> <output_db|csv> [task_id] "
+                     "[--normalize]\n";
+        return -1;
+    }
+
+    const std::string in_path = args[0];
+    const std::string out_path = args[1];
+
+    FeatureDB db;
+    if (!load_feature_db(in_path, db)) {
+        std::cerr << "Cannot load feature database: " << in_path << "\n";
+        return -1;
+    }
+
+    // CSV files carry no task id, so allow tagging it here
+    if (args.size() > 2)
+        db.task_id = std::atoi(args[2].c_str());
+
+    if (normalize)
+        feature_db_normalize(db);
+
+    if (!save_feature_db(out_path, db)) {
+        std::cerr << "Cannot write feature database: " << out_path << "\n";
+        return -1;
+    }
+
+    std::printf("Converted %zu rows x %zu dims (task %d%s): %s -> %s\n",
+                db.rows, db.dim, db.task_id,
+                db.normalized ? ", normalized" : "", in_path.c_str(),
+                out_path.c_str());
+    return 0;
+}
@@ -5,76 +5,345 @@
     CS5330 Project 2 - dir_scan.cpp
 
     This file implements directory scanning and filename filtering helpers
-    for image datasets.
+    for image datasets: a streaming, optionally recursive and parallel
+    directory scanner, and a manifest reader with the same output.
 */
 
 #include "../include/dir_scan.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
 
 /*
-    has_suffix
+    has_suffix_nocase
 
-    Return true if string s ends with suffix suf.
+    Return true if s ends with the lowercase suffix suf, ignoring the case
+    of s. Compares in place, without copying the name.
 
     Arguments:
-        const std::string &s - input string.
-        const char *suf - suffix to check.
+        std::string_view s - input string.
+        std::string_view suf - lowercase suffix to check.
 
     Returns:
         true if s ends with suf, false otherwise.
 */
-static bool has_suffix(const std::string &s, const char *suf) {
-    if (s.size() < strlen(suf))
+static bool has_suffix_nocase(std::string_view s, std::string_view suf) {
+    if (s.size() < suf.size())
         return false;
-    return s.compare(s.size() - strlen(suf), strlen(suf), suf) == 0;
+    const char *tail = s.data() + s.size() - suf.size();
+    for (size_t i = 0; i < suf.size(); i++) {
+        char c = tail[i];
+        if (c >= 'A' && c <= 'Z')
+            c = (char)(c - 'A' + 'a');
+        if (c != suf[i])
+            return false;
+    }
+    return true;
 }
 
 /*
     is_image_filename
 
-    Check common file extensions to determine if a filename is an image.
+    Check common file extensions, ignoring case, to determine if a
+    filename is an image.
 
     Arguments:
-        const std::string &name - filename to check.
+        std::string_view name - filename to check.
 
     Returns:
         true if the filename has a supported image extension.
 */
-bool is_image_filename(const std::string &name) {
-    // check common extensions (lowercase)
-    std::string n = name;
-    for (char &c : n)
-        c = static_cast<char>(std::tolower(c));
-    return has_suffix(n, ".jpg") || has_suffix(n, ".png") ||
-           has_suffix(n, ".ppm") || has_suffix(n, ".tif") ||
-           has_suffix(n, ".jpeg");
+bool is_image_filename(std::string_view name) {
+    return has_suffix_nocase(name, ".jpg") ||
+           has_suffix_nocase(name, ".png") ||
+           has_suffix_nocase(name, ".ppm") ||
+           has_suffix_nocase(name, ".tif") ||
+           has_suffix_nocase(name, ".jpeg");
 }
 
 /*
-    list_image_files
+    ScanState
+
+    Work shared by the threads of one scan: directories still to read
+    (relative to the root), how many threads are reading one, and whether
+    the consumer has stopped taking batches.
+*/
+struct ScanState {
+    std::string root;
+    ScanOptions opt;
+    WorkQueue<PathBatch> *out;
+    std::deque<std::string> pending;
+    int busy = 0;
+    bool stopped = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+/*
+    flush_batch
+
+    Push a batch of paths to the consumer and start a new one.
+
+    Arguments:
+        ScanState &st - scan state.
+        PathBatch &batch - paths to push; empty on return.
+
+    Returns:
+        false if the consumer closed the queue, true otherwise.
+*/
+static bool flush_batch(ScanState &st, PathBatch &batch) {
+    if (batch.empty())
+        return true;
+    const bool ok = st.out->push(std::move(batch));
+    batch = PathBatch();
+    batch.reserve(st.opt.batch);
+    return ok;
+}
+
+/*
+    scan_one_dir
+
+    Read one directory: image entries go into `batch` (flushed whenever
+    full) and, in a recursive scan, subdirectories are queued for any
+    thread to pick up. The entry type comes from d_type; only entries the
+    filesystem reports as DT_UNKNOWN are stat'ed, without following links.
+
+    Arguments:
+        ScanState &st - scan state.
+        const std::string &rel - directory relative to the root ("" = root).
+        PathBatch &batch - this thread's pending paths.
+
+    Returns:
+        false if the consumer closed the queue, true otherwise.
+*/
+static bool scan_one_dir(ScanState &st, const std::string &rel,
+                         PathBatch &batch) {
+    DIR *dp = opendir(rel.empty() ? st.root.c_str()
+                                  : (st.root + "/" + rel).c_str());
+    if (!dp)
+        return true; // unreadable subdirectory: skip it
+    const std::string prefix = rel.empty() ? std::string() : rel + "/";
+    std::vector<std::string> subdirs;
+    bool ok = true;
+    struct dirent *ent;
+    while (ok && (ent = readdir(dp)) != NULL) {
+        const char *name = ent->d_name;
+        if (name[0] == '.' &&
+            (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+        unsigned char type = ent->d_type;
+        if (type == DT_UNKNOWN && st.opt.recursive) {
+            struct stat sb;
+            if (fstatat(dirfd(dp), name, &sb, AT_SYMLINK_NOFOLLOW) == 0)
+                type = S_ISDIR(sb.st_mode) ? DT_DIR : DT_REG;
+        }
+        if (type == DT_DIR) {
+            if (st.opt.recursive)
+                subdirs.push_back(prefix + name);
+            continue;
+        }
+        if (!is_image_filename(name))
+            continue;
+        batch.push_back(prefix + name);
+        if (batch.size() >= st.opt.batch)
+            ok = flush_batch(st, batch);
+    }
+    closedir(dp);
+
+    if (!subdirs.empty()) {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        for (std::string &d : subdirs)
+            st.pending.push_back(std::move(d));
+        st.wake.notify_all();
+    }
+    return ok;
+}
+
+/*
+    scan_worker
+
+    Take queued directories until none are left and no other thread can
+    queue more, then push this thread's last partial batch.
+
+    Arguments:
+        ScanState &st - scan state.
+
+    Returns:
+        void.
+*/
+static void scan_worker(ScanState &st) {
+    PathBatch batch;
+    batch.reserve(st.opt.batch);
+    std::unique_lock<std::mutex> lock(st.mutex);
+    for (;;) {
+        st.wake.wait(lock, [&] {
+            return st.stopped || !st.pending.empty() || st.busy == 0;
+        });
+        if (st.stopped || st.pending.empty())
+            break;
+        const std::string rel = std::move(st.pending.front());
+        st.pending.pop_front();
+        st.busy++;
+        lock.unlock();
+        const bool ok = scan_one_dir(st, rel, batch);
+        lock.lock();
+        st.busy--;
+        if (!ok)
+            st.stopped = true;
+        if (!ok || (st.busy == 0 && st.pending.empty()))
+            st.wake.notify_all();
+    }
+    // read the flag while still holding the lock; other threads set it
+    const bool stopped = st.stopped;
+    lock.unlock();
+    if (!stopped)
+        flush_batch(st, batch);
+}
+
+/*
+    scan_image_files
 
-    Scan a directory and collect image filenames into `files`.
+    Scan a directory, recursively and in parallel if asked, and push image
+    paths relative to it to `out` in batches as they are found. Closes
+    `out` when done.
 
     Arguments:
         const std::string &dir - directory path to scan.
-        std::vector<std::string> &files - output list of filenames.
+        const ScanOptions &opt - recursion, threads and batch size.
+        WorkQueue<PathBatch> &out - output batches.
 
     Returns:
-        true on success, false on failure.
+        true on success, false if `dir` cannot be opened.
 */
-bool list_image_files(const std::string &dir, std::vector<std::string> &files) {
+bool scan_image_files(const std::string &dir, const ScanOptions &opt,
+                      WorkQueue<PathBatch> &out) {
     DIR *dp = opendir(dir.c_str());
-    if (!dp)
+    if (!dp) {
+        out.close();
         return false;
-    files.clear();
-    struct dirent *ent;
-    while ((ent = readdir(dp)) != NULL) {
-        std::string name(ent->d_name);
-        if (is_image_filename(name))
-            files.push_back(name);
     }
     closedir(dp);
+
+    ScanState st;
+    st.root = dir;
+    st.opt = opt;
+    st.opt.batch = std::max<size_t>(1, opt.batch);
+    st.out = &out;
+    st.pending.push_back(std::string());
+
+    // a flat directory is one readdir stream, so extra threads cannot help
+    const int n_threads = opt.recursive ? std::max(1, opt.threads) : 1;
+    std::vector<std::thread> threads;
+    for (int t = 1; t < n_threads; t++)
+        threads.emplace_back(scan_worker, std::ref(st));
+    scan_worker(st);
+    for (std::thread &t : threads)
+        t.join();
+    out.close();
+    return true;
+}
+
+/*
+    list_image_files
+
+    Scan a directory and collect image paths into `files`.
+
+    Arguments:
+        const std::string &dir - directory path to scan.
+        const ScanOptions &opt - recursion and threads.
+        std::vector<std::string> &files - output list of paths.
+
+    Returns:
+        true on success, false if `dir` cannot be opened.
+*/
+bool list_image_files(const std::string &dir, const ScanOptions &opt,
+                      std::vector<std::string> &files) {
+    WorkQueue<PathBatch> batches(64);
+    bool ok = false;
+    std::thread scanner([&] { ok = scan_image_files(dir, opt, batches); });
+    files.clear();
+    PathBatch batch;
+    while (batches.pop(batch))
+        for (std::string &f : batch)
+            files.push_back(std::move(f));
+    scanner.join();
+    return ok;
+}
+
+/*
+    read_manifest
+
+    Read a manifest file line by line and push its paths to `out` in
+    batches, so consumers can start before the whole file is read.
+
+    Arguments:
+        const std::string &path - manifest file.
+        size_t batch - paths per PathBatch.
+        WorkQueue<PathBatch> &out - output batches.
+
+    Returns:
+        true on success, false if the manifest cannot be read.
+*/
+bool read_manifest(const std::string &path, size_t batch,
+                   WorkQueue<PathBatch> &out) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        out.close();
+        return false;
+    }
+    batch = std::max<size_t>(1, batch);
+    PathBatch paths;
+    paths.reserve(batch);
+    std::string line;
+    bool ok = true;
+    while (ok && std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        paths.push_back(std::move(line));
+        if (paths.size() >= batch) {
+            ok = out.push(std::move(paths));
+            paths = PathBatch();
+            paths.reserve(batch);
+        }
+    }
+    if (ok && !paths.empty())
+        out.push(std::move(paths));
+    out.close();
+    return true;
+}
+
+/*
+    stat_file
+
+    Read the modification time (nanoseconds) and size of a file.
+
+    Arguments:
+        const std::string &path - file path.
+        FileStamp &stamp - output stamp.
+
+    Returns:
+        true on success, false if the file cannot be stat'ed.
+*/
+bool stat_file(const std::string &path, FileStamp &stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#ifdef __APPLE__
+    const struct timespec &ts = st.st_mtimespec;
+#else
+    const struct timespec &ts = st.st_mtim;
+#endif
+    stamp.mtime_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    stamp.size = (uint64_t)st.st_size;
     return true;
 }
@@ -0,0 +1,1358 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - distance_kernels.cpp
+
+    This file implements the vectorized distance kernels and their runtime
+    dispatch. x86 builds compile SSE, AVX2 (+FMA) and AVX-512 variants with
+    per-function target attributes, so the binary still runs on CPUs
+    without them; other architectures use the portable scalar versions.
+*/
+
+#include "../include/distance_kernels.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DK_X86 1
+#include <immintrin.h>
+#else
+#define DK_X86 0
+#endif
+
+// number of float lanes the scalar kernels keep (matches one AVX2 register)
+#define DK_LANES 8
+
+// values between early-exit checks of the bounded kernels; a multiple of
+// every main-loop step, so checks fall on the same index for every ISA
+#define DK_CHECK 64
+
+// relative slack between a partial lane sum and the final compensated sum
+// (covers float rounding of both); keeps early exits conservative
+#define DK_BOUND_SLACK 1e-5f
+
+/*
+    compensated_sum
+
+    Add up float partial sums with Neumaier compensation.
+
+    Arguments:
+        const float *v - partial sums (lanes plus tail).
+        size_t n - number of partial sums.
+
+    Returns:
+        compensated total.
+*/
+static float compensated_sum(const float *v, size_t n) {
+    float s = 0.0f;
+    float c = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        const float t = s + v[i];
+        if (std::fabs(s) >= std::fabs(v[i]))
+            c += (s - t) + v[i];
+        else
+            c += (v[i] - t) + s;
+        s = t;
+    }
+    return s + c;
+}
+
+/*
+    ssd_exceeds / min_sum_falls_short
+
+    Early-exit tests of the bounded kernels, run on the plain sum of the
+    accumulator lanes after every DK_CHECK values. SSD only grows, so a
+    partial sum already above the bound stays above it; the intersection
+    can grow at most by the query's remaining mass `rest` (min(a, b) <= a).
+    Both leave `out` set to a value past the limit.
+
+    Arguments:
+        float partial - sum of the lanes so far.
+        float bound / floor - limit the final value is tested against.
+        float rest - sum of the query values not yet visited.
+        float &out - output, value returned on an early exit.
+
+    Returns:
+        true if the final value is certain to be past the limit.
+*/
+static inline bool ssd_exceeds(float partial, float bound, float &out) {
+    out = partial * (1.0f - DK_BOUND_SLACK);
+    return out > bound;
+}
+
+static inline bool min_sum_falls_short(float partial, float rest, float floor,
+                                       float &out) {
+    out = (partial + rest) * (1.0f + DK_BOUND_SLACK);
+    return out < floor;
+}
+
+/* ---------------------------- scalar kernels ---------------------------- */
+
+/*
+    Kernels with a bound take `bound` (SSD) or `rest` + `floor` (min sum)
+    and return early once the result is certain to be past it; every
+    other result is bit-identical to the unbounded call, which passes
+    INFINITY or nullptr and never checks. rest[k] holds the sum of a[]
+    from index k * DK_CHECK on.
+*/
+
+static float lane_total(const float *acc) {
+    float p = 0.0f;
+    for (size_t l = 0; l < DK_LANES; l++)
+        p += acc[l];
+    return p;
+}
+
+static float ssd_bounded_scalar(const float *a, const float *b, size_t n,
+                                float bound) {
+    const bool check = bound < INFINITY;
+    float acc[DK_LANES + 1] = {0.0f};
+    size_t i = 0;
+    for (; i + DK_LANES <= n; i += DK_LANES) {
+        for (size_t l = 0; l < DK_LANES; l++) {
+            const float d = a[i + l] - b[i + l];
+            acc[l] += d * d;
+        }
+        float out;
+        if (check && (i + DK_LANES) % DK_CHECK == 0 &&
+            ssd_exceeds(lane_total(acc), bound, out))
+            return out;
+    }
+    for (; i < n; i++) {
+        const float d = a[i] - b[i];
+        acc[DK_LANES] += d * d;
+    }
+    return compensated_sum(acc, DK_LANES + 1);
+}
+
+static float ssd_scalar(const float *a, const float *b, size_t n) {
+    return ssd_bounded_scalar(a, b, n, INFINITY);
+}
+
+static float min_sum_bounded_scalar(const float *a, const float *b, size_t n,
+                                    const float *rest, float floor) {
+    float acc[DK_LANES + 1] = {0.0f};
+    size_t i = 0;
+    for (; i + DK_LANES <= n; i += DK_LANES) {
+        for (size_t l = 0; l < DK_LANES; l++)
+            acc[l] += a[i + l] < b[i + l] ? a[i + l] : b[i + l];
+        float out;
+        if (rest && (i + DK_LANES) % DK_CHECK == 0 &&
+            min_sum_falls_short(lane_total(acc),
+                                rest[(i + DK_LANES) / DK_CHECK], floor, out))
+            return out;
+    }
+    for (; i < n; i++)
+        acc[DK_LANES] += a[i] < b[i] ? a[i] : b[i];
+    return compensated_sum(acc, DK_LANES + 1);
+}
+
+static float min_sum_scalar(const float *a, const float *b, size_t n) {
+    return min_sum_bounded_scalar(a, b, n, nullptr, 0.0f);
+}
+
+static float dot_scalar(const float *a, const float *b, size_t n) {
+    float acc[DK_LANES + 1] = {0.0f};
+    size_t i = 0;
+    for (; i + DK_LANES <= n; i += DK_LANES) {
+        for (size_t l = 0; l < DK_LANES; l++)
+            acc[l] += a[i + l] * b[i + l];
+    }
+    for (; i < n; i++)
+        acc[DK_LANES] += a[i] * b[i];
+    return compensated_sum(acc, DK_LANES + 1);
+}
+
+/*
+    dot_2x2_pairs
+
+    Dot products of 2 queries with 2 rows, one pair kernel call each; used
+    where there is no register-blocked version.
+    out = {a0.b0, a0.b1, a1.b0, a1.b1}.
+*/
+template <float (*Pair)(const float *, const float *, size_t)>
+static void dot_2x2_pairs(const float *a0, const float *a1, const float *b0,
+                          const float *b1, size_t n, float *out) {
+    out[0] = Pair(a0, b0, n);
+    out[1] = Pair(a0, b1, n);
+    out[2] = Pair(a1, b0, n);
+    out[3] = Pair(a1, b1, n);
+}
+
+static void dot_2x2_scalar(const float *a0, const float *a1, const float *b0,
+                           const float *b1, size_t n, float *out) {
+    dot_2x2_pairs<dot_scalar>(a0, a1, b0, b1, n, out);
+}
+
+static void dot_norms_scalar(const float *a, const float *b, size_t n,
+                             float &dot, float &na, float &nb) {
+    float acc_d[DK_LANES + 1] = {0.0f};
+    float acc_a[DK_LANES + 1] = {0.0f};
+    float acc_b[DK_LANES + 1] = {0.0f};
+    size_t i = 0;
+    for (; i + DK_LANES <= n; i += DK_LANES) {
+        for (size_t l = 0; l < DK_LANES; l++) {
+            acc_d[l] += a[i + l] * b[i + l];
+            acc_a[l] += a[i + l] * a[i + l];
+            acc_b[l] += b[i + l] * b[i + l];
+        }
+    }
+    for (; i < n; i++) {
+        acc_d[DK_LANES] += a[i] * b[i];
+        acc_a[DK_LANES] += a[i] * a[i];
+        acc_b[DK_LANES] += b[i] * b[i];
+    }
+    dot = compensated_sum(acc_d, DK_LANES + 1);
+    na = compensated_sum(acc_a, DK_LANES + 1);
+    nb = compensated_sum(acc_b, DK_LANES + 1);
+}
+
+/*
+    Integer min-sum kernels for quantized histograms (uint8 codes, or
+    uint16 codes of at most 15 bits). Integer sums are exact, so every
+    ISA returns the same value.
+*/
+
+static uint32_t min_sum_u8_scalar(const uint8_t *a, const uint8_t *b,
+                                  size_t n) {
+    uint32_t s = 0;
+    for (size_t i = 0; i < n; i++)
+        s += a[i] < b[i] ? a[i] : b[i];
+    return s;
+}
+
+static uint32_t min_sum_u16_scalar(const uint16_t *a, const uint16_t *b,
+                                   size_t n) {
+    uint32_t s = 0;
+    for (size_t i = 0; i < n; i++)
+        s += a[i] < b[i] ? a[i] : b[i];
+    return s;
+}
+
+#if DK_X86
+
+/* ------------------------------ SSE kernels ----------------------------- */
+
+/*
+    SSE versions use two 4-lane accumulators so consecutive iterations do
+    not wait on each other's adds; the lanes are reduced at the end.
+*/
+
+__attribute__((target("sse2"))) static float
+reduce_sse(__m128 acc0, __m128 acc1, float tail) {
+    float lanes[9];
+    _mm_storeu_ps(lanes, acc0);
+    _mm_storeu_ps(lanes + 4, acc1);
+    lanes[8] = tail;
+    return compensated_sum(lanes, 9);
+}
+
+__attribute__((target("sse2"))) static float lane_total_sse(__m128 acc0,
+                                                            __m128 acc1) {
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("sse2"))) static float
+ssd_bounded_sse(const float *a, const float *b, size_t n, float bound) {
+    const bool check = bound < INFINITY;
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        const __m128 d1 =
+            _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+        float out;
+        if (check && (i + 8) % DK_CHECK == 0 &&
+            ssd_exceeds(lane_total_sse(acc0, acc1), bound, out))
+            return out;
+    }
+    float tail = 0.0f;
+    for (; i < n; i++) {
+        const float d = a[i] - b[i];
+        tail += d * d;
+    }
+    return reduce_sse(acc0, acc1, tail);
+}
+
+__attribute__((target("sse2"))) static float ssd_sse(const float *a,
+                                                     const float *b,
+                                                     size_t n) {
+    return ssd_bounded_sse(a, b, n, INFINITY);
+}
+
+__attribute__((target("sse2"))) static float
+min_sum_bounded_sse(const float *a, const float *b, size_t n,
+                    const float *rest, float floor) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(
+            acc0, _mm_min_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(
+            acc1, _mm_min_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        float out;
+        if (rest && (i + 8) % DK_CHECK == 0 &&
+            min_sum_falls_short(lane_total_sse(acc0, acc1),
+                                rest[(i + 8) / DK_CHECK], floor, out))
+            return out;
+    }
+    float tail = 0.0f;
+    for (; i < n; i++)
+        tail += a[i] < b[i] ? a[i] : b[i];
+    return reduce_sse(acc0, acc1, tail);
+}
+
+__attribute__((target("sse2"))) static float min_sum_sse(const float *a,
+                                                         const float *b,
+                                                         size_t n) {
+    return min_sum_bounded_sse(a, b, n, nullptr, 0.0f);
+}
+
+__attribute__((target("sse2"))) static float dot_sse(const float *a,
+                                                     const float *b,
+                                                     size_t n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0,
+                          _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(
+            acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float tail = 0.0f;
+    for (; i < n; i++)
+        tail += a[i] * b[i];
+    return reduce_sse(acc0, acc1, tail);
+}
+
+__attribute__((target("sse2"))) static void
+dot_2x2_sse(const float *a0, const float *a1, const float *b0, const float *b1,
+            size_t n, float *out) {
+    dot_2x2_pairs<dot_sse>(a0, a1, b0, b1, n, out);
+}
+
+__attribute__((target("sse2"))) static void
+dot_norms_sse(const float *a, const float *b, size_t n, float &dot, float &na,
+              float &nb) {
+    __m128 acc_d = _mm_setzero_ps();
+    __m128 acc_a = _mm_setzero_ps();
+    __m128 acc_b = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 x = _mm_loadu_ps(a + i);
+        const __m128 y = _mm_loadu_ps(b + i);
+        acc_d = _mm_add_ps(acc_d, _mm_mul_ps(x, y));
+        acc_a = _mm_add_ps(acc_a, _mm_mul_ps(x, x));
+        acc_b = _mm_add_ps(acc_b, _mm_mul_ps(y, y));
+    }
+    float tail_d = 0.0f, tail_a = 0.0f, tail_b = 0.0f;
+    for (; i < n; i++) {
+        tail_d += a[i] * b[i];
+        tail_a += a[i] * a[i];
+        tail_b += b[i] * b[i];
+    }
+    const __m128 zero = _mm_setzero_ps();
+    dot = reduce_sse(acc_d, zero, tail_d);
+    na = reduce_sse(acc_a, zero, tail_a);
+    nb = reduce_sse(acc_b, zero, tail_b);
+}
+
+/*
+    Byte minima are summed with SAD against zero (two 64-bit lanes). SSE2
+    has no unsigned 16-bit minimum, but 15-bit codes compare the same as
+    signed values; pairs are then summed with a multiply-add by one.
+*/
+
+__attribute__((target("sse2"))) static uint32_t
+min_sum_u8_sse(const uint8_t *a, const uint8_t *b, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_min_epu8(x, y), zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1]) + min_sum_u8_scalar(a + i, b + i,
+                                                               n - i);
+}
+
+__attribute__((target("sse2"))) static uint32_t
+min_sum_u16_sse(const uint16_t *a, const uint16_t *b, size_t n) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        const __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_min_epi16(x, y), ones));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           min_sum_u16_scalar(a + i, b + i, n - i);
+}
+
+/* ----------------------------- AVX2 kernels ----------------------------- */
+
+__attribute__((target("avx2,fma"))) static float
+reduce_avx2(__m256 acc0, __m256 acc1, float tail) {
+    float lanes[17];
+    _mm256_storeu_ps(lanes, acc0);
+    _mm256_storeu_ps(lanes + 8, acc1);
+    lanes[16] = tail;
+    return compensated_sum(lanes, 17);
+}
+
+__attribute__((target("avx2,fma"))) static float
+lane_total_avx2(__m256 acc0, __m256 acc1) {
+    float lanes[8];
+    _mm256_storeu_ps(lanes, _mm256_add_ps(acc0, acc1));
+    return lane_total(lanes);
+}
+
+__attribute__((target("avx2,fma"))) static float
+ssd_bounded_avx2(const float *a, const float *b, size_t n, float bound) {
+    const bool check = bound < INFINITY;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256 d0 =
+            _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8),
+                                        _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+        float out;
+        if (check && (i + 16) % DK_CHECK == 0 &&
+            ssd_exceeds(lane_total_avx2(acc0, acc1), bound, out))
+            return out;
+    }
+    for (; i + 8 <= n; i += 8) {
+        const __m256 d =
+            _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d, d, acc0);
+    }
+    float tail = 0.0f;
+    for (; i < n; i++) {
+        const float d = a[i] - b[i];
+        tail += d * d;
+    }
+    return reduce_avx2(acc0, acc1, tail);
+}
+
+__attribute__((target("avx2,fma"))) static float ssd_avx2(const float *a,
+                                                          const float *b,
+                                                          size_t n) {
+    return ssd_bounded_avx2(a, b, n, INFINITY);
+}
+
+__attribute__((target("avx2,fma"))) static float
+min_sum_bounded_avx2(const float *a, const float *b, size_t n,
+                     const float *rest, float floor) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_min_ps(_mm256_loadu_ps(a + i),
+                                                 _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_min_ps(_mm256_loadu_ps(a + i + 8),
+                                                 _mm256_loadu_ps(b + i + 8)));
+        float out;
+        if (rest && (i + 16) % DK_CHECK == 0 &&
+            min_sum_falls_short(lane_total_avx2(acc0, acc1),
+                                rest[(i + 16) / DK_CHECK], floor, out))
+            return out;
+    }
+    for (; i + 8 <= n; i += 8)
+        acc0 = _mm256_add_ps(acc0, _mm256_min_ps(_mm256_loadu_ps(a + i),
+                                                 _mm256_loadu_ps(b + i)));
+    float tail = 0.0f;
+    for (; i < n; i++)
+        tail += a[i] < b[i] ? a[i] : b[i];
+    return reduce_avx2(acc0, acc1, tail);
+}
+
+__attribute__((target("avx2,fma"))) static float min_sum_avx2(const float *a,
+                                                              const float *b,
+                                                              size_t n) {
+    return min_sum_bounded_avx2(a, b, n, nullptr, 0.0f);
+}
+
+__attribute__((target("avx2,fma"))) static float dot_avx2(const float *a,
+                                                          const float *b,
+                                                          size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                               acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                               _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                               acc0);
+    float tail = 0.0f;
+    for (; i < n; i++)
+        tail += a[i] * b[i];
+    return reduce_avx2(acc0, acc1, tail);
+}
+
+/*
+    dot_2x2_avx2
+
+    Dot products of 2 queries with 2 rows. Each of the four pairs keeps
+    dot_avx2's accumulators and order, so results are bit-identical to
+    it, while every load feeds two FMAs instead of one.
+    out = {a0.b0, a0.b1, a1.b0, a1.b1}.
+*/
+__attribute__((target("avx2,fma"))) static void
+dot_2x2_avx2(const float *a0, const float *a1, const float *b0,
+             const float *b1, size_t n, float *out) {
+    __m256 s00 = _mm256_setzero_ps(), t00 = _mm256_setzero_ps();
+    __m256 s01 = _mm256_setzero_ps(), t01 = _mm256_setzero_ps();
+    __m256 s10 = _mm256_setzero_ps(), t10 = _mm256_setzero_ps();
+    __m256 s11 = _mm256_setzero_ps(), t11 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 x0 = _mm256_loadu_ps(a0 + i);
+        __m256 x1 = _mm256_loadu_ps(a1 + i);
+        __m256 y0 = _mm256_loadu_ps(b0 + i);
+        __m256 y1 = _mm256_loadu_ps(b1 + i);
+        s00 = _mm256_fmadd_ps(x0, y0, s00);
+        s01 = _mm256_fmadd_ps(x0, y1, s01);
+        s10 = _mm256_fmadd_ps(x1, y0, s10);
+        s11 = _mm256_fmadd_ps(x1, y1, s11);
+        x0 = _mm256_loadu_ps(a0 + i + 8);
+        x1 = _mm256_loadu_ps(a1 + i + 8);
+        y0 = _mm256_loadu_ps(b0 + i + 8);
+        y1 = _mm256_loadu_ps(b1 + i + 8);
+        t00 = _mm256_fmadd_ps(x0, y0, t00);
+        t01 = _mm256_fmadd_ps(x0, y1, t01);
+        t10 = _mm256_fmadd_ps(x1, y0, t10);
+        t11 = _mm256_fmadd_ps(x1, y1, t11);
+    }
+    for (; i + 8 <= n; i += 8) {
+        const __m256 x0 = _mm256_loadu_ps(a0 + i);
+        const __m256 x1 = _mm256_loadu_ps(a1 + i);
+        const __m256 y0 = _mm256_loadu_ps(b0 + i);
+        const __m256 y1 = _mm256_loadu_ps(b1 + i);
+        s00 = _mm256_fmadd_ps(x0, y0, s00);
+        s01 = _mm256_fmadd_ps(x0, y1, s01);
+        s10 = _mm256_fmadd_ps(x1, y0, s10);
+        s11 = _mm256_fmadd_ps(x1, y1, s11);
+    }
+    float tail[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (; i < n; i++) {
+        tail[0] += a0[i] * b0[i];
+        tail[1] += a0[i] * b1[i];
+        tail[2] += a1[i] * b0[i];
+        tail[3] += a1[i] * b1[i];
+    }
+    out[0] = reduce_avx2(s00, t00, tail[0]);
+    out[1] = reduce_avx2(s01, t01, tail[1]);
+    out[2] = reduce_avx2(s10, t10, tail[2]);
+    out[3] = reduce_avx2(s11, t11, tail[3]);
+}
+
+__attribute__((target("avx2,fma"))) static void
+dot_norms_avx2(const float *a, const float *b, size_t n, float &dot, float &na,
+               float &nb) {
+    __m256 acc_d = _mm256_setzero_ps();
+    __m256 acc_a = _mm256_setzero_ps();
+    __m256 acc_b = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256 x = _mm256_loadu_ps(a + i);
+        const __m256 y = _mm256_loadu_ps(b + i);
+        acc_d = _mm256_fmadd_ps(x, y, acc_d);
+        acc_a = _mm256_fmadd_ps(x, x, acc_a);
+        acc_b = _mm256_fmadd_ps(y, y, acc_b);
+    }
+    float tail_d = 0.0f, tail_a = 0.0f, tail_b = 0.0f;
+    for (; i < n; i++) {
+        tail_d += a[i] * b[i];
+        tail_a += a[i] * a[i];
+        tail_b += b[i] * b[i];
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    dot = reduce_avx2(acc_d, zero, tail_d);
+    na = reduce_avx2(acc_a, zero, tail_a);
+    nb = reduce_avx2(acc_b, zero, tail_b);
+}
+
+__attribute__((target("avx2,fma"))) static uint32_t
+min_sum_u8_avx2(const uint8_t *a, const uint8_t *b, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        acc = _mm256_add_epi64(acc,
+                               _mm256_sad_epu8(_mm256_min_epu8(x, y), zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return (uint32_t)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) +
+           min_sum_u8_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static uint32_t
+min_sum_u16_avx2(const uint16_t *a, const uint16_t *b, size_t n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        const __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        acc = _mm256_add_epi32(
+            acc, _mm256_madd_epi16(_mm256_min_epu16(x, y), ones));
+    }
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    uint32_t s = 0;
+    for (size_t l = 0; l < 8; l++)
+        s += lanes[l];
+    return s + min_sum_u16_scalar(a + i, b + i, n - i);
+}
+
+/* ---------------------------- AVX-512 kernels --------------------------- */
+
+/*
+    AVX-512 versions handle the tail with a lane mask instead of a scalar
+    loop; masked-off lanes load as zero and contribute nothing.
+*/
+
+__attribute__((target("avx512f"))) static float reduce_avx512(__m512 acc) {
+    float lanes[16];
+    _mm512_storeu_ps(lanes, acc);
+    return compensated_sum(lanes, 16);
+}
+
+__attribute__((target("avx512f"))) static __mmask16 tail_mask(size_t left) {
+    return (__mmask16)((1u << left) - 1u);
+}
+
+/*
+    min_avx512
+
+    Lane-wise minimum. Written with the zero-masking form because GCC 12's
+    _mm512_min_ps trips -Wmaybe-uninitialized on its undefined source.
+*/
+__attribute__((target("avx512f"))) static __m512 min_avx512(__m512 x,
+                                                            __m512 y) {
+    return _mm512_maskz_min_ps((__mmask16)0xFFFF, x, y);
+}
+
+__attribute__((target("avx512f"))) static float
+lane_total_avx512(__m512 acc0, __m512 acc1) {
+    float lanes[16];
+    _mm512_storeu_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float p = 0.0f;
+    for (int l = 0; l < 16; l++)
+        p += lanes[l];
+    return p;
+}
+
+__attribute__((target("avx512f"))) static float
+ssd_bounded_avx512(const float *a, const float *b, size_t n, float bound) {
+    const bool check = bound < INFINITY;
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m512 d0 =
+            _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        const __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16),
+                                        _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        float out;
+        if (check && (i + 32) % DK_CHECK == 0 &&
+            ssd_exceeds(lane_total_avx512(acc0, acc1), bound, out))
+            return out;
+    }
+    for (; i + 16 <= n; i += 16) {
+        const __m512 d =
+            _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc0 = _mm512_fmadd_ps(d, d, acc0);
+    }
+    if (i < n) {
+        const __mmask16 m = tail_mask(n - i);
+        const __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+                                       _mm512_maskz_loadu_ps(m, b + i));
+        acc1 = _mm512_fmadd_ps(d, d, acc1);
+    }
+    return reduce_avx512(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) static float ssd_avx512(const float *a,
+                                                           const float *b,
+                                                           size_t n) {
+    return ssd_bounded_avx512(a, b, n, INFINITY);
+}
+
+__attribute__((target("avx512f"))) static float
+min_sum_bounded_avx512(const float *a, const float *b, size_t n,
+                       const float *rest, float floor) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_add_ps(acc0, min_avx512(_mm512_loadu_ps(a + i),
+                                                 _mm512_loadu_ps(b + i)));
+        acc1 = _mm512_add_ps(acc1, min_avx512(_mm512_loadu_ps(a + i + 16),
+                                                 _mm512_loadu_ps(b + i + 16)));
+        float out;
+        if (rest && (i + 32) % DK_CHECK == 0 &&
+            min_sum_falls_short(lane_total_avx512(acc0, acc1),
+                                rest[(i + 32) / DK_CHECK], floor, out))
+            return out;
+    }
+    for (; i + 16 <= n; i += 16)
+        acc0 = _mm512_add_ps(acc0, min_avx512(_mm512_loadu_ps(a + i),
+                                                 _mm512_loadu_ps(b + i)));
+    if (i < n) {
+        const __mmask16 m = tail_mask(n - i);
+        acc1 = _mm512_add_ps(acc1,
+                             min_avx512(_mm512_maskz_loadu_ps(m, a + i),
+                                           _mm512_maskz_loadu_ps(m, b + i)));
+    }
+    return reduce_avx512(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) static float min_sum_avx512(const float *a,
+                                                               const float *b,
+                                                               size_t n) {
+    return min_sum_bounded_avx512(a, b, n, nullptr, 0.0f);
+}
+
+__attribute__((target("avx512f"))) static float dot_avx512(const float *a,
+                                                           const float *b,
+                                                           size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i),
+                               acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16),
+                               _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= n; i += 16)
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i),
+                               acc0);
+    if (i < n) {
+        const __mmask16 m = tail_mask(n - i);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i),
+                               _mm512_maskz_loadu_ps(m, b + i), acc1);
+    }
+    return reduce_avx512(_mm512_add_ps(acc0, acc1));
+}
+
+/*
+    dot_2x2_avx512
+
+    Register-blocked dot_avx512 for 2 queries x 2 rows (see dot_2x2_avx2).
+    out = {a0.b0, a0.b1, a1.b0, a1.b1}.
+*/
+__attribute__((target("avx512f"))) static void
+dot_2x2_avx512(const float *a0, const float *a1, const float *b0,
+               const float *b1, size_t n, float *out) {
+    __m512 s00 = _mm512_setzero_ps(), t00 = _mm512_setzero_ps();
+    __m512 s01 = _mm512_setzero_ps(), t01 = _mm512_setzero_ps();
+    __m512 s10 = _mm512_setzero_ps(), t10 = _mm512_setzero_ps();
+    __m512 s11 = _mm512_setzero_ps(), t11 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 x0 = _mm512_loadu_ps(a0 + i);
+        __m512 x1 = _mm512_loadu_ps(a1 + i);
+        __m512 y0 = _mm512_loadu_ps(b0 + i);
+        __m512 y1 = _mm512_loadu_ps(b1 + i);
+        s00 = _mm512_fmadd_ps(x0, y0, s00);
+        s01 = _mm512_fmadd_ps(x0, y1, s01);
+        s10 = _mm512_fmadd_ps(x1, y0, s10);
+        s11 = _mm512_fmadd_ps(x1, y1, s11);
+        x0 = _mm512_loadu_ps(a0 + i + 16);
+        x1 = _mm512_loadu_ps(a1 + i + 16);
+        y0 = _mm512_loadu_ps(b0 + i + 16);
+        y1 = _mm512_loadu_ps(b1 + i + 16);
+        t00 = _mm512_fmadd_ps(x0, y0, t00);
+        t01 = _mm512_fmadd_ps(x0, y1, t01);
+        t10 = _mm512_fmadd_ps(x1, y0, t10);
+        t11 = _mm512_fmadd_ps(x1, y1, t11);
+    }
+    for (; i + 16 <= n; i += 16) {
+        const __m512 x0 = _mm512_loadu_ps(a0 + i);
+        const __m512 x1 = _mm512_loadu_ps(a1 + i);
+        const __m512 y0 = _mm512_loadu_ps(b0 + i);
+        const __m512 y1 = _mm512_loadu_ps(b1 + i);
+        s00 = _mm512_fmadd_ps(x0, y0, s00);
+        s01 = _mm512_fmadd_ps(x0, y1, s01);
+        s10 = _mm512_fmadd_ps(x1, y0, s10);
+        s11 = _mm512_fmadd_ps(x1, y1, s11);
+    }
+    if (i < n) {
+        const __mmask16 m = tail_mask(n - i);
+        const __m512 x0 = _mm512_maskz_loadu_ps(m, a0 + i);
+        const __m512 x1 = _mm512_maskz_loadu_ps(m, a1 + i);
+        const __m512 y0 = _mm512_maskz_loadu_ps(m, b0 + i);
+        const __m512 y1 = _mm512_maskz_loadu_ps(m, b1 + i);
+        t00 = _mm512_fmadd_ps(x0, y0, t00);
+        t01 = _mm512_fmadd_ps(x0, y1, t01);
+        t10 = _mm512_fmadd_ps(x1, y0, t10);
+        t11 = _mm512_fmadd_ps(x1, y1, t11);
+    }
+    out[0] = reduce_avx512(_mm512_add_ps(s00, t00));
+    out[1] = reduce_avx512(_mm512_add_ps(s01, t01));
+    out[2] = reduce_avx512(_mm512_add_ps(s10, t10));
+    out[3] = reduce_avx512(_mm512_add_ps(s11, t11));
+}
+
+__attribute__((target("avx512f"))) static void
+dot_norms_avx512(const float *a, const float *b, size_t n, float &dot,
+                 float &na, float &nb) {
+    __m512 acc_d = _mm512_setzero_ps();
+    __m512 acc_a = _mm512_setzero_ps();
+    __m512 acc_b = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m512 x = _mm512_loadu_ps(a + i);
+        const __m512 y = _mm512_loadu_ps(b + i);
+        acc_d = _mm512_fmadd_ps(x, y, acc_d);
+        acc_a = _mm512_fmadd_ps(x, x, acc_a);
+        acc_b = _mm512_fmadd_ps(y, y, acc_b);
+    }
+    if (i < n) {
+        const __mmask16 m = tail_mask(n - i);
+        const __m512 x = _mm512_maskz_loadu_ps(m, a + i);
+        const __m512 y = _mm512_maskz_loadu_ps(m, b + i);
+        acc_d = _mm512_fmadd_ps(x, y, acc_d);
+        acc_a = _mm512_fmadd_ps(x, x, acc_a);
+        acc_b = _mm512_fmadd_ps(y, y, acc_b);
+    }
+    dot = reduce_avx512(acc_d);
+    na = reduce_avx512(acc_a);
+    nb = reduce_avx512(acc_b);
+}
+
+/*
+    Byte and word instructions need AVX-512BW, which the avx512f level
+    does not require; the integer kernels use the AVX2 forms instead.
+*/
+
+__attribute__((target("avx512f"))) static uint32_t
+min_sum_u8_avx512(const uint8_t *a, const uint8_t *b, size_t n) {
+    return min_sum_u8_avx2(a, b, n);
+}
+
+__attribute__((target("avx512f"))) static uint32_t
+min_sum_u16_avx512(const uint16_t *a, const uint16_t *b, size_t n) {
+    return min_sum_u16_avx2(a, b, n);
+}
+
+#endif // DK_X86
+
+/* ---------------------------- batch wrappers ---------------------------- */
+
+/*
+    rows_batch / int_rows_batch / ssd_bounded_rows / min_sum_bounded_rows /
+    dot_norms_rows
+
+    Run one kernel variant over a block of rows. The variant is fixed at
+    compile time, so each row costs a direct call rather than a dispatch.
+*/
+template <float (*Kernel)(const float *, const float *, size_t)>
+static void rows_batch(const float *q, const float *rows, size_t n,
+                       size_t stride, size_t len, float *out) {
+    for (size_t r = 0; r < n; r++)
+        out[r] = Kernel(q, rows + r * stride, len);
+}
+
+template <typename T, uint32_t (*Kernel)(const T *, const T *, size_t)>
+static void int_rows_batch(const T *q, const T *rows, size_t n, size_t stride,
+                           size_t len, uint32_t *out) {
+    for (size_t r = 0; r < n; r++)
+        out[r] = Kernel(q, rows + r * stride, len);
+}
+
+template <float (*Kernel)(const float *, const float *, size_t, float)>
+static void ssd_bounded_rows(const float *q, const float *rows, size_t n,
+                             size_t stride, size_t len, float bound,
+                             float *out) {
+    for (size_t r = 0; r < n; r++)
+        out[r] = Kernel(q, rows + r * stride, len, bound);
+}
+
+template <float (*Kernel)(const float *, const float *, size_t,
+                          const float *, float)>
+static void min_sum_bounded_rows(const float *q, const float *rows, size_t n,
+                                 size_t stride, size_t len, float floor,
+                                 float *out) {
+    // query mass from each check point on, summed in double; O(len) per
+    // block of rows, in a per-thread buffer so the scan never allocates
+    thread_local std::vector<float> rest;
+    rest.resize(len / DK_CHECK + 1);
+    double mass = 0.0;
+    for (size_t i = len; i-- > 0;) {
+        mass += q[i];
+        if (i % DK_CHECK == 0)
+            rest[i / DK_CHECK] = (float)mass;
+    }
+    for (size_t r = 0; r < n; r++)
+        out[r] = Kernel(q, rows + r * stride, len, rest.data(), floor);
+}
+
+template <void (*Kernel)(const float *, const float *, size_t, float &,
+                         float &, float &)>
+static void dot_norms_rows(const float *q, const float *rows, size_t n,
+                           size_t stride, size_t len, float *dot, float &nq,
+                           float *nr) {
+    nq = 0.0f;
+    for (size_t r = 0; r < n; r++)
+        Kernel(q, rows + r * stride, len, dot[r], nq, nr[r]);
+}
+
+/*
+    dot_tile
+
+    Dot products of nq queries with nr rows, walked in 2 x 2 blocks with
+    the variant's register-blocked kernel; odd edges use the pair kernel.
+*/
+template <float (*Pair)(const float *, const float *, size_t),
+          void (*Quad)(const float *, const float *, const float *,
+                       const float *, size_t, float *)>
+static void dot_tile(const float *q, size_t nq, size_t q_stride,
+                     const float *rows, size_t nr, size_t r_stride,
+                     size_t len, float *out, size_t ldo) {
+    size_t i = 0;
+    for (; i + 2 <= nq; i += 2) {
+        const float *a0 = q + i * q_stride;
+        const float *a1 = a0 + q_stride;
+        float *o0 = out + i * ldo;
+        float *o1 = o0 + ldo;
+        size_t j = 0;
+        for (; j + 2 <= nr; j += 2) {
+            const float *b0 = rows + j * r_stride;
+            float d[4];
+            Quad(a0, a1, b0, b0 + r_stride, len, d);
+            o0[j] = d[0];
+            o0[j + 1] = d[1];
+            o1[j] = d[2];
+            o1[j + 1] = d[3];
+        }
+        for (; j < nr; j++) {
+            o0[j] = Pair(a0, rows + j * r_stride, len);
+            o1[j] = Pair(a1, rows + j * r_stride, len);
+        }
+    }
+    for (; i < nq; i++) {
+        for (size_t j = 0; j < nr; j++)
+            out[i * ldo + j] = Pair(q + i * q_stride, rows + j * r_stride, len);
+    }
+}
+
+/* ------------------------------- dispatch ------------------------------- */
+
+using PairKernel = float (*)(const float *, const float *, size_t);
+using RowsKernel = void (*)(const float *, const float *, size_t, size_t,
+                            size_t, float *);
+
+/*
+    KernelTable
+
+    One implementation of every kernel, chosen together.
+*/
+struct KernelTable {
+    const char *isa;
+    PairKernel ssd;
+    PairKernel min_sum;
+    PairKernel dot;
+    void (*dot_norms)(const float *, const float *, size_t, float &, float &,
+                      float &);
+    RowsKernel ssd_batch;
+    RowsKernel min_sum_batch;
+    RowsKernel dot_batch;
+    void (*dot_norms_batch)(const float *, const float *, size_t, size_t,
+                            size_t, float *, float &, float *);
+    void (*dot_tile)(const float *, size_t, size_t, const float *, size_t,
+                     size_t, size_t, float *, size_t);
+    void (*ssd_bounded_batch)(const float *, const float *, size_t, size_t,
+                              size_t, float, float *);
+    void (*min_sum_bounded_batch)(const float *, const float *, size_t,
+                                  size_t, size_t, float, float *);
+    void (*min_sum_u8_batch)(const uint8_t *, const uint8_t *, size_t, size_t,
+                             size_t, uint32_t *);
+    void (*min_sum_u16_batch)(const uint16_t *, const uint16_t *, size_t,
+                              size_t, size_t, uint32_t *);
+};
+
+// KernelTable for one kernel family, e.g. DK_TABLE(avx2) -> ssd_avx2, ...
+#define DK_TABLE(isa)                                                          \
+    {#isa,                                                                     \
+     ssd_##isa,                                                                \
+     min_sum_##isa,                                                            \
+     dot_##isa,                                                                \
+     dot_norms_##isa,                                                          \
+     rows_batch<ssd_##isa>,                                                    \
+     rows_batch<min_sum_##isa>,                                                \
+     rows_batch<dot_##isa>,                                                    \
+     dot_norms_rows<dot_norms_##isa>,                                          \
+     dot_tile<dot_##isa, dot_2x2_##isa>,                                       \
+     ssd_bounded_rows<ssd_bounded_##isa>,                                      \
+     min_sum_bounded_rows<min_sum_bounded_##isa>,                              \
+     int_rows_batch<uint8_t, min_sum_u8_##isa>,                                \
+     int_rows_batch<uint16_t, min_sum_u16_##isa>}
+
+/*
+    select_kernels
+
+    Pick the best kernel set for this CPU, capped by CBIR_SIMD if set.
+
+    Returns:
+        selected kernel table.
+*/
+static KernelTable select_kernels() {
+    const KernelTable scalar = DK_TABLE(scalar);
+#if DK_X86
+    const KernelTable sse = DK_TABLE(sse);
+    const KernelTable avx2 = DK_TABLE(avx2);
+    const KernelTable avx512 = DK_TABLE(avx512);
+
+    // 0 = scalar, 1 = sse, 2 = avx2, 3 = avx512
+    int limit = 3;
+    if (const char *env = std::getenv("CBIR_SIMD")) {
+        if (std::strcmp(env, "scalar") == 0)
+            limit = 0;
+        else if (std::strcmp(env, "sse") == 0)
+            limit = 1;
+        else if (std::strcmp(env, "avx2") == 0)
+            limit = 2;
+    }
+
+    __builtin_cpu_init();
+    if (limit >= 3 && __builtin_cpu_supports("avx512f"))
+        return avx512;
+    if (limit >= 2 && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma"))
+        return avx2;
+    if (limit >= 1 && __builtin_cpu_supports("sse2"))
+        return sse;
+#endif
+    return scalar;
+}
+
+/*
+    kernels
+
+    Return the kernel table, selecting it on first use.
+
+    Returns:
+        selected kernel table.
+*/
+static const KernelTable &kernels() {
+    static const KernelTable table = select_kernels();
+    return table;
+}
+
+/*
+    kernel_ssd
+
+    Sum of squared differences of two float arrays.
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of (a[i] - b[i])^2.
+*/
+float kernel_ssd(const float *a, const float *b, size_t n) {
+    return kernels().ssd(a, b, n);
+}
+
+/*
+    kernel_min_sum
+
+    Histogram intersection similarity: sum of element-wise minima.
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of min(a[i], b[i]).
+*/
+float kernel_min_sum(const float *a, const float *b, size_t n) {
+    return kernels().min_sum(a, b, n);
+}
+
+/*
+    kernel_dot
+
+    Dot product of two float arrays.
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+
+    Returns:
+        sum over i of a[i] * b[i].
+*/
+float kernel_dot(const float *a, const float *b, size_t n) {
+    return kernels().dot(a, b, n);
+}
+
+/*
+    kernel_dot_norms
+
+    Dot product and squared norms in one pass (for cosine distance).
+
+    Arguments:
+        const float *a - first array.
+        const float *b - second array.
+        size_t n - number of elements.
+        float &dot - output sum of a[i] * b[i].
+        float &na - output sum of a[i]^2.
+        float &nb - output sum of b[i]^2.
+
+    Returns:
+        void.
+*/
+void kernel_dot_norms(const float *a, const float *b, size_t n, float &dot,
+                      float &na, float &nb) {
+    kernels().dot_norms(a, b, n, dot, na, nb);
+}
+
+/*
+    kernel_ssd_batch
+
+    Batched kernel_ssd over n rows of a row-major matrix.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_ssd_batch(const float *q, const float *rows, size_t n,
+                      size_t stride, size_t len, float *out) {
+    kernels().ssd_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    kernel_min_sum_batch
+
+    Batched kernel_min_sum over n rows of a row-major matrix.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_min_sum_batch(const float *q, const float *rows, size_t n,
+                          size_t stride, size_t len, float *out) {
+    kernels().min_sum_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    kernel_dot_batch
+
+    Batched kernel_dot over n rows of a row-major matrix.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_dot_batch(const float *q, const float *rows, size_t n,
+                      size_t stride, size_t len, float *out) {
+    kernels().dot_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    kernel_dot_tile
+
+    Dot products of a tile of queries with a tile of rows.
+
+    Arguments:
+        const float *q - first query.
+        size_t nq - number of queries.
+        size_t q_stride - floats between consecutive queries.
+        const float *rows - first row.
+        size_t nr - number of rows.
+        size_t r_stride - floats between consecutive rows.
+        size_t len - values per dot product.
+        float *out - output, out[i * ldo + j] = q_i . row_j.
+        size_t ldo - floats between consecutive output rows.
+
+    Returns:
+        void.
+*/
+void kernel_dot_tile(const float *q, size_t nq, size_t q_stride,
+                     const float *rows, size_t nr, size_t r_stride,
+                     size_t len, float *out, size_t ldo) {
+    kernels().dot_tile(q, nq, q_stride, rows, nr, r_stride, len, out, ldo);
+}
+
+/*
+    kernel_ssd_bounded_batch
+
+    Batched kernel_ssd that stops a row once its sum must exceed `bound`.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float bound - rows past it may stop early.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_ssd_bounded_batch(const float *q, const float *rows, size_t n,
+                              size_t stride, size_t len, float bound,
+                              float *out) {
+    kernels().ssd_bounded_batch(q, rows, n, stride, len, bound, out);
+}
+
+/*
+    kernel_min_sum_bounded_batch
+
+    Batched kernel_min_sum that stops a row once its sum must fall below
+    `floor`.
+
+    Arguments:
+        const float *q - query values (len floats, non-negative).
+        const float *rows - first row (segment) of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float floor - rows short of it may stop early.
+        float *out - output, one value per row.
+
+    Returns:
+        void.
+*/
+void kernel_min_sum_bounded_batch(const float *q, const float *rows, size_t n,
+                                  size_t stride, size_t len, float floor,
+                                  float *out) {
+    kernels().min_sum_bounded_batch(q, rows, n, stride, len, floor, out);
+}
+
+/*
+    kernel_min_sum_u8_batch
+
+    Integer histogram intersection of 8-bit codes over n rows.
+
+    Arguments:
+        const uint8_t *q - query codes (len values).
+        const uint8_t *rows - first row (segment) of the code matrix.
+        size_t n - number of rows.
+        size_t stride - codes between consecutive rows.
+        size_t len - codes compared per row.
+        uint32_t *out - output sums of minima, one per row.
+
+    Returns:
+        void.
+*/
+void kernel_min_sum_u8_batch(const uint8_t *q, const uint8_t *rows, size_t n,
+                             size_t stride, size_t len, uint32_t *out) {
+    kernels().min_sum_u8_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    kernel_min_sum_u16_batch
+
+    Integer histogram intersection of 15-bit codes over n rows.
+
+    Arguments:
+        const uint16_t *q - query codes (len values, at most 32767).
+        const uint16_t *rows - first row (segment) of the code matrix.
+        size_t n - number of rows.
+        size_t stride - codes between consecutive rows.
+        size_t len - codes compared per row.
+        uint32_t *out - output sums of minima, one per row.
+
+    Returns:
+        void.
+*/
+void kernel_min_sum_u16_batch(const uint16_t *q, const uint16_t *rows,
+                              size_t n, size_t stride, size_t len,
+                              uint32_t *out) {
+    kernels().min_sum_u16_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    kernel_dot_norms_batch
+
+    Batched kernel_dot_norms over n rows of a row-major matrix.
+
+    Arguments:
+        const float *q - query values (len floats).
+        const float *rows - first row of the matrix.
+        size_t n - number of rows.
+        size_t stride - floats between consecutive rows.
+        size_t len - values compared per row.
+        float *dot - output dot products, one per row.
+        float &nq - output squared norm of the query.
+        float *nr - output squared norms of the rows.
+
+    Returns:
+        void.
+*/
+void kernel_dot_norms_batch(const float *q, const float *rows, size_t n,
+                            size_t stride, size_t len, float *dot, float &nq,
+                            float *nr) {
+    kernels().dot_norms_batch(q, rows, n, stride, len, dot, nq, nr);
+}
+
+/*
+    distance_kernel_isa
+
+    Name of the instruction set the kernels dispatch to.
+
+    Returns:
+        "avx512", "avx2", "sse" or "scalar".
+*/
+const char *distance_kernel_isa() { return kernels().isa; }
@@ -0,0 +1,730 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - feature_db.cpp
+
+    This file implements the binary feature database, its read-only
+    memory-mapped loader, and CSV import/export helpers.
+*/
+
+#include "../include/feature_db.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/csv_io.h"
+
+/*
+    align_up
+
+    Round an offset up to the next multiple of FDB_ALIGN.
+
+    Arguments:
+        uint64_t off - file offset.
+
+    Returns:
+        aligned offset.
+*/
+static uint64_t align_up(uint64_t off) {
+    return (off + FDB_ALIGN - 1) / FDB_ALIGN * FDB_ALIGN;
+}
+
+/*
+    name_offsets_are_valid
+
+    Check that a name offset table starts at 0, never decreases and ends
+    at the size of the name block, so every name lies inside it.
+
+    Arguments:
+        const uint64_t *offsets - rows + 1 offsets.
+        uint64_t rows - number of rows.
+        uint64_t names_bytes - size of the name block.
+
+    Returns:
+        true if every name range is in bounds.
+*/
+static bool name_offsets_are_valid(const uint64_t *offsets, uint64_t rows,
+                                   uint64_t names_bytes) {
+    if (offsets[0] != 0 || offsets[rows] != names_bytes)
+        return false;
+    for (uint64_t i = 0; i < rows; i++)
+        if (offsets[i] > offsets[i + 1])
+            return false;
+    return true;
+}
+
+/*
+    header_is_valid
+
+    Check magic, version and that every section fits inside the file.
+
+    Arguments:
+        const FeatureDBHeader &hdr - header read from the file.
+        uint64_t file_size - total file size in bytes.
+
+    Returns:
+        true if the header describes a readable database.
+*/
+static bool header_is_valid(const FeatureDBHeader &hdr, uint64_t file_size) {
+    if (std::memcmp(hdr.magic, FDB_MAGIC, sizeof(FDB_MAGIC)) != 0 ||
+        hdr.version == 0 || hdr.version > FDB_VERSION)
+        return false;
+    if (hdr.matrix_offset > file_size || hdr.matrix_offset % FDB_ALIGN != 0)
+        return false;
+    // bound every size by what is left before the next section, dividing
+    // instead of multiplying so crafted counts cannot wrap around
+    if (hdr.names_offset % alignof(uint64_t) != 0 ||
+        hdr.names_offset > hdr.matrix_offset ||
+        hdr.rows >= (hdr.matrix_offset - hdr.names_offset) / sizeof(uint64_t))
+        return false;
+    const uint64_t table_end =
+        hdr.names_offset + (hdr.rows + 1) * sizeof(uint64_t);
+    if (hdr.names_bytes > hdr.matrix_offset - table_end)
+        return false;
+    const uint64_t matrix_floats =
+        (file_size - hdr.matrix_offset) / sizeof(float);
+    if (hdr.dim != 0 && hdr.rows > matrix_floats / hdr.dim)
+        return false;
+    if (hdr.stamps_offset != 0 &&
+        (hdr.stamps_offset > file_size ||
+         hdr.stamps_offset % alignof(FileStamp) != 0 ||
+         hdr.rows > (file_size - hdr.stamps_offset) / sizeof(FileStamp)))
+        return false;
+    if ((hdr.flags & FDB_FLAG_NORMALIZED) &&
+        (hdr.norms_offset == 0 || hdr.norms_offset > file_size ||
+         hdr.norms_offset % alignof(float) != 0 ||
+         hdr.rows > (file_size - hdr.norms_offset) / sizeof(float)))
+        return false;
+    return true;
+}
+
+/*
+    has_csv_extension
+
+    Return true if a path ends with ".csv".
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true for CSV paths.
+*/
+static bool has_csv_extension(const std::string &path) {
+    return path.size() >= 4 &&
+           path.compare(path.size() - 4, 4, ".csv") == 0;
+}
+
+/*
+    feature_db_append
+
+    Append one row to the database. The first row fixes the dimension.
+
+    Arguments:
+        FeatureDB &db - database to append to.
+        const std::string &name - image filename.
+        const std::vector<float> &feat - feature vector.
+
+    Returns:
+        true on success, false if the dimension does not match.
+*/
+bool feature_db_append(FeatureDB &db, const std::string &name,
+                       const std::vector<float> &feat) {
+    return feature_db_append_row(db, name, feat.data(), feat.size(), nullptr);
+}
+
+/*
+    feature_db_append_row
+
+    Append one row from a raw pointer, optionally with a file stamp.
+
+    Arguments:
+        FeatureDB &db - database to append to.
+        std::string_view name - image filename.
+        const float *feat - dim feature values.
+        size_t dim - number of values.
+        const FileStamp *stamp - file stamp, or nullptr if unknown.
+
+    Returns:
+        true on success, false if the dimension does not match.
+*/
+bool feature_db_append_row(FeatureDB &db, std::string_view name,
+                           const float *feat, size_t dim,
+                           const FileStamp *stamp) {
+    if (dim == 0)
+        return false;
+    if (db.rows == 0 && db.dim == 0)
+        db.dim = dim;
+    if (dim != db.dim)
+        return false;
+
+    // one missing stamp makes the whole column unknown
+    if (stamp && db.stamps.size() == db.rows)
+        db.stamps.push_back(*stamp);
+    else
+        db.stamps.clear();
+
+    db.name_chars += name;
+    db.name_offsets.push_back(db.name_chars.size());
+    db.data.insert(db.data.end(), feat, feat + dim);
+    if (db.normalized)
+        db.norms.push_back(normalize_l2(&db.data[db.rows * dim], dim));
+    db.rows++;
+    return true;
+}
+
+/*
+    normalize_l2
+
+    Scale a vector to unit L2 norm in place. The norm is accumulated in
+    double so near-zero and very long vectors come out at unit length.
+
+    Arguments:
+        float *v - vector to scale.
+        size_t dim - number of values.
+
+    Returns:
+        the vector's norm before scaling (0 leaves the vector unchanged).
+*/
+float normalize_l2(float *v, size_t dim) {
+    double sq = 0.0;
+    for (size_t i = 0; i < dim; i++)
+        sq += (double)v[i] * v[i];
+    const double norm = std::sqrt(sq);
+    if (norm > 0.0) {
+        for (size_t i = 0; i < dim; i++)
+            v[i] = (float)(v[i] / norm);
+    }
+    return (float)norm;
+}
+
+/*
+    feature_db_normalize
+
+    Scale every row to unit L2 norm and record the original norms.
+
+    Arguments:
+        FeatureDB &db - database to normalize.
+
+    Returns:
+        void.
+*/
+void feature_db_normalize(FeatureDB &db) {
+    if (db.normalized)
+        return;
+    db.norms.resize(db.rows);
+    for (size_t i = 0; i < db.rows; i++)
+        db.norms[i] = normalize_l2(&db.data[i * db.dim], db.dim);
+    db.normalized = true;
+}
+
+/*
+    feature_db_name
+
+    Return the filename of row i.
+
+    Arguments:
+        const FeatureDB &db - database.
+        size_t i - row index.
+
+    Returns:
+        filename view into the packed name storage.
+*/
+std::string_view feature_db_name(const FeatureDB &db, size_t i) {
+    const uint64_t b = db.name_offsets[i];
+    const uint64_t e = db.name_offsets[i + 1];
+    return std::string_view(db.name_chars.data() + b, e - b);
+}
+
+/*
+    feature_db_row
+
+    Return a pointer to the dim floats of row i.
+
+    Arguments:
+        const FeatureDB &db - database.
+        size_t i - row index.
+
+    Returns:
+        pointer to the first feature value of the row.
+*/
+const float *feature_db_row(const FeatureDB &db, size_t i) {
+    return db.data.data() + i * db.dim;
+}
+
+/*
+    feature_db_find
+
+    Find the row index of a filename.
+
+    Arguments:
+        const FeatureDB &db - database.
+        std::string_view name - filename to look up.
+        size_t &index - output row index.
+
+    Returns:
+        true if found, false otherwise.
+*/
+bool feature_db_find(const FeatureDB &db, std::string_view name,
+                     size_t &index) {
+    for (size_t i = 0; i < db.rows; i++) {
+        if (feature_db_name(db, i) == name) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    feature_db_view
+
+    Build a read-only view over an in-memory database.
+
+    Arguments:
+        const FeatureDB &db - database (must outlive the view).
+
+    Returns:
+        view of the database.
+*/
+FeatureDBView feature_db_view(const FeatureDB &db) {
+    FeatureDBView v;
+    v.task_id = db.task_id;
+    v.dim = db.dim;
+    v.rows = db.rows;
+    v.name_offsets = db.name_offsets.data();
+    v.name_chars = db.name_chars.data();
+    v.data = db.data.data();
+    v.stamps = db.stamps.size() == db.rows && db.rows > 0 ? db.stamps.data()
+                                                         : nullptr;
+    v.normalized = db.normalized;
+    v.norms = db.normalized ? db.norms.data() : nullptr;
+    v.decode_scale = db.decode_scale;
+    return v;
+}
+
+/*
+    feature_db_name
+
+    Return the filename of row i of a view.
+
+    Arguments:
+        const FeatureDBView &db - database view.
+        size_t i - row index.
+
+    Returns:
+        filename view into the packed name storage.
+*/
+std::string_view feature_db_name(const FeatureDBView &db, size_t i) {
+    const uint64_t b = db.name_offsets[i];
+    const uint64_t e = db.name_offsets[i + 1];
+    return std::string_view(db.name_chars + b, e - b);
+}
+
+/*
+    feature_db_row
+
+    Return a pointer to the dim floats of row i of a view.
+
+    Arguments:
+        const FeatureDBView &db - database view.
+        size_t i - row index.
+
+    Returns:
+        pointer to the first feature value of the row.
+*/
+const float *feature_db_row(const FeatureDBView &db, size_t i) {
+    return db.data + i * db.dim;
+}
+
+/*
+    feature_db_find
+
+    Find the row index of a filename in a view.
+
+    Arguments:
+        const FeatureDBView &db - database view.
+        std::string_view name - filename to look up.
+        size_t &index - output row index.
+
+    Returns:
+        true if found, false otherwise.
+*/
+bool feature_db_find(const FeatureDBView &db, std::string_view name,
+                     size_t &index) {
+    for (size_t i = 0; i < db.rows; i++) {
+        if (feature_db_name(db, i) == name) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    is_feature_db_file
+
+    Check whether a file starts with the binary feature database magic.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true if the file is a binary feature database.
+*/
+bool is_feature_db_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8] = {0};
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return std::memcmp(magic, FDB_MAGIC, sizeof(FDB_MAGIC)) == 0;
+}
+
+/*
+    write_feature_db
+
+    Write a database in the binary format: header, name table, the
+    64-byte aligned feature matrix, then the optional stamps and norms.
+
+    Arguments:
+        const std::string &path - output file path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_feature_db(const std::string &path, const FeatureDB &db) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    FeatureDBHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, FDB_MAGIC, sizeof(FDB_MAGIC));
+    hdr.version = FDB_VERSION;
+    hdr.task_id = db.task_id;
+    hdr.dim = (uint32_t)db.dim;
+    hdr.rows = db.rows;
+    hdr.names_offset = sizeof(FeatureDBHeader);
+    hdr.names_bytes = db.name_chars.size();
+    hdr.decode_scale = (uint32_t)db.decode_scale;
+
+    const uint64_t names_end = hdr.names_offset +
+                               (db.rows + 1) * sizeof(uint64_t) +
+                               hdr.names_bytes;
+    hdr.matrix_offset = align_up(names_end);
+    const uint64_t matrix_end =
+        hdr.matrix_offset + db.data.size() * sizeof(float);
+    const bool has_stamps = db.rows > 0 && db.stamps.size() == db.rows;
+    hdr.stamps_offset = has_stamps ? align_up(matrix_end) : 0;
+    const uint64_t stamps_end =
+        has_stamps ? hdr.stamps_offset + db.rows * sizeof(FileStamp)
+                   : matrix_end;
+    if (db.normalized) {
+        hdr.flags |= FDB_FLAG_NORMALIZED;
+        hdr.norms_offset = align_up(stamps_end);
+    }
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(db.name_offsets.data()),
+              (db.rows + 1) * sizeof(uint64_t));
+    out.write(db.name_chars.data(), db.name_chars.size());
+
+    const char pad[FDB_ALIGN] = {0};
+    out.write(pad, hdr.matrix_offset - names_end);
+    out.write(reinterpret_cast<const char *>(db.data.data()),
+              db.data.size() * sizeof(float));
+
+    if (has_stamps) {
+        out.write(pad, hdr.stamps_offset - matrix_end);
+        out.write(reinterpret_cast<const char *>(db.stamps.data()),
+                  db.rows * sizeof(FileStamp));
+    }
+
+    if (db.normalized) {
+        out.write(pad, hdr.norms_offset - stamps_end);
+        out.write(reinterpret_cast<const char *>(db.norms.data()),
+                  db.rows * sizeof(float));
+    }
+
+    return out.good();
+}
+
+/*
+    read_feature_db
+
+    Read a binary feature database into memory.
+
+    Arguments:
+        const std::string &path - input file path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_feature_db(const std::string &path, FeatureDB &db) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    FeatureDBHeader hdr;
+    if (!in.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+        return false;
+
+    // reject truncated files before allocating anything
+    in.seekg(0, std::ios::end);
+    if (!header_is_valid(hdr, (uint64_t)in.tellg()))
+        return false;
+
+    db.task_id = hdr.task_id;
+    db.dim = hdr.dim;
+    db.rows = hdr.rows;
+    db.decode_scale = hdr.decode_scale > 1 ? (int)hdr.decode_scale : 1;
+
+    db.name_offsets.resize(db.rows + 1);
+    in.seekg(hdr.names_offset);
+    in.read(reinterpret_cast<char *>(db.name_offsets.data()),
+            (db.rows + 1) * sizeof(uint64_t));
+
+    db.name_chars.resize(hdr.names_bytes);
+    in.read(db.name_chars.data(), hdr.names_bytes);
+
+    db.data.resize(db.rows * db.dim);
+    in.seekg(hdr.matrix_offset);
+    in.read(reinterpret_cast<char *>(db.data.data()),
+            db.data.size() * sizeof(float));
+
+    db.stamps.clear();
+    if (hdr.stamps_offset != 0) {
+        db.stamps.resize(db.rows);
+        in.seekg(hdr.stamps_offset);
+        in.read(reinterpret_cast<char *>(db.stamps.data()),
+                db.rows * sizeof(FileStamp));
+    }
+
+    db.normalized = (hdr.flags & FDB_FLAG_NORMALIZED) != 0;
+    db.norms.clear();
+    if (db.normalized) {
+        db.norms.resize(db.rows);
+        in.seekg(hdr.norms_offset);
+        in.read(reinterpret_cast<char *>(db.norms.data()),
+                db.rows * sizeof(float));
+    }
+
+    if (!in || !name_offsets_are_valid(db.name_offsets.data(), db.rows,
+                                       hdr.names_bytes))
+        return false;
+    return true;
+}
+
+/*
+    read_csv_db
+
+    Import a CSV feature file, skipping rows whose dimension differs from
+    the first valid row.
+
+    Arguments:
+        const std::string &path - input CSV path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false if the file cannot be opened or has no rows.
+*/
+bool read_csv_db(const std::string &path, FeatureDB &db) {
+    std::ifstream in(path);
+    if (!in.is_open())
+        return false;
+
+    db = FeatureDB();
+    std::string line;
+    std::string fname;
+    std::vector<float> feat;
+    size_t skipped = 0;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        if (!parse_csv_row(line, fname, feat))
+            continue;
+        if (!feature_db_append(db, fname, feat))
+            skipped++;
+    }
+
+    if (skipped > 0)
+        std::fprintf(stderr, "%s: skipped %zu rows with mismatched dims\n",
+                     path.c_str(), skipped);
+    return db.rows > 0;
+}
+
+/*
+    write_csv_db
+
+    Export a database as CSV rows (filename,f1,f2,...).
+
+    Arguments:
+        const std::string &path - output CSV path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_csv_db(const std::string &path, const FeatureDB &db) {
+    std::ofstream out(path);
+    if (!out.is_open())
+        return false;
+
+    std::vector<float> feat(db.dim);
+    for (size_t i = 0; i < db.rows; i++) {
+        const float *row = feature_db_row(db, i);
+        feat.assign(row, row + db.dim);
+        write_csv_row(out, std::string(feature_db_name(db, i)), feat);
+    }
+    return out.good();
+}
+
+/*
+    load_feature_db
+
+    Load a database from either format, detected by the file magic.
+
+    Arguments:
+        const std::string &path - binary database or CSV path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool load_feature_db(const std::string &path, FeatureDB &db) {
+    if (is_feature_db_file(path))
+        return read_feature_db(path, db);
+    return read_csv_db(path, db);
+}
+
+/*
+    map_feature_db
+
+    Open a database for querying. Binary files are mapped read-only and
+    the view points straight into the mapping; CSV files are parsed into
+    the handle's owned FeatureDB.
+
+    Arguments:
+        const std::string &path - binary database or CSV path.
+        MappedFeatureDB &db - output handle; db.view is set on success.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool map_feature_db(const std::string &path, MappedFeatureDB &db) {
+    unmap_feature_db(db);
+
+    if (!is_feature_db_file(path)) {
+        if (!read_csv_db(path, db.owned))
+            return false;
+        db.view = feature_db_view(db.owned);
+        return true;
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FeatureDBHeader)) {
+        close(fd);
+        return false;
+    }
+
+    const size_t len = (size_t)st.st_size;
+    void *base = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid after closing the descriptor
+    if (base == MAP_FAILED)
+        return false;
+
+    const FeatureDBHeader *hdr = static_cast<const FeatureDBHeader *>(base);
+    if (!header_is_valid(*hdr, len)) {
+        munmap(base, len);
+        return false;
+    }
+
+    // queries scan the matrix front to back
+    madvise(base, len, MADV_SEQUENTIAL);
+
+    const char *bytes = static_cast<const char *>(base);
+    db.map_base = base;
+    db.map_length = len;
+    db.view.task_id = hdr->task_id;
+    db.view.dim = hdr->dim;
+    db.view.rows = hdr->rows;
+    db.view.decode_scale =
+        hdr->decode_scale > 1 ? (int)hdr->decode_scale : 1;
+    db.view.name_offsets =
+        reinterpret_cast<const uint64_t *>(bytes + hdr->names_offset);
+    db.view.name_chars = bytes + hdr->names_offset +
+                         (hdr->rows + 1) * sizeof(uint64_t);
+    db.view.data = reinterpret_cast<const float *>(bytes + hdr->matrix_offset);
+    db.view.stamps =
+        hdr->stamps_offset
+            ? reinterpret_cast<const FileStamp *>(bytes + hdr->stamps_offset)
+            : nullptr;
+    db.view.normalized = (hdr->flags & FDB_FLAG_NORMALIZED) != 0;
+    db.view.norms =
+        db.view.normalized
+            ? reinterpret_cast<const float *>(bytes + hdr->norms_offset)
+            : nullptr;
+
+    if (!name_offsets_are_valid(db.view.name_offsets, db.view.rows,
+                                hdr->names_bytes)) {
+        unmap_feature_db(db);
+        return false;
+    }
+    return true;
+}
+
+/*
+    unmap_feature_db
+
+    Release a mapping or in-memory fallback and reset the view.
+
+    Arguments:
+        MappedFeatureDB &db - handle to release.
+
+    Returns:
+        void.
+*/
+void unmap_feature_db(MappedFeatureDB &db) {
+    if (db.map_base)
+        munmap(db.map_base, db.map_length);
+    db.map_base = nullptr;
+    db.map_length = 0;
+    db.owned = FeatureDB();
+    db.view = FeatureDBView();
+}
+
+/*
+    ~MappedFeatureDB
+
+    Release the mapping when the handle goes out of scope.
+*/
+MappedFeatureDB::~MappedFeatureDB() { unmap_feature_db(*this); }
+
+/*
+    save_feature_db
+
+    Save a database, choosing CSV for a ".csv" path and binary otherwise.
+
+    Arguments:
+        const std::string &path - output path.
+        const FeatureDB &db - database to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool save_feature_db(const std::string &path, const FeatureDB &db) {
+    if (has_csv_extension(path))
+        return write_csv_db(path, db);
+    return write_feature_db(path, db);
+}
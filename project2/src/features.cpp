@@ -10,6 +10,8 @@
 
 #include "../include/features.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
 
 /*
@@ -75,193 +77,378 @@ bool compute_task1_feature(const cv::Mat &img, std::vector<float> &feat) {
     return (feat.size() == 147);
 }
 
+// channel sums R + G + B of an 8-bit pixel: 0..765
+#define RG_SUMS (3 * 255 + 1)
+
 /*
-    compute_task2_feature_rg_hist
+    build_rg_bin_table
 
-    Compute Task 2 rg-chromaticity histogram with configurable bin count.
+    Build the rg-chromaticity bin lookup: entry [s * 256 + v] is the bin
+    of channel value v in a pixel whose channel sum is s. Entries are
+    evaluated with the same float division, scaling and clamps as the
+    per-pixel code they replace, so every pixel gets the same bin.
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
-        std::vector<float> &feat - output feature vector.
-        int bins - number of bins per channel.
+        int bins - number of bins per channel (1..256).
 
     Returns:
-        true on success, false on failure.
+        RG_SUMS x 256 table of bins.
 */
-bool compute_task2_feature_rg_hist(const cv::Mat &img, std::vector<float> &feat,
-                                   int bins) {
-    // Input validation: image must be non-empty, have at least 3 channels
-    // (BGR), and bins must be positive
-    if (img.empty() || img.channels() < 3 || bins <= 0)
-        return false;
+static std::vector<uint8_t> build_rg_bin_table(int bins) {
+    std::vector<uint8_t> table(RG_SUMS * 256, 0);
+    for (int s = 0; s < RG_SUMS; s++) {
+        float div = (float)s;
+        if (div <= 0.0f)
+            div = 1.0f;
+        // a channel never exceeds the sum, so larger v stay unused
+        for (int v = 0; v <= std::min(s, 255); v++) {
+            const float r = (float)v / div; // [0,1]
+            table[s * 256 + v] =
+                (uint8_t)std::clamp((int)(r * bins), 0, bins - 1);
+        }
+    }
+    return table;
+}
 
-    // Create 2D histogram:
-    // Size : bins×bins(default 16×16 = 256 bins total)
-    // Type: CV_32FC1(32 - bit float, single channel)
-    // Initialized to zeros
-    cv::Mat hist = cv::Mat::zeros(cv::Size(bins, bins), CV_32FC1);
+/*
+    rg_bin_table
 
-    // Pixel iteration and extract R, G, B values
-    const int rows = img.rows;
-    const int cols = img.cols;
+    Return the bin lookup for a bin count. The default 16-bin table is
+    built once and shared; other counts are built into `scratch`.
 
-    for (int i = 0; i < rows; i++) {
-        const cv::Vec3b *ptr = img.ptr<cv::Vec3b>(i); // BGR row
-        for (int j = 0; j < cols; j++) {
-            float B = ptr[j][0];
-            float G = ptr[j][1];
-            float R = ptr[j][2];
-
-            // compute rg chromaticity: r = R/(R+G+B), g = G/(R+G+B)
-            // normalize by sum to reduce sensitivity to lighting intensity
-            float div = R + G + B;
-            if (div <= 0.0f)
-                div = 1.0f;
-
-            float r = R / div; // [0,1]
-            float g = G / div; // [0,1]
-
-            // map to bin index: 0..bins-1
-            int rbin = (int)(r * bins);
-            int gbin = (int)(g * bins);
-
-            // clamp (avoid edge case r==1)
-            if (rbin >= bins)
-                rbin = bins - 1;
-            if (gbin >= bins)
-                gbin = bins - 1;
-            if (rbin < 0)
-                rbin = 0;
-            if (gbin < 0)
-                gbin = 0;
-
-            // Increment count for bin (rbin, gbin) Each pixel votes for one bin
-            // based on its color
-            hist.at<float>(rbin, gbin) += 1.0f;
-        }
-    }
+    Arguments:
+        int bins - number of bins per channel (1..256).
+        std::vector<uint8_t> &scratch - storage for non-default tables.
 
-    // normalize to probability (sum = 1) so that comparison is invariant to
-    // image size
-    hist /= (float)(rows * cols);
+    Returns:
+        pointer to the RG_SUMS x 256 table.
+*/
+static const uint8_t *rg_bin_table(int bins, std::vector<uint8_t> &scratch) {
+    static const std::vector<uint8_t> table16 = build_rg_bin_table(16);
+    if (bins == 16)
+        return table16.data();
+    scratch = build_rg_bin_table(bins);
+    return scratch.data();
+}
 
-    // flatten to feature vector (row-major)
-    // Convert 2D histogram (16×16 matrix) to 1D vector (256 elements)
-    feat.clear();
-    feat.reserve(bins * bins);
-    for (int r = 0; r < bins; r++) {
-        const float *hptr = hist.ptr<float>(r);
-        for (int c = 0; c < bins; c++)
-            feat.push_back(hptr[c]);
+/*
+    RgHist
+
+    Integer rg-chromaticity histogram under construction. Consecutive
+    pixels are counted into four private copies in turn, so runs of the
+    same bin do not wait on each other's stores; the copies are added
+    when the histogram is finished.
+*/
+struct RgHist {
+    int bins = 0;
+    const uint8_t *table = nullptr;
+    std::vector<uint8_t> scratch;
+    std::vector<uint32_t> lanes; // 4 x bins x bins counts
+};
+
+/*
+    rg_hist_init
+
+    Start an empty histogram.
+
+    Arguments:
+        RgHist &h - histogram to reset.
+        int bins - number of bins per channel (1..256).
+
+    Returns:
+        void.
+*/
+static void rg_hist_init(RgHist &h, int bins) {
+    h.bins = bins;
+    h.table = rg_bin_table(bins, h.scratch);
+    h.lanes.assign(4 * (size_t)bins * bins, 0);
+}
+
+/*
+    rg_count
+
+    Count n consecutive BGR pixels into four private copies of a
+    histogram, in turn. Each pixel's bins are two table reads from the
+    row of its channel sum; no division per pixel.
+
+    Arguments:
+        const uint8_t *table - bin lookup from rg_bin_table.
+        int bins - number of bins per channel.
+        const uchar *p - first pixel (3 bytes per pixel).
+        int n - number of pixels.
+        uint32_t *lanes - 4 x bins x bins counts to update.
+
+    Returns:
+        void.
+*/
+static void rg_count(const uint8_t *table, int bins, const uchar *p, int n,
+                     uint32_t *lanes) {
+    const size_t nb = (size_t)bins * bins;
+    uint32_t *c0 = lanes;
+    uint32_t *c1 = c0 + nb;
+    uint32_t *c2 = c1 + nb;
+    uint32_t *c3 = c2 + nb;
+    const auto bin = [table, bins](const uchar *px) {
+        const uint8_t *row = table + (px[0] + px[1] + px[2]) * 256;
+        return row[px[2]] * bins + row[px[1]]; // (rbin, gbin)
+    };
+
+    int j = 0;
+    for (; j + 4 <= n; j += 4, p += 12) {
+        c0[bin(p)]++;
+        c1[bin(p + 3)]++;
+        c2[bin(p + 6)]++;
+        c3[bin(p + 9)]++;
     }
-    return true;
+    for (; j < n; j++, p += 3)
+        c0[bin(p)]++;
 }
 
 /*
-    compute_task2_feature
+    rg_hist_add
 
-    Task 2 wrapper using default bin count.
+    Count n consecutive BGR pixels.
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
-        std::vector<float> &feat - output feature vector.
+        RgHist &h - histogram to update.
+        const uchar *p - first pixel (3 bytes per pixel).
+        int n - number of pixels.
 
     Returns:
-        true on success, false on failure.
+        void.
 */
-bool compute_task2_feature(const cv::Mat &img, std::vector<float> &feat) {
-    // default to 16 bins
-    return compute_task2_feature_rg_hist(img, feat, 16);
+static void rg_hist_add(RgHist &h, const uchar *p, int n) {
+    rg_count(h.table, h.bins, p, n, h.lanes.data());
 }
 
-// Compute rg chromaticity histogram on a ROI(Region of Interest)
-// ROI is [x0, x0+w) x [y0, y0+h), clamped to image bounds.
-// Output is flattened bins*bins, normalized (sum=1).
 /*
-    compute_rg_hist_roi
+    rg_normalize
 
-    Compute an rg-chromaticity histogram over a clamped ROI.
+    Normalize bin counts to a probability (sum = 1) so comparisons are
+    invariant to image size, flattened row-major.
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
-        std::vector<float> &out - output histogram vector.
+        const uint32_t *counts - bins x bins counts.
         int bins - number of bins per channel.
-        int x0 - ROI x origin.
-        int y0 - ROI y origin.
-        int w - ROI width.
-        int h - ROI height.
+        int pixels - number of pixels counted.
+        std::vector<float> &out - output, bins x bins values.
 
     Returns:
-        true on success, false on failure.
+        void.
 */
-static bool compute_rg_hist_roi(const cv::Mat &img, std::vector<float> &out,
-                                int bins, int x0, int y0, int w, int h) {
-    if (img.empty() || img.channels() < 3 || bins <= 0)
-        return false;
+static void rg_normalize(const uint32_t *counts, int bins, int pixels,
+                         std::vector<float> &out) {
+    const size_t nb = (size_t)bins * bins;
+    cv::Mat hist = cv::Mat::zeros(cv::Size(bins, bins), CV_32FC1);
+    float *hp = hist.ptr<float>(0);
+    for (size_t k = 0; k < nb; k++)
+        hp[k] = (float)counts[k];
+    hist /= (float)pixels;
+
+    out.assign(hp, hp + nb);
+}
+
+/*
+    rg_hist_finish
+
+    Add up the private copies and normalize the histogram.
+
+    Arguments:
+        const RgHist &h - counted histogram.
+        int pixels - number of pixels counted.
+        std::vector<float> &out - output, bins x bins values.
 
-    // clamp ROI
-    x0 = std::max(0, x0);
-    y0 = std::max(0, y0);
-    int x1 = std::min(img.cols, x0 + w);
-    int y1 = std::min(img.rows, y0 + h);
+    Returns:
+        void.
+*/
+static void rg_hist_finish(const RgHist &h, int pixels,
+                           std::vector<float> &out) {
+    const size_t nb = (size_t)h.bins * h.bins;
+    std::vector<uint32_t> counts(nb);
+    for (size_t k = 0; k < nb; k++)
+        counts[k] = h.lanes[k] + h.lanes[nb + k] + h.lanes[2 * nb + k] +
+                    h.lanes[3 * nb + k];
+    rg_normalize(counts.data(), h.bins, pixels, out);
+}
 
-    // check if ROI is valid (non-empty)
-    if (x1 <= x0 || y1 <= y0)
+/*
+    RgRegions
+
+    Region histogram engine: rg-chromaticity counts of the image cut
+    into a grid at given columns and rows, kept as 2D prefix sums over
+    the grid cells (an integral histogram at cell resolution). One pass
+    over the image builds it; the histogram of any rectangle whose edges
+    are cuts then takes four lookups per bin, so multi-region features
+    (center, quadrants, 3x3 grids) cost one pass however many regions
+    they read.
+*/
+struct RgRegions {
+    int bins = 0;
+    std::vector<int> xs; // sorted column cuts, 0 .. cols
+    std::vector<int> ys; // sorted row cuts, 0 .. rows
+    // ys x xs x bins^2: prefix[(r * xs + c) * bins^2 + k] counts bin k
+    // over [0, xs[c]) x [0, ys[r])
+    std::vector<uint32_t> prefix;
+};
+
+/*
+    rg_regions_build
+
+    Count every grid cell in one pass (one band of cells at a time) and
+    accumulate the prefix sums.
+
+    Arguments:
+        const cv::Mat &img - input image (BGR).
+        int bins - number of bins per channel (1..256).
+        std::vector<int> xs - column cuts (image edges are added).
+        std::vector<int> ys - row cuts (image edges are added).
+        RgRegions &reg - output engine.
+
+    Returns:
+        true on success, false on failure.
+*/
+static bool rg_regions_build(const cv::Mat &img, int bins, std::vector<int> xs,
+                             std::vector<int> ys, RgRegions &reg) {
+    if (img.empty() || img.channels() < 3 || bins <= 0 || bins > 256)
         return false;
 
-    // Create histogram for ROI (same as whole image, but only for pixels in
-    // ROI)
-    cv::Mat hist = cv::Mat::zeros(cv::Size(bins, bins), CV_32FC1);
+    const auto sort_cuts = [](std::vector<int> &cuts, int end) {
+        for (int &c : cuts)
+            c = std::clamp(c, 0, end);
+        cuts.push_back(0);
+        cuts.push_back(end);
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+    };
+    sort_cuts(xs, img.cols);
+    sort_cuts(ys, img.rows);
+
+    const size_t nb = (size_t)bins * bins;
+    const size_t nx = xs.size();
+    const size_t ny = ys.size();
+    std::vector<uint8_t> scratch;
+    const uint8_t *table = rg_bin_table(bins, scratch);
+
+    reg.bins = bins;
+    reg.prefix.assign(ny * nx * nb, 0); // row 0 and column 0 stay zero
+    std::vector<uint32_t> lanes((nx - 1) * 4 * nb);
+    std::vector<uint32_t> band(nb);
+    for (size_t b = 0; b + 1 < ny; b++) {
+        std::fill(lanes.begin(), lanes.end(), 0);
+        for (int i = ys[b]; i < ys[b + 1]; i++) {
+            const uchar *row = img.ptr<uchar>(i);
+            for (size_t c = 0; c + 1 < nx; c++)
+                rg_count(table, bins, row + 3 * xs[c], xs[c + 1] - xs[c],
+                         &lanes[c * 4 * nb]);
+        }
 
-    // iterate ROI and compute histogram (same as whole image, but only for
-    // pixels in ROI)
-    const int roi_rows = y1 - y0;
-    const int roi_cols = x1 - x0;
-
-    for (int i = y0; i < y1; i++) {
-        const cv::Vec3b *ptr = img.ptr<cv::Vec3b>(i); // BGR row
-        for (int j = x0; j < x1; j++) {
-            float B = ptr[j][0];
-            float G = ptr[j][1];
-            float R = ptr[j][2];
-
-            float div = R + G + B;
-            if (div <= 0.0f)
-                div = 1.0f;
-
-            float r = R / div; // [0,1]
-            float g = G / div; // [0,1]
-
-            int rbin = (int)(r * bins);
-            int gbin = (int)(g * bins);
-
-            if (rbin >= bins)
-                rbin = bins - 1;
-            if (gbin >= bins)
-                gbin = bins - 1;
-            if (rbin < 0)
-                rbin = 0;
-            if (gbin < 0)
-                gbin = 0;
-
-            hist.at<float>(rbin, gbin) += 1.0f;
+        // prefix[b + 1][c + 1] = prefix[b][c + 1] + cells 0..c of band b
+        std::fill(band.begin(), band.end(), 0);
+        const uint32_t *above = &reg.prefix[b * nx * nb];
+        uint32_t *cur = &reg.prefix[(b + 1) * nx * nb];
+        for (size_t c = 0; c + 1 < nx; c++) {
+            const uint32_t *cell = &lanes[c * 4 * nb];
+            for (size_t k = 0; k < nb; k++) {
+                band[k] += cell[k] + cell[nb + k] + cell[2 * nb + k] +
+                           cell[3 * nb + k];
+                cur[(c + 1) * nb + k] = above[(c + 1) * nb + k] + band[k];
+            }
         }
     }
+    reg.xs = std::move(xs);
+    reg.ys = std::move(ys);
+    return true;
+}
 
-    // normalize by ROI pixel count
-    hist /= (float)(roi_rows * roi_cols);
+/*
+    rg_regions_hist
 
-    // flatten to output vector
-    out.clear();
-    out.reserve(bins * bins);
-    for (int r = 0; r < bins; r++) {
-        const float *hptr = hist.ptr<float>(r);
-        for (int c = 0; c < bins; c++)
-            out.push_back(hptr[c]);
-    }
+    Normalized histogram of the rectangle [x0, x1) x [y0, y1), whose
+    edges must be cuts of the engine.
+
+    Arguments:
+        const RgRegions &reg - built engine.
+        int x0 - left column (a cut).
+        int y0 - top row (a cut).
+        int x1 - right column, exclusive (a cut).
+        int y1 - bottom row, exclusive (a cut).
+        std::vector<float> &out - output, bins x bins values.
+
+    Returns:
+        true on success, false if the rectangle is empty or not on cuts.
+*/
+static bool rg_regions_hist(const RgRegions &reg, int x0, int y0, int x1,
+                            int y1, std::vector<float> &out) {
+    const auto cut = [](const std::vector<int> &cuts, int v, size_t &idx) {
+        const auto it = std::lower_bound(cuts.begin(), cuts.end(), v);
+        idx = (size_t)(it - cuts.begin());
+        return it != cuts.end() && *it == v;
+    };
+    size_t c0, c1, r0, r1;
+    if (x1 <= x0 || y1 <= y0 || !cut(reg.xs, x0, c0) ||
+        !cut(reg.xs, x1, c1) || !cut(reg.ys, y0, r0) || !cut(reg.ys, y1, r1))
+        return false;
+
+    const size_t nb = (size_t)reg.bins * reg.bins;
+    const size_t nx = reg.xs.size();
+    const uint32_t *p00 = &reg.prefix[(r0 * nx + c0) * nb];
+    const uint32_t *p01 = &reg.prefix[(r0 * nx + c1) * nb];
+    const uint32_t *p10 = &reg.prefix[(r1 * nx + c0) * nb];
+    const uint32_t *p11 = &reg.prefix[(r1 * nx + c1) * nb];
+    std::vector<uint32_t> counts(nb);
+    for (size_t k = 0; k < nb; k++)
+        counts[k] = p11[k] - p10[k] - p01[k] + p00[k];
+    rg_normalize(counts.data(), reg.bins, (x1 - x0) * (y1 - y0), out);
+    return true;
+}
+
+/*
+    compute_task2_feature_rg_hist
+
+    Compute Task 2 rg-chromaticity histogram with configurable bin count.
+
+    Arguments:
+        const cv::Mat &img - input image (BGR).
+        std::vector<float> &feat - output feature vector.
+        int bins - number of bins per channel (1..256).
+
+    Returns:
+        true on success, false on failure.
+*/
+bool compute_task2_feature_rg_hist(const cv::Mat &img, std::vector<float> &feat,
+                                   int bins) {
+    // Input validation: image must be non-empty, have at least 3 channels
+    // (BGR), and bins must fit the one-byte lookup table
+    if (img.empty() || img.channels() < 3 || bins <= 0 || bins > 256)
+        return false;
+
+    // each pixel votes for one bin (r = R/(R+G+B), g = G/(R+G+B)); the
+    // histogram is flattened row-major: 16x16 bins => 256 values
+    RgHist h;
+    rg_hist_init(h, bins);
+    for (int i = 0; i < img.rows; i++)
+        rg_hist_add(h, img.ptr<uchar>(i), img.cols);
+    rg_hist_finish(h, img.rows * img.cols, feat);
     return true;
 }
 
+/*
+    compute_task2_feature
+
+    Task 2 wrapper using default bin count.
+
+    Arguments:
+        const cv::Mat &img - input image (BGR).
+        std::vector<float> &feat - output feature vector.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool compute_task2_feature(const cv::Mat &img, std::vector<float> &feat) {
+    // default to 16 bins
+    return compute_task2_feature_rg_hist(img, feat, 16);
+}
+
 /*
     compute_task3_feature
 
@@ -283,17 +470,20 @@ bool compute_task3_feature(const cv::Mat &img, std::vector<float> &feat) {
     std::vector<float> h_whole;
     std::vector<float> h_center;
 
-    // whole image ROI
-    if (!compute_rg_hist_roi(img, h_whole, bins, 0, 0, img.cols, img.rows))
-        return false;
-
     // center ROI: middle 50% x 50%
     const int cw = img.cols / 2;
     const int ch = img.rows / 2;
     const int cx0 = (img.cols - cw) / 2;
     const int cy0 = (img.rows - ch) / 2;
 
-    if (!compute_rg_hist_roi(img, h_center, bins, cx0, cy0, cw, ch))
+    // one pass over the image, cut at the center ROI's edges; both
+    // histograms are then read from the region engine
+    RgRegions regions;
+    if (!rg_regions_build(img, bins, {cx0, cx0 + cw}, {cy0, cy0 + ch},
+                          regions))
+        return false;
+    if (!rg_regions_hist(regions, 0, 0, img.cols, img.rows, h_whole) ||
+        !rg_regions_hist(regions, cx0, cy0, cx0 + cw, cy0 + ch, h_center))
         return false;
 
     // concatenate:
@@ -307,149 +497,167 @@ bool compute_task3_feature(const cv::Mat &img, std::vector<float> &feat) {
     return (feat.size() == (size_t)(2 * bins * bins));
 }
 
-// 1D histogram of Sobel gradient magnitudes (normalized, sum=1)
 /*
-    compute_sobel_mag_hist
+    reflect101
 
-    Compute a normalized histogram of Sobel gradient magnitudes.
+    Border index as cv::BORDER_REFLECT_101 (cv::Sobel's default) maps it:
+    -1 -> 1 and n -> n - 2.
 
     Arguments:
-        const cv::Mat &img - input image.
-        std::vector<float> &hist - output histogram vector.
-        int bins - number of bins.
+        int i - index, at most one step outside [0, n).
+        int n - length.
 
     Returns:
-        true on success, false on failure.
+        index inside [0, n).
 */
-static bool compute_sobel_mag_hist(const cv::Mat &img, std::vector<float> &hist,
-                                   int bins) {
-    if (img.empty() || bins <= 0)
-        return false;
+static int reflect101(int i, int n) {
+    if (n == 1)
+        return 0;
+    if (i < 0)
+        return -i;
+    if (i >= n)
+        return 2 * n - 2 - i;
+    return i;
+}
 
-    cv::Mat bgr;
-    if (img.channels() == 3)
-        bgr = img;
-    else if (img.channels() == 1)
-        cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
-    else
-        return false;
+// rows per cv::cvtColor, cv::magnitude and cv::phase call: enough to keep
+// the per-call overhead small, while buffers stay a few rows tall
+#define TASK4_BAND 32
 
-    cv::Mat gray;
-    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
-
-    cv::Mat gx, gy;
-    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-
-    cv::Mat mag;
-    cv::magnitude(gx, gy, mag);
-
-    double maxv = 0.0;
-    cv::minMaxLoc(mag, nullptr, &maxv);
-    const float denom = (float)(maxv + 1e-6);
-
-    hist.assign(bins, 0.0f);
-
-    const int rows = mag.rows;
-    const int cols = mag.cols;
-    for (int i = 0; i < rows; i++) {
-        const float *mp = mag.ptr<float>(i);
-        for (int j = 0; j < cols; j++) {
-            float v = mp[j] / denom; // normalize to [0,1]
-            if (v < 0.0f)
-                v = 0.0f;
-            if (v > 1.0f)
-                v = 1.0f;
-            int bin = (int)(v * bins);
-            if (bin >= bins)
-                bin = bins - 1;
-            hist[bin] += 1.0f;
-        }
+// shortest row handed to cv::magnitude and cv::phase: twice the widest
+// SIMD register (16 floats), so every value comes from their SIMD loops,
+// as for a whole image (images under this many pixels take the scalar
+// loops there)
+#define PHASE_MIN_LEN 32
+
+/*
+    GrayWindow
+
+    Three gray rows (i - 1, i, i + 1) around the current image row, each
+    padded by one reflected value per side, as cv::Sobel sees them, and
+    the band of gray rows they are copied from.
+*/
+struct GrayWindow {
+    std::vector<int> buf;
+    int *up = nullptr;
+    int *mid = nullptr;
+    int *down = nullptr;
+    cv::Mat gray;       // cv::cvtColor output for rows [begin, end)
+    int gray_begin = 0;
+    int gray_end = 0;
+};
+
+/*
+    gray_row
+
+    Copy gray row r into a window row, padded by one reflected value on
+    each side for the Sobel taps. Rows are converted with cv::cvtColor a
+    band of TASK4_BAND at a time (per pixel, so a band gets the values
+    the whole image would).
+
+    Arguments:
+        const cv::Mat &img - input image (BGR, 8-bit).
+        int r - row to fetch.
+        GrayWindow &w - window whose gray band is used.
+        int *out - output, cols + 2 values (out[1 + j] = pixel j).
+
+    Returns:
+        void.
+*/
+static void gray_row(const cv::Mat &img, int r, GrayWindow &w, int *out) {
+    const int cols = img.cols;
+    if (r < w.gray_begin || r >= w.gray_end) {
+        w.gray_begin = r;
+        w.gray_end = std::min(r + TASK4_BAND, img.rows);
+        cv::cvtColor(img.rowRange(w.gray_begin, w.gray_end), w.gray,
+                     cv::COLOR_BGR2GRAY);
     }
+    const uchar *g = w.gray.ptr<uchar>(r - w.gray_begin);
+    for (int j = 0; j < cols; j++)
+        out[1 + j] = g[j];
+    out[0] = out[1 + reflect101(-1, cols)];
+    out[cols + 1] = out[1 + reflect101(cols, cols)];
+}
 
-    const float total = (float)(rows * cols);
-    if (total <= 0.0f)
-        return false;
-    for (float &x : hist)
-        x /= total; // sum=1
+/*
+    gray_window_start
 
-    return true;
+    Fill the window around row 0 (row -1 reflects to row 1).
+
+    Arguments:
+        const cv::Mat &img - input image (BGR, 8-bit).
+        GrayWindow &w - window to fill.
+
+    Returns:
+        void.
+*/
+static void gray_window_start(const cv::Mat &img, GrayWindow &w) {
+    const int cols = img.cols;
+    w.buf.resize(3 * (cols + 2));
+    w.up = &w.buf[0];
+    w.mid = &w.buf[cols + 2];
+    w.down = &w.buf[2 * (cols + 2)];
+    w.gray_begin = w.gray_end = 0;
+    gray_row(img, 0, w, w.mid);
+    gray_row(img, reflect101(1, img.rows), w, w.down);
+    std::copy(w.down, w.down + cols + 2, w.up);
 }
 
-// 1D histogram of Sobel gradient orientations (normalized, sum=1)
-// Orientation is "unsigned": [0,180) degrees (so edges with opposite direction
-// match)
 /*
-    compute_sobel_ori_hist
+    gray_window_next
 
-    Compute a normalized histogram of unsigned Sobel orientations.
+    Slide the window from row i down to row i + 1.
 
     Arguments:
-        const cv::Mat &img - input image.
-        std::vector<float> &hist - output histogram vector.
-        int bins - number of bins.
+        const cv::Mat &img - input image (BGR, 8-bit).
+        int i - current row (i + 1 < img.rows).
+        GrayWindow &w - window to slide.
 
     Returns:
-        true on success, false on failure.
+        void.
 */
-static bool compute_sobel_ori_hist(const cv::Mat &img, std::vector<float> &hist,
-                                   int bins) {
-    if (img.empty() || bins <= 0)
-        return false;
+static void gray_window_next(const cv::Mat &img, int i, GrayWindow &w) {
+    int *old = w.up;
+    w.up = w.mid;
+    w.mid = w.down;
+    w.down = old;
+    gray_row(img, reflect101(i + 2, img.rows), w, w.down);
+}
 
-    cv::Mat bgr;
-    if (img.channels() == 3)
-        bgr = img;
-    else if (img.channels() == 1)
-        cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
-    else
-        return false;
+/*
+    sobel_band
 
-    cv::Mat gray;
-    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
-
-    cv::Mat gx, gy;
-    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-
-    // angle in degrees [0,360)
-    cv::Mat ang;
-    cv::phase(gx, gy, ang, true);
-
-    hist.assign(bins, 0.0f);
-
-    const int rows = ang.rows;
-    const int cols = ang.cols;
-    for (int i = 0; i < rows; i++) {
-        const float *ap = ang.ptr<float>(i);
-        for (int j = 0; j < cols; j++) {
-            float a = ap[j]; // [0,360)
-            // fold to [0,180)
-            if (a >= 180.0f)
-                a -= 180.0f;
-
-            // map to bins
-            float t = a / 180.0f; // [0,1)
-            if (t < 0.0f)
-                t = 0.0f;
-            if (t >= 1.0f)
-                t = std::nextafter(1.0f, 0.0f);
-
-            int bin = (int)(t * bins);
-            if (bin >= bins)
-                bin = bins - 1;
-
-            hist[bin] += 1.0f;
-        }
-    }
+    3x3 Sobel gradients of rows [b, b + n), one per row of gx and gy,
+    sliding the window down as it goes. The values are small integers,
+    so they are exact in float, as cv::Sobel's CV_32F output.
 
-    const float total = (float)(rows * cols);
-    if (total <= 0.0f)
-        return false;
-    for (float &x : hist)
-        x /= total; // sum=1
+    Arguments:
+        const cv::Mat &img - input image (BGR, 8-bit).
+        int b - first row; the window must be centered on it.
+        int n - rows (at most TASK4_BAND).
+        GrayWindow &w - gray window.
+        cv::Mat &gx - output x gradients, row k = image row b + k.
+        cv::Mat &gy - output y gradients, row k = image row b + k.
 
-    return true;
+    Returns:
+        void.
+*/
+static void sobel_band(const cv::Mat &img, int b, int n, GrayWindow &w,
+                       cv::Mat &gx, cv::Mat &gy) {
+    const int cols = img.cols;
+    for (int k = 0; k < n; k++) {
+        const int *up = w.up, *mid = w.mid, *down = w.down;
+        float *px = gx.ptr<float>(k);
+        float *py = gy.ptr<float>(k);
+        for (int j = 1; j <= cols; j++) {
+            px[j - 1] = (float)((up[j + 1] + 2 * mid[j + 1] + down[j + 1]) -
+                                (up[j - 1] + 2 * mid[j - 1] + down[j - 1]));
+            py[j - 1] = (float)((down[j - 1] + 2 * down[j] + down[j + 1]) -
+                                (up[j - 1] + 2 * up[j] + up[j + 1]));
+        }
+        if (b + k + 1 < img.rows)
+            gray_window_next(img, b + k, w);
+    }
 }
 
 // Task 4 feature: whole-image color hist + whole-image texture hists (mag +
@@ -457,43 +665,106 @@ static bool compute_sobel_ori_hist(const cv::Mat &img, std::vector<float> &hist,
 /*
     compute_task4_feature
 
-    Compute Task 4 feature: color histogram plus texture histograms.
+    Compute Task 4 feature: color histogram plus texture histograms, in
+    two walks over the image in bands of TASK4_BAND rows, with buffers a
+    band tall. Gray rows (cv::cvtColor) slide through a three-row window,
+    from which the 3x3 Sobel gradients are taken (reflected borders, as
+    cv::Sobel). The first walk bins rg chromaticity (as in Task 2) and
+    orientation and finds the largest magnitude; the second recomputes
+    the gradients and bins magnitudes relative to it. Magnitude and
+    orientation come from cv::magnitude and cv::phase on each band, so
+    they equal the whole-image calls (test_task4_feature).
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
+        const cv::Mat &img - input image (BGR, 8-bit).
         std::vector<float> &feat - output feature vector.
 
     Returns:
         true on success, false on failure.
 */
 bool compute_task4_feature(const cv::Mat &img, std::vector<float> &feat) {
-    if (img.empty())
+    if (img.empty() || img.channels() != 3 || img.depth() != CV_8U)
         return false;
 
-    // Color part (reuse Task2): rg chromaticity 2D hist with 16 bins => 256
-    // dims
-    std::vector<float> color;
-    if (!compute_task2_feature_rg_hist(img, color, 16))
-        return false;
-
-    // Texture parts
+    const int bins = 16;     // rg chromaticity bins per channel => 256 dims
     const int mag_bins = 16;
     const int ori_bins = 18; // you can change to 16 if you want symmetry
+    const int rows = img.rows;
+    const int cols = img.cols;
 
-    std::vector<float> mag_hist;
-    std::vector<float> ori_hist;
-
-    if (!compute_sobel_mag_hist(img, mag_hist, mag_bins))
-        return false;
+    RgHist color;
+    rg_hist_init(color, bins);
+    std::vector<int> ori(ori_bins, 0);
+    std::vector<int> mag(mag_bins, 0);
+    float max_mag = 0.0f;
+
+    // gradient bands, rows zero padded to PHASE_MIN_LEN
+    const int len = std::max(cols, PHASE_MIN_LEN);
+    cv::Mat gx(TASK4_BAND, len, CV_32F, cv::Scalar(0));
+    cv::Mat gy(TASK4_BAND, len, CV_32F, cv::Scalar(0));
+    cv::Mat m(TASK4_BAND, len, CV_32F);
+    cv::Mat ang(TASK4_BAND, len, CV_32F);
+    GrayWindow w;
+
+    // first walk: color, orientation and the largest magnitude
+    gray_window_start(img, w);
+    for (int b = 0; b < rows; b += TASK4_BAND) {
+        const int n = std::min(TASK4_BAND, rows - b);
+        sobel_band(img, b, n, w, gx, gy);
+        cv::Mat mb = m.rowRange(0, n), ab = ang.rowRange(0, n);
+        cv::magnitude(gx.rowRange(0, n), gy.rowRange(0, n), mb);
+        // angle in degrees [0,360)
+        cv::phase(gx.rowRange(0, n), gy.rowRange(0, n), ab, true);
+
+        for (int k = 0; k < n; k++) {
+            // color: rg chromaticity bin of each pixel, as in Task 2
+            rg_hist_add(color, img.ptr<uchar>(b + k), cols);
+
+            const float *pm = mb.ptr<float>(k);
+            const float *pa = ab.ptr<float>(k);
+            for (int j = 0; j < cols; j++) {
+                max_mag = std::max(max_mag, pm[j]);
+
+                // unsigned orientation: fold to [0,180)
+                float a = pa[j];
+                if (a >= 180.0f)
+                    a -= 180.0f;
+                float t = a / 180.0f; // [0,1)
+                if (t < 0.0f)
+                    t = 0.0f;
+                if (t >= 1.0f)
+                    t = std::nextafter(1.0f, 0.0f);
+                ori[std::min((int)(t * ori_bins), ori_bins - 1)]++;
+            }
+        }
+    }
 
-    if (!compute_sobel_ori_hist(img, ori_hist, ori_bins))
-        return false;
+    // second walk: magnitude bins, normalized by the largest to [0,1]
+    const float denom = (float)(max_mag + 1e-6);
+    gray_window_start(img, w);
+    for (int b = 0; b < rows; b += TASK4_BAND) {
+        const int n = std::min(TASK4_BAND, rows - b);
+        sobel_band(img, b, n, w, gx, gy);
+        cv::Mat mb = m.rowRange(0, n);
+        cv::magnitude(gx.rowRange(0, n), gy.rowRange(0, n), mb);
+
+        for (int k = 0; k < n; k++) {
+            const float *pm = mb.ptr<float>(k);
+            for (int j = 0; j < cols; j++) {
+                const float v = std::min(pm[j] / denom, 1.0f);
+                mag[std::min((int)(v * mag_bins), mag_bins - 1)]++;
+            }
+        }
+    }
 
-    feat.clear();
-    feat.reserve(color.size() + mag_hist.size() + ori_hist.size());
-    feat.insert(feat.end(), color.begin(), color.end());
-    feat.insert(feat.end(), mag_hist.begin(), mag_hist.end());
-    feat.insert(feat.end(), ori_hist.begin(), ori_hist.end());
+    // normalize each histogram to sum 1, as the per-part extractors did
+    const int total = rows * cols;
+    rg_hist_finish(color, total, feat);
+    feat.reserve(feat.size() + mag_bins + ori_bins);
+    for (const int c : mag)
+        feat.push_back((float)c / (float)total);
+    for (const int c : ori)
+        feat.push_back((float)c / (float)total);
 
     return true;
 }
@@ -505,18 +776,30 @@ bool compute_task4_feature(const cv::Mat &img, std::vector<float> &feat) {
     Extract Task 7 grass features (green ratio + HSV statistics).
 
     Arguments:
-        const cv::Mat &img - input image (BGR).
+        const cv::Mat &img - input image (BGR, gray or BGRA, 8-bit).
         std::vector<float> &feat - output 5D feature vector.
 
     Returns:
         true on success, false on failure.
 */
 bool extract_grass_features(const cv::Mat &img, std::vector<float> &feat) {
-    if (img.empty())
+    if (img.empty() || img.depth() != CV_8U)
+        return false;
+
+    // build_db decodes unchanged, so accept what cv::imread's color mode
+    // would have converted
+    cv::Mat bgr;
+    if (img.channels() == 3)
+        bgr = img;
+    else if (img.channels() == 1)
+        cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
+    else if (img.channels() == 4)
+        cv::cvtColor(img, bgr, cv::COLOR_BGRA2BGR);
+    else
         return false;
 
     cv::Mat hsv;
-    cv::cvtColor(img, hsv, cv::COLOR_BGR2HSV);
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
 
     // Green range for grass
     const int H_LOW = 35;  // 70 degrees
@@ -0,0 +1,535 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - hnsw.cpp
+
+    This file implements HNSW graph construction, search and persistence
+    (Malkov & Yashunin, "Efficient and robust approximate nearest neighbor
+    search using Hierarchical Navigable Small World graphs").
+*/
+
+#include "../include/hnsw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <random>
+
+// highest level a node can be assigned (levels are stored as uint8)
+#define HNSW_MAX_LEVEL 31
+
+/*
+    closer
+
+    Order matches by distance, then by row, so graph construction and
+    search results are deterministic.
+*/
+static bool closer(const RowMatch &a, const RowMatch &b) {
+    return a.dist < b.dist || (a.dist == b.dist && a.row < b.row);
+}
+
+// priority_queue orders: top() is the farthest / the closest match
+struct FartherOnTop {
+    bool operator()(const RowMatch &a, const RowMatch &b) const {
+        return closer(a, b);
+    }
+};
+struct CloserOnTop {
+    bool operator()(const RowMatch &a, const RowMatch &b) const {
+        return closer(b, a);
+    }
+};
+using FarHeap =
+    std::priority_queue<RowMatch, std::vector<RowMatch>, FartherOnTop>;
+using NearHeap =
+    std::priority_queue<RowMatch, std::vector<RowMatch>, CloserOnTop>;
+
+/*
+    VisitedSet
+
+    Per-search visited marks. Bumping the epoch clears every mark in O(1),
+    so one set is reused across searches on the same thread.
+*/
+struct VisitedSet {
+    std::vector<uint32_t> tag;
+    uint32_t epoch = 0;
+
+    void reset(size_t rows) {
+        if (tag.size() != rows || ++epoch == 0) {
+            tag.assign(rows, 0);
+            epoch = 1;
+        }
+    }
+    bool insert(uint32_t node) {
+        if (tag[node] == epoch)
+            return false;
+        tag[node] = epoch;
+        return true;
+    }
+};
+
+/*
+    Graph
+
+    What construction and search need: the index, the vectors it points
+    into, and the distance function.
+*/
+struct Graph {
+    HnswIndex &index;
+    const FeatureDBView &db;
+    BatchDistFunc dist;
+    size_t evals = 0;
+
+    float distance(const float *q, size_t row) {
+        float d;
+        dist(q, feature_db_row(db, row), 1, db.dim, &d);
+        evals++;
+        return d;
+    }
+
+    // link list of a node on a level: [count, id0, id1, ...]
+    uint32_t *links(uint32_t node, int level) {
+        if (level == 0)
+            return &index.links0[node * (1 + 2 * index.M)];
+        return &index.upper[node][(level - 1) * (1 + index.M)];
+    }
+
+    size_t capacity(int level) const {
+        return level == 0 ? 2 * index.M : index.M;
+    }
+};
+
+/*
+    greedy_closest
+
+    Walk one level greedily toward the query, starting from `ep`.
+
+    Arguments:
+        Graph &g - graph.
+        const float *q - query.
+        RowMatch ep - start node and its distance.
+        int level - level to walk.
+
+    Returns:
+        closest node found on the level.
+*/
+static RowMatch greedy_closest(Graph &g, const float *q, RowMatch ep,
+                               int level) {
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        const uint32_t *l = g.links((uint32_t)ep.row, level);
+        for (uint32_t i = 1; i <= l[0]; i++) {
+            const RowMatch c{l[i], g.distance(q, l[i])};
+            if (closer(c, ep)) {
+                ep = c;
+                moved = true;
+            }
+        }
+    }
+    return ep;
+}
+
+/*
+    search_level
+
+    Best-first search of one level (Algorithm 2 of the paper).
+
+    Arguments:
+        Graph &g - graph.
+        const float *q - query.
+        const std::vector<RowMatch> &entry - entry nodes with distances.
+        size_t ef - candidate list size.
+        int level - level to search.
+        VisitedSet &visited - scratch visited marks.
+
+    Returns:
+        up to ef nodes, closest first.
+*/
+static std::vector<RowMatch> search_level(Graph &g, const float *q,
+                                          const std::vector<RowMatch> &entry,
+                                          size_t ef, int level,
+                                          VisitedSet &visited) {
+    visited.reset(g.index.rows);
+    NearHeap candidates;
+    FarHeap found;
+    for (const RowMatch &e : entry) {
+        visited.insert((uint32_t)e.row);
+        candidates.push(e);
+        found.push(e);
+    }
+    while (found.size() > ef)
+        found.pop();
+
+    while (!candidates.empty()) {
+        const RowMatch c = candidates.top();
+        if (found.size() >= ef && closer(found.top(), c))
+            break;
+        candidates.pop();
+
+        const uint32_t *l = g.links((uint32_t)c.row, level);
+        for (uint32_t i = 1; i <= l[0]; i++) {
+            const uint32_t n = l[i];
+            if (!visited.insert(n))
+                continue;
+            const RowMatch m{n, g.distance(q, n)};
+            if (found.size() < ef || closer(m, found.top())) {
+                candidates.push(m);
+                found.push(m);
+                if (found.size() > ef)
+                    found.pop();
+            }
+        }
+    }
+
+    std::vector<RowMatch> out(found.size());
+    for (size_t i = out.size(); i-- > 0;) {
+        out[i] = found.top();
+        found.pop();
+    }
+    return out;
+}
+
+/*
+    select_neighbors
+
+    Neighbor selection heuristic (Algorithm 4 of the paper): take
+    candidates closest first, keeping one only if it is closer to the
+    base node than to every neighbor already kept. This keeps links
+    spread in different directions instead of clustered.
+
+    Arguments:
+        Graph &g - graph.
+        const std::vector<RowMatch> &cands - candidates, closest first,
+            with distances to the base node.
+        size_t m - maximum neighbors to keep.
+
+    Returns:
+        selected neighbors, closest first.
+*/
+static std::vector<RowMatch>
+select_neighbors(Graph &g, const std::vector<RowMatch> &cands, size_t m) {
+    std::vector<RowMatch> kept;
+    for (const RowMatch &c : cands) {
+        if (kept.size() >= m)
+            break;
+        const float *cvec = feature_db_row(g.db, c.row);
+        bool diverse = true;
+        for (const RowMatch &k : kept) {
+            if (g.distance(cvec, k.row) < c.dist) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse)
+            kept.push_back(c);
+    }
+    return kept;
+}
+
+/*
+    add_link
+
+    Add `node` to the neighbor list of `owner` on a level, re-running the
+    selection heuristic when the list is full.
+
+    Arguments:
+        Graph &g - graph.
+        uint32_t owner - node whose list grows.
+        uint32_t node - new neighbor.
+        float d - distance between the two.
+        int level - level of the link.
+
+    Returns:
+        void.
+*/
+static void add_link(Graph &g, uint32_t owner, uint32_t node, float d,
+                     int level) {
+    uint32_t *l = g.links(owner, level);
+    const size_t cap = g.capacity(level);
+    if (l[0] < cap) {
+        l[++l[0]] = node;
+        return;
+    }
+
+    const float *ov = feature_db_row(g.db, owner);
+    std::vector<RowMatch> cands;
+    cands.reserve(cap + 1);
+    cands.push_back({node, d});
+    for (uint32_t i = 1; i <= l[0]; i++)
+        cands.push_back({l[i], g.distance(ov, l[i])});
+    std::sort(cands.begin(), cands.end(), closer);
+
+    const std::vector<RowMatch> kept = select_neighbors(g, cands, cap);
+    l[0] = (uint32_t)kept.size();
+    for (size_t i = 0; i < kept.size(); i++)
+        l[1 + i] = (uint32_t)kept[i].row;
+}
+
+/*
+    hnsw_build
+
+    Build an HNSW graph by inserting rows in order (Algorithm 1 of the
+    paper). Levels are drawn from a seeded generator, so the same database
+    and parameters always produce the same graph.
+
+    Arguments:
+        const FeatureDBView &db - database to index.
+        BatchDistFunc dist - task distance (called with n = 1).
+        const HnswParams &params - build settings.
+        HnswIndex &index - output index.
+
+    Returns:
+        true on success, false if the database is empty or too large.
+*/
+bool hnsw_build(const FeatureDBView &db, BatchDistFunc dist,
+                const HnswParams &params, HnswIndex &index) {
+    if (db.rows == 0 || db.rows > UINT32_MAX || !dist || params.M < 2)
+        return false;
+
+    index = HnswIndex();
+    index.task_id = db.task_id;
+    index.dim = db.dim;
+    index.rows = db.rows;
+    index.M = params.M;
+    index.ef_construction = std::max(params.ef_construction, params.M);
+    index.levels.assign(db.rows, 0);
+    index.links0.assign(db.rows * (1 + 2 * index.M), 0);
+    index.upper.resize(db.rows);
+
+    Graph g{index, db, dist};
+    VisitedSet visited;
+    std::mt19937_64 rng(params.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double level_mult = 1.0 / std::log((double)index.M);
+
+    for (uint32_t q = 0; q < db.rows; q++) {
+        const double u = std::max(unit(rng), 1e-12);
+        const int level =
+            std::min((int)(-std::log(u) * level_mult), HNSW_MAX_LEVEL);
+        index.levels[q] = (uint8_t)level;
+        index.upper[q].assign((size_t)level * (1 + index.M), 0);
+
+        if (index.max_level < 0) {
+            index.entry = q;
+            index.max_level = level;
+            continue;
+        }
+
+        const float *qv = feature_db_row(db, q);
+        RowMatch ep{index.entry, g.distance(qv, index.entry)};
+        for (int l = index.max_level; l > level; l--)
+            ep = greedy_closest(g, qv, ep, l);
+
+        std::vector<RowMatch> entry{ep};
+        for (int l = std::min(level, index.max_level); l >= 0; l--) {
+            std::vector<RowMatch> cands =
+                search_level(g, qv, entry, index.ef_construction, l, visited);
+            const std::vector<RowMatch> neighbors =
+                select_neighbors(g, cands, index.M);
+
+            uint32_t *ql = g.links(q, l);
+            ql[0] = (uint32_t)neighbors.size();
+            for (size_t i = 0; i < neighbors.size(); i++) {
+                ql[1 + i] = (uint32_t)neighbors[i].row;
+                add_link(g, (uint32_t)neighbors[i].row, q, neighbors[i].dist,
+                         l);
+            }
+            entry = std::move(cands);
+        }
+
+        if (level > index.max_level) {
+            index.max_level = level;
+            index.entry = q;
+        }
+    }
+    return true;
+}
+
+/*
+    hnsw_search
+
+    Approximate k nearest rows: greedy descent through the upper levels,
+    then a best-first search with max(ef, k + 1) candidates on level 0.
+
+    Arguments:
+        const HnswIndex &index - index built over `db`.
+        const FeatureDBView &db - database the index was built from.
+        BatchDistFunc dist - task distance (same as at build time).
+        const float *query - query feature (db.dim values).
+        size_t k - number of matches to return.
+        size_t ef - search candidate list size (efSearch).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        number of distance evaluations performed.
+*/
+size_t hnsw_search(const HnswIndex &index, const FeatureDBView &db,
+                   BatchDistFunc dist, const float *query, size_t k,
+                   size_t ef, size_t skip_row,
+                   std::vector<RowMatch> &matches) {
+    matches.clear();
+    if (index.max_level < 0 || index.rows != db.rows || k == 0)
+        return 0;
+
+    // search only reads the graph; links() needs a mutable reference
+    Graph g{const_cast<HnswIndex &>(index), db, dist};
+    static thread_local VisitedSet visited;
+
+    RowMatch ep{index.entry, g.distance(query, index.entry)};
+    for (int l = index.max_level; l > 0; l--)
+        ep = greedy_closest(g, query, ep, l);
+
+    const std::vector<RowMatch> found =
+        search_level(g, query, {ep}, std::max(ef, k + 1), 0, visited);
+    for (const RowMatch &m : found) {
+        if (m.row == skip_row)
+            continue;
+        matches.push_back(m);
+        if (matches.size() == k)
+            break;
+    }
+    return g.evals;
+}
+
+/*
+    write_hnsw_index
+
+    Write an index to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const HnswIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_hnsw_index(const std::string &path, const HnswIndex &index) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    HnswHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, HNSW_MAGIC, sizeof(HNSW_MAGIC));
+    hdr.version = HNSW_VERSION;
+    hdr.task_id = index.task_id;
+    hdr.dim = (uint32_t)index.dim;
+    hdr.M = (uint32_t)index.M;
+    hdr.rows = index.rows;
+    hdr.ef_construction = (uint32_t)index.ef_construction;
+    hdr.max_level = index.max_level;
+    hdr.entry = index.entry;
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(index.levels.data()),
+              index.levels.size());
+    out.write(reinterpret_cast<const char *>(index.links0.data()),
+              index.links0.size() * sizeof(uint32_t));
+    for (const std::vector<uint32_t> &u : index.upper)
+        out.write(reinterpret_cast<const char *>(u.data()),
+                  u.size() * sizeof(uint32_t));
+    return out.good();
+}
+
+/*
+    read_hnsw_index
+
+    Read an index from disk. Rows, M and every node's upper levels are
+    checked against the file size before their lists are allocated.
+
+    Arguments:
+        const std::string &path - input file path.
+        HnswIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_hnsw_index(const std::string &path, HnswIndex &index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    HnswHeader hdr;
+    if (!in.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+        return false;
+    if (std::memcmp(hdr.magic, HNSW_MAGIC, sizeof(HNSW_MAGIC)) != 0 ||
+        hdr.version != HNSW_VERSION || hdr.M < 2 || hdr.rows > UINT32_MAX ||
+        (hdr.rows > 0 && hdr.entry >= hdr.rows))
+        return false;
+
+    // every node stores a level byte and a 1 + 2M layer-0 list: bound M
+    // and rows by the file size (dividing, so nothing can overflow)
+    // before anything is allocated
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    in.seekg(sizeof(HnswHeader));
+    uint64_t left = file_size - sizeof(HnswHeader);
+    if (hdr.rows > 0) {
+        if (left / sizeof(uint32_t) < 1 + 2 * (uint64_t)hdr.M)
+            return false;
+        const uint64_t node = 1 + (1 + 2 * (uint64_t)hdr.M) * sizeof(uint32_t);
+        if (hdr.rows > left / node)
+            return false;
+        left -= hdr.rows * node;
+    }
+
+    index = HnswIndex();
+    index.task_id = hdr.task_id;
+    index.dim = hdr.dim;
+    index.rows = hdr.rows;
+    index.M = hdr.M;
+    index.ef_construction = hdr.ef_construction;
+    index.max_level = hdr.max_level;
+    index.entry = hdr.entry;
+
+    index.levels.resize(index.rows);
+    in.read(reinterpret_cast<char *>(index.levels.data()), index.rows);
+    index.links0.resize(index.rows * (1 + 2 * index.M));
+    in.read(reinterpret_cast<char *>(index.links0.data()),
+            index.links0.size() * sizeof(uint32_t));
+    if (!in)
+        return false;
+
+    index.upper.resize(index.rows);
+    for (size_t i = 0; i < index.rows; i++) {
+        if (index.levels[i] > HNSW_MAX_LEVEL)
+            return false;
+        // upper lists must fit in what the file has left
+        const uint64_t bytes =
+            (uint64_t)index.levels[i] * (1 + index.M) * sizeof(uint32_t);
+        if (bytes > left)
+            return false;
+        left -= bytes;
+        index.upper[i].resize((size_t)index.levels[i] * (1 + index.M));
+        in.read(reinterpret_cast<char *>(index.upper[i].data()),
+                index.upper[i].size() * sizeof(uint32_t));
+    }
+    if (!in)
+        return false;
+
+    // reject link lists that point outside the graph or its levels
+    if (index.rows > 0 && index.levels[index.entry] != index.max_level)
+        return false;
+    for (size_t i = 0; i < index.rows; i++) {
+        const uint32_t *l = &index.links0[i * (1 + 2 * index.M)];
+        if (l[0] > 2 * index.M)
+            return false;
+        for (uint32_t j = 1; j <= l[0]; j++)
+            if (l[j] >= index.rows)
+                return false;
+        for (uint8_t lv = 1; lv <= index.levels[i]; lv++) {
+            const uint32_t *u = &index.upper[i][(lv - 1) * (1 + index.M)];
+            if (u[0] > index.M)
+                return false;
+            for (uint32_t j = 1; j <= u[0]; j++)
+                if (u[j] >= index.rows || index.levels[u[j]] < lv)
+                    return false;
+        }
+    }
+    return in.peek() == EOF;
+}
@@ -0,0 +1,308 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - ivf.cpp
+
+    This file implements the inverted-file index: centroid training, row
+    assignment, probed search, and persistence.
+*/
+
+#include "../include/ivf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+#include "../include/kmeans.h"
+#include "../include/topk.h"
+
+// training rows per cell when IvfParams::train_rows is 0
+#define IVF_TRAIN_PER_LIST 64
+// rows scored per batch distance call while scanning a cell
+#define IVF_BLOCK 256
+
+/*
+    assign_rows
+
+    Find the closest centroid (by the task's distance) of rows
+    [begin, end).
+
+    Arguments:
+        const FeatureDBView &db - database being indexed.
+        const TaskSpec &spec - task whose batch distance is used.
+        const IvfIndex &index - index with trained centroids.
+        size_t begin - first row.
+        size_t end - one past the last row.
+        std::vector<uint32_t> &cell - output, cell of each row.
+
+    Returns:
+        void.
+*/
+static void assign_rows(const FeatureDBView &db, const TaskSpec &spec,
+                        const IvfIndex &index, size_t begin, size_t end,
+                        std::vector<uint32_t> &cell) {
+    std::vector<float> d(index.nlist);
+    for (size_t r = begin; r < end; r++) {
+        // the distances are symmetric, so the row can play the query
+        spec.batch_dist(feature_db_row(db, r), index.centroids.data(),
+                        index.nlist, db.dim, d.data());
+        cell[r] = (uint32_t)(std::min_element(d.begin(), d.end()) -
+                             d.begin());
+    }
+}
+
+/*
+    ivf_build
+
+    Train centroids with k-means on an even sample of rows, then file
+    every row under its closest centroid by the task's distance.
+
+    Arguments:
+        const FeatureDBView &db - database to index.
+        const TaskSpec &spec - task whose batch distance assigns rows.
+        const IvfParams &params - build settings.
+        IvfIndex &index - output index.
+
+    Returns:
+        true on success, false if the database is empty or too large for
+        32-bit row ids.
+*/
+bool ivf_build(const FeatureDBView &db, const TaskSpec &spec,
+               const IvfParams &params, IvfIndex &index) {
+    if (db.rows == 0 || db.rows > UINT32_MAX || !spec.batch_dist)
+        return false;
+
+    index = IvfIndex();
+    index.task_id = db.task_id;
+    index.dim = db.dim;
+    index.rows = db.rows;
+    index.nlist = params.nlist > 0
+                      ? params.nlist
+                      : (size_t)std::max(1.0, std::sqrt((double)db.rows));
+    index.nlist = std::min(index.nlist, db.rows);
+
+    // evenly spaced training sample
+    size_t n = params.train_rows > 0 ? params.train_rows
+                                     : index.nlist * IVF_TRAIN_PER_LIST;
+    n = std::min(db.rows, std::max(n, index.nlist));
+    std::vector<float> train(n * db.dim);
+    for (size_t i = 0; i < n; i++) {
+        const float *row = feature_db_row(db, i * db.rows / n);
+        std::copy(row, row + db.dim, &train[i * db.dim]);
+    }
+
+    KMeansParams kp;
+    kp.k = index.nlist;
+    kp.iters = params.iters;
+    kp.seed = params.seed;
+    if (!kmeans_train(train.data(), n, db.dim, db.dim, kp, index.centroids))
+        return false;
+
+    // assign every row, split across threads
+    std::vector<uint32_t> cell(db.rows);
+    const size_t threads =
+        params.threads > 0 ? (size_t)params.threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+    if (threads <= 1) {
+        assign_rows(db, spec, index, 0, db.rows, cell);
+    } else {
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; t++)
+            pool.emplace_back(assign_rows, std::cref(db), std::cref(spec),
+                              std::cref(index), db.rows * t / threads,
+                              db.rows * (t + 1) / threads, std::ref(cell));
+        for (std::thread &th : pool)
+            th.join();
+    }
+
+    // counting sort into posting lists, rows ascending within a cell
+    index.offsets.assign(index.nlist + 1, 0);
+    for (uint32_t c : cell)
+        index.offsets[c + 1]++;
+    std::partial_sum(index.offsets.begin(), index.offsets.end(),
+                     index.offsets.begin());
+    index.ids.resize(db.rows);
+    std::vector<uint64_t> fill(index.offsets.begin(), index.offsets.end() - 1);
+    for (size_t r = 0; r < db.rows; r++)
+        index.ids[fill[cell[r]]++] = (uint32_t)r;
+    return true;
+}
+
+/*
+    ivf_search
+
+    Score the centroids, then rank the rows of the nprobe closest cells.
+    Consecutive row ids within a cell are scored with one batch call,
+    bounded by the worst kept distance once k rows are kept.
+
+    Arguments:
+        const IvfIndex &index - index over `db`.
+        const FeatureDBView &db - database the index was built from.
+        const TaskSpec &spec - task whose batch distance ranks rows.
+        const std::vector<float> &query - query feature (db.dim values).
+        size_t k - number of matches to return.
+        size_t nprobe - cells to scan (clamped to nlist).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        number of rows scanned.
+*/
+size_t ivf_search(const IvfIndex &index, const FeatureDBView &db,
+                  const TaskSpec &spec, const std::vector<float> &query,
+                  size_t k, size_t nprobe, size_t skip_row,
+                  std::vector<RowMatch> &matches) {
+    matches.clear();
+    if (index.nlist == 0)
+        return 0;
+    nprobe = std::max<size_t>(1, std::min(nprobe, index.nlist));
+
+    // closest cells first
+    std::vector<float> cd(index.nlist);
+    spec.batch_dist(query.data(), index.centroids.data(), index.nlist,
+                    db.dim, cd.data());
+    std::vector<uint32_t> order(index.nlist);
+    std::iota(order.begin(), order.end(), 0);
+    std::partial_sort(order.begin(), order.begin() + nprobe, order.end(),
+                      [&](uint32_t a, uint32_t b) {
+                          return cd[a] < cd[b] || (cd[a] == cd[b] && a < b);
+                      });
+
+    TopK top(k);
+    float d[IVF_BLOCK];
+    size_t scanned = 0;
+    for (size_t p = 0; p < nprobe; p++) {
+        const uint32_t *ids = &index.ids[index.offsets[order[p]]];
+        const size_t len =
+            index.offsets[order[p] + 1] - index.offsets[order[p]];
+        for (size_t i = 0; i < len;) {
+            // run of consecutive rows, at most one block long
+            size_t run = 1;
+            while (i + run < len && run < IVF_BLOCK &&
+                   ids[i + run] == ids[i] + run)
+                run++;
+            if (spec.bounded_batch_dist && top.full())
+                spec.bounded_batch_dist(query.data(),
+                                        feature_db_row(db, ids[i]), run,
+                                        db.dim, top.worst(), d);
+            else
+                spec.batch_dist(query.data(), feature_db_row(db, ids[i]), run,
+                                db.dim, d);
+            for (size_t j = 0; j < run; j++)
+                if (ids[i] + j != skip_row)
+                    top.push(ids[i] + j, d[j]);
+            scanned += run;
+            i += run;
+        }
+    }
+    top.sorted(matches);
+    return scanned;
+}
+
+/*
+    write_ivf_index
+
+    Write an IVF index to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const IvfIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_ivf_index(const std::string &path, const IvfIndex &index) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    IvfHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, IVF_MAGIC, sizeof(IVF_MAGIC));
+    hdr.version = IVF_VERSION;
+    hdr.task_id = index.task_id;
+    hdr.dim = (uint32_t)index.dim;
+    hdr.nlist = (uint32_t)index.nlist;
+    hdr.rows = index.rows;
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(index.centroids.data()),
+              index.centroids.size() * sizeof(float));
+    out.write(reinterpret_cast<const char *>(index.offsets.data()),
+              index.offsets.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char *>(index.ids.data()),
+              index.ids.size() * sizeof(uint32_t));
+    return out.good();
+}
+
+/*
+    read_ivf_index
+
+    Read an IVF index from disk, checking the file size against the
+    header and that the posting lists cover each row exactly once.
+
+    Arguments:
+        const std::string &path - input file path.
+        IvfIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, size, or
+        posting lists).
+*/
+bool read_ivf_index(const std::string &path, IvfIndex &index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    IvfHeader hdr;
+    if (!in.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+        return false;
+    if (std::memcmp(hdr.magic, IVF_MAGIC, sizeof(IVF_MAGIC)) != 0 ||
+        hdr.version != IVF_VERSION || hdr.rows > UINT32_MAX)
+        return false;
+
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    const uint64_t expect = sizeof(IvfHeader) +
+                            (uint64_t)hdr.nlist * hdr.dim * sizeof(float) +
+                            ((uint64_t)hdr.nlist + 1) * sizeof(uint64_t) +
+                            hdr.rows * sizeof(uint32_t);
+    if (file_size != expect)
+        return false;
+    in.seekg(sizeof(IvfHeader));
+
+    index = IvfIndex();
+    index.task_id = hdr.task_id;
+    index.dim = hdr.dim;
+    index.nlist = hdr.nlist;
+    index.rows = hdr.rows;
+    index.centroids.resize(index.nlist * index.dim);
+    in.read(reinterpret_cast<char *>(index.centroids.data()),
+            index.centroids.size() * sizeof(float));
+    index.offsets.resize(index.nlist + 1);
+    in.read(reinterpret_cast<char *>(index.offsets.data()),
+            index.offsets.size() * sizeof(uint64_t));
+    index.ids.resize(index.rows);
+    in.read(reinterpret_cast<char *>(index.ids.data()),
+            index.ids.size() * sizeof(uint32_t));
+    if (!in)
+        return false;
+
+    // offsets must be monotonic and span all rows; each row filed once
+    if (index.offsets[0] != 0 || index.offsets[index.nlist] != index.rows)
+        return false;
+    for (size_t c = 0; c < index.nlist; c++)
+        if (index.offsets[c] > index.offsets[c + 1])
+            return false;
+    std::vector<char> seen(index.rows, 0);
+    for (uint32_t id : index.ids) {
+        if (id >= index.rows || seen[id])
+            return false;
+        seen[id] = 1;
+    }
+    return true;
+}
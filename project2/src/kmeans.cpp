@@ -0,0 +1,154 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - kmeans.cpp
+
+    This file implements k-means (k-means++ seeding, Lloyd iterations).
+*/
+
+#include "../include/kmeans.h"
+
+#include <algorithm>
+#include <random>
+
+#include "../include/distance_kernels.h"
+
+// centroids scored per batch kernel call
+#define KMEANS_BLOCK 256
+
+/*
+    kmeans_nearest
+
+    Index of the centroid closest to a point (squared L2 distance).
+
+    Arguments:
+        const float *x - point (dim values).
+        const float *centroids - k x dim centroids, row-major.
+        size_t k - number of centroids.
+        size_t dim - values per point.
+
+    Returns:
+        index of the nearest centroid.
+*/
+size_t kmeans_nearest(const float *x, const float *centroids, size_t k,
+                      size_t dim) {
+    float d[KMEANS_BLOCK];
+    size_t best = 0;
+    float best_d = 0.0f;
+    for (size_t start = 0; start < k; start += KMEANS_BLOCK) {
+        const size_t m = std::min((size_t)KMEANS_BLOCK, k - start);
+        kernel_ssd_batch(x, centroids + start * dim, m, dim, dim, d);
+        for (size_t c = 0; c < m; c++) {
+            if ((start == 0 && c == 0) || d[c] < best_d) {
+                best_d = d[c];
+                best = start + c;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+    kmeans_train
+
+    Cluster n points into k centroids: k-means++ seeding followed by
+    Lloyd iterations. A cluster that ends up empty is re-seeded with the
+    point farthest from its centroid.
+
+    Arguments:
+        const float *data - first point.
+        size_t n - number of points (must be >= k).
+        size_t dim - values per point.
+        size_t stride - floats between consecutive points.
+        const KMeansParams &params - clustering settings.
+        std::vector<float> &centroids - output, k x dim row-major.
+
+    Returns:
+        true on success, false if there are fewer points than clusters.
+*/
+bool kmeans_train(const float *data, size_t n, size_t dim, size_t stride,
+                  const KMeansParams &params, std::vector<float> &centroids) {
+    const size_t k = params.k;
+    if (k == 0 || n < k || dim == 0)
+        return false;
+
+    const auto point = [&](size_t i) { return data + i * stride; };
+    centroids.assign(k * dim, 0.0f);
+    std::mt19937_64 rng(params.seed);
+
+    // k-means++: each new seed is drawn with probability ~ distance^2
+    std::vector<float> nearest_d(n);
+    const float *first = point(rng() % n);
+    std::copy(first, first + dim, centroids.begin());
+    for (size_t i = 0; i < n; i++)
+        nearest_d[i] = kernel_ssd(point(i), first, dim);
+    for (size_t c = 1; c < k; c++) {
+        double total = 0.0;
+        for (float d : nearest_d)
+            total += d;
+        double r = std::uniform_real_distribution<double>(0.0, total)(rng);
+        size_t pick = n - 1;
+        for (size_t i = 0; i < n; i++) {
+            r -= nearest_d[i];
+            if (r <= 0.0) {
+                pick = i;
+                break;
+            }
+        }
+        float *cen = &centroids[c * dim];
+        std::copy(point(pick), point(pick) + dim, cen);
+        for (size_t i = 0; i < n; i++)
+            nearest_d[i] =
+                std::min(nearest_d[i], kernel_ssd(point(i), cen, dim));
+    }
+
+    // Lloyd iterations
+    std::vector<size_t> assign(n, 0);
+    std::vector<double> sums(k * dim);
+    std::vector<size_t> counts(k);
+    for (size_t it = 0; it < params.iters; it++) {
+        bool changed = (it == 0);
+        for (size_t i = 0; i < n; i++) {
+            const size_t c = kmeans_nearest(point(i), centroids.data(), k, dim);
+            changed |= (c != assign[i]);
+            assign[i] = c;
+        }
+        if (!changed)
+            break;
+
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < n; i++) {
+            const float *x = point(i);
+            double *s = &sums[assign[i] * dim];
+            for (size_t j = 0; j < dim; j++)
+                s[j] += x[j];
+            counts[assign[i]]++;
+        }
+
+        for (size_t c = 0; c < k; c++) {
+            float *cen = &centroids[c * dim];
+            if (counts[c] > 0) {
+                for (size_t j = 0; j < dim; j++)
+                    cen[j] = (float)(sums[c * dim + j] / counts[c]);
+                continue;
+            }
+
+            // empty cluster: move it onto the worst-fitting point
+            size_t worst = 0;
+            float worst_d = -1.0f;
+            for (size_t i = 0; i < n; i++) {
+                const float d = kernel_ssd(
+                    point(i), &centroids[assign[i] * dim], dim);
+                if (d > worst_d) {
+                    worst_d = d;
+                    worst = i;
+                }
+            }
+            std::copy(point(worst), point(worst) + dim, cen);
+            assign[worst] = c;
+        }
+    }
+    return true;
+}
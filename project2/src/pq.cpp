@@ -0,0 +1,326 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - pq.cpp
+
+    This file implements product quantization of embeddings: codebook
+    training, encoding, lookup-table search with exact re-ranking, and
+    persistence.
+*/
+
+#include "../include/pq.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "../include/kmeans.h"
+#include "../include/topk.h"
+
+/*
+    normalize
+
+    Copy a vector scaled to unit L2 norm (all zeros stays all zeros).
+
+    Arguments:
+        const float *x - input (dim values).
+        size_t dim - number of values.
+        float *out - output (dim values).
+
+    Returns:
+        void.
+*/
+static void normalize(const float *x, size_t dim, float *out) {
+    double s = 0.0;
+    for (size_t i = 0; i < dim; i++)
+        s += (double)x[i] * x[i];
+    const double inv = s > 0.0 ? 1.0 / std::sqrt(s) : 0.0;
+    for (size_t i = 0; i < dim; i++)
+        out[i] = (float)(x[i] * inv);
+}
+
+/*
+    encode_row
+
+    Encode one normalized embedding as m centroid indices.
+
+    Arguments:
+        const PQIndex &index - trained codebooks.
+        const float *xn - normalized embedding (index.dim values).
+        uint8_t *code - output, index.m bytes.
+
+    Returns:
+        void.
+*/
+static void encode_row(const PQIndex &index, const float *xn, uint8_t *code) {
+    for (size_t j = 0; j < index.m; j++) {
+        const float *cb = &index.codebooks[j * PQ_KSUB * index.dsub];
+        code[j] = (uint8_t)kmeans_nearest(xn + j * index.dsub, cb, PQ_KSUB,
+                                          index.dsub);
+    }
+}
+
+/*
+    encode_rows
+
+    Encode rows [begin, end) of a database.
+
+    Arguments:
+        PQIndex &index - trained codebooks; codes are written in place.
+        const FeatureDBView &db - embeddings.
+        size_t begin - first row.
+        size_t end - one past the last row.
+
+    Returns:
+        void.
+*/
+static void encode_rows(PQIndex &index, const FeatureDBView &db, size_t begin,
+                        size_t end) {
+    std::vector<float> xn(db.dim);
+    for (size_t r = begin; r < end; r++) {
+        normalize(feature_db_row(db, r), db.dim, xn.data());
+        encode_row(index, xn.data(), &index.codes[r * index.m]);
+    }
+}
+
+/*
+    pq_train
+
+    Train one 256-centroid codebook per sub-vector on an even sample of
+    normalized rows, then encode every row.
+
+    Arguments:
+        const FeatureDBView &db - embeddings to encode.
+        const PQParams &params - training settings.
+        PQIndex &index - output index.
+
+    Returns:
+        true on success, false if m does not divide the dimension or
+        there are fewer than 256 rows to train on.
+*/
+bool pq_train(const FeatureDBView &db, const PQParams &params,
+              PQIndex &index) {
+    if (params.m == 0 || db.dim % params.m != 0 || db.rows < PQ_KSUB)
+        return false;
+
+    index = PQIndex();
+    index.task_id = db.task_id;
+    index.dim = db.dim;
+    index.m = params.m;
+    index.dsub = db.dim / params.m;
+    index.rows = db.rows;
+
+    // evenly spaced training sample, normalized
+    const size_t n =
+        std::min(db.rows, std::max(params.train_rows, (size_t)PQ_KSUB));
+    std::vector<float> train(n * db.dim);
+    for (size_t i = 0; i < n; i++)
+        normalize(feature_db_row(db, i * db.rows / n), db.dim,
+                  &train[i * db.dim]);
+
+    index.codebooks.resize(index.m * PQ_KSUB * index.dsub);
+    index.codes.resize(db.rows * index.m);
+    const size_t threads =
+        params.threads > 0 ? (size_t)params.threads
+                           : std::max(1u, std::thread::hardware_concurrency());
+
+    // sub-quantizers are independent: thread t trains j = t, t + T, ...
+    std::vector<char> ok(index.m, 0);
+    const auto train_some = [&](size_t t) {
+        std::vector<float> centroids;
+        for (size_t j = t; j < index.m; j += threads) {
+            KMeansParams kp;
+            kp.k = PQ_KSUB;
+            kp.iters = params.iters;
+            kp.seed = params.seed + j;
+            ok[j] = kmeans_train(&train[j * index.dsub], n, index.dsub,
+                                 db.dim, kp, centroids);
+            if (ok[j])
+                std::copy(centroids.begin(), centroids.end(),
+                          index.codebooks.begin() + j * PQ_KSUB * index.dsub);
+        }
+    };
+    const auto encode_some = [&](size_t t) {
+        encode_rows(index, db, db.rows * t / threads,
+                    db.rows * (t + 1) / threads);
+    };
+
+    if (threads <= 1) {
+        train_some(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; t++)
+            pool.emplace_back(train_some, t);
+        for (std::thread &th : pool)
+            th.join();
+    }
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+        return false;
+
+    if (threads <= 1) {
+        encode_some(0);
+    } else {
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; t++)
+            pool.emplace_back(encode_some, t);
+        for (std::thread &th : pool)
+            th.join();
+    }
+    return true;
+}
+
+/*
+    pq_search
+
+    Rank every row by asymmetric cosine distance (1 - sum of lookup-table
+    dot products), then re-rank the best `rerank` candidates exactly.
+
+    Arguments:
+        const PQIndex &index - codes of `db`.
+        const FeatureDBView &db - full embeddings (read only for re-rank).
+        BatchDistFunc dist - exact distance used for re-ranking.
+        const float *query - query embedding (index.dim values).
+        size_t k - number of matches to return.
+        size_t rerank - candidates to re-rank exactly (0 = none).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        void.
+*/
+void pq_search(const PQIndex &index, const FeatureDBView &db,
+               BatchDistFunc dist, const float *query, size_t k,
+               size_t rerank, size_t skip_row,
+               std::vector<RowMatch> &matches) {
+    matches.clear();
+
+    // lookup table: dot product of each query sub-vector with each centroid
+    std::vector<float> qn(index.dim);
+    normalize(query, index.dim, qn.data());
+    std::vector<float> lut(index.m * PQ_KSUB);
+    for (size_t j = 0; j < index.m; j++) {
+        const float *qs = &qn[j * index.dsub];
+        for (size_t c = 0; c < PQ_KSUB; c++) {
+            const float *cen = &index.codebooks[(j * PQ_KSUB + c) * index.dsub];
+            float s = 0.0f;
+            for (size_t i = 0; i < index.dsub; i++)
+                s += qs[i] * cen[i];
+            lut[j * PQ_KSUB + c] = s;
+        }
+    }
+
+    // first pass over the codes only
+    TopK approx(std::max(k, rerank));
+    for (size_t r = 0; r < index.rows; r++) {
+        if (r == skip_row)
+            continue;
+        const uint8_t *code = &index.codes[r * index.m];
+        float sim = 0.0f;
+        for (size_t j = 0; j < index.m; j++)
+            sim += lut[j * PQ_KSUB + code[j]];
+        approx.push(r, 1.0f - sim);
+    }
+    approx.sorted(matches);
+    if (rerank == 0 || !dist) {
+        if (matches.size() > k)
+            matches.resize(k);
+        return;
+    }
+
+    // second pass: exact distances for the candidates only
+    TopK exact(k);
+    for (const RowMatch &c : matches) {
+        float d;
+        dist(query, feature_db_row(db, c.row), 1, db.dim, &d);
+        exact.push(c.row, d);
+    }
+    exact.sorted(matches);
+}
+
+/*
+    write_pq_index
+
+    Write codebooks and codes to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const PQIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_pq_index(const std::string &path, const PQIndex &index) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    PQHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, PQ_MAGIC, sizeof(PQ_MAGIC));
+    hdr.version = PQ_VERSION;
+    hdr.task_id = index.task_id;
+    hdr.dim = (uint32_t)index.dim;
+    hdr.m = (uint32_t)index.m;
+    hdr.ksub = PQ_KSUB;
+    hdr.rows = index.rows;
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(index.codebooks.data()),
+              index.codebooks.size() * sizeof(float));
+    out.write(reinterpret_cast<const char *>(index.codes.data()),
+              index.codes.size());
+    return out.good();
+}
+
+/*
+    read_pq_index
+
+    Read codebooks and codes from disk, checking the header against the
+    file size.
+
+    Arguments:
+        const std::string &path - input file path.
+        PQIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, or size).
+*/
+bool read_pq_index(const std::string &path, PQIndex &index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    PQHeader hdr;
+    if (!in.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+        return false;
+    if (std::memcmp(hdr.magic, PQ_MAGIC, sizeof(PQ_MAGIC)) != 0 ||
+        hdr.version != PQ_VERSION || hdr.ksub != PQ_KSUB || hdr.m == 0 ||
+        hdr.dim % hdr.m != 0)
+        return false;
+
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    const uint64_t fixed =
+        sizeof(PQHeader) + (uint64_t)hdr.dim * PQ_KSUB * sizeof(float);
+    // divide before multiplying so crafted row counts cannot wrap around
+    if (file_size < fixed || hdr.rows > (file_size - fixed) / hdr.m ||
+        file_size != fixed + hdr.rows * hdr.m)
+        return false;
+    in.seekg(sizeof(PQHeader));
+
+    index = PQIndex();
+    index.task_id = hdr.task_id;
+    index.dim = hdr.dim;
+    index.m = hdr.m;
+    index.dsub = hdr.dim / hdr.m;
+    index.rows = hdr.rows;
+    index.codebooks.resize(index.m * PQ_KSUB * index.dsub);
+    in.read(reinterpret_cast<char *>(index.codebooks.data()),
+            index.codebooks.size() * sizeof(float));
+    index.codes.resize(index.rows * index.m);
+    in.read(reinterpret_cast<char *>(index.codes.data()), index.codes.size());
+    return (bool)in;
+}
@@ -0,0 +1,610 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - qhist.cpp
+
+    This file implements quantized histogram storage: per-segment scales,
+    encoding, integer-kernel search with exact re-ranking, the error check
+    against float distances, and persistence.
+*/
+
+#include "../include/qhist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "../include/distance_kernels.h"
+#include "../include/topk.h"
+
+// rows scored per kernel call
+#define QHIST_BLOCK 1024
+
+/*
+    QueryCodes
+
+    A query quantized with an index's scales, in the index's code width.
+*/
+struct QueryCodes {
+    std::vector<uint8_t> c8;
+    std::vector<uint16_t> c16;
+};
+
+/*
+    qhist_layout
+
+    Histogram segments of a task's feature, with the weights the task's
+    distance gives them (see task_registry.cpp and ranking.cpp).
+
+    Arguments:
+        int task_id - task of the rows.
+        size_t dim - feature dimension.
+        std::vector<QHistSegment> &segments - output segments, scale 1.
+
+    Returns:
+        true if the task is a histogram task with a matching dimension.
+*/
+static bool qhist_layout(int task_id, size_t dim,
+                         std::vector<QHistSegment> &segments) {
+    segments.clear();
+    if (task_id == 2 && dim > 0) {
+        segments.push_back({0, dim, 1.0, 1.0f});
+    } else if (task_id == 3 && dim > 0 && dim % 2 == 0) {
+        // whole image | center region, weighted 0.5 / 0.5
+        segments.push_back({0, dim / 2, 0.5, 1.0f});
+        segments.push_back({dim / 2, dim / 2, 0.5, 1.0f});
+    } else if (task_id == 4 && dim == 256 + 16 + 18) {
+        // rg color 16 x 16 | gradient magnitude 16 | orientation 18
+        segments.push_back({0, 256, 0.5, 1.0f});
+        segments.push_back({256, 16, 0.25, 1.0f});
+        segments.push_back({272, 18, 0.25, 1.0f});
+    }
+    return !segments.empty();
+}
+
+/*
+    name_offsets_are_valid
+
+    Check that a name offset table starts at 0, never decreases and ends
+    at the size of the name block, so every name lies inside it.
+
+    Arguments:
+        const std::vector<uint64_t> &offsets - rows + 1 offsets.
+        uint64_t names_bytes - size of the name block.
+
+    Returns:
+        true if every name range is in bounds.
+*/
+static bool name_offsets_are_valid(const std::vector<uint64_t> &offsets,
+                                   uint64_t names_bytes) {
+    if (offsets.front() != 0 || offsets.back() != names_bytes)
+        return false;
+    for (size_t i = 0; i + 1 < offsets.size(); i++)
+        if (offsets[i] > offsets[i + 1])
+            return false;
+    return true;
+}
+
+/*
+    top_code
+
+    Largest code of a width: 255 for 8 bits, 32767 for 16 (15-bit codes).
+
+    Arguments:
+        int bits - code width.
+
+    Returns:
+        largest code value.
+*/
+static double top_code(int bits) { return bits == 8 ? 255.0 : 32767.0; }
+
+/*
+    encode
+
+    Quantize one histogram with the index's scales, clamping to the code
+    range.
+
+    Arguments:
+        const QHistIndex &index - segment layout and scales.
+        const float *x - histogram (index.dim values).
+        T *code - output, index.dim codes.
+
+    Returns:
+        void.
+*/
+template <typename T>
+static void encode(const QHistIndex &index, const float *x, T *code) {
+    const double top = top_code(index.bits);
+    for (const QHistSegment &s : index.segments) {
+        const double inv = 1.0 / s.scale;
+        for (size_t i = s.offset; i < s.offset + s.len; i++)
+            code[i] = (T)std::clamp(std::round(x[i] * inv), 0.0, top);
+    }
+}
+
+/*
+    quantize_query
+
+    Quantize a query with the index's scales.
+
+    Arguments:
+        const QHistIndex &index - segment layout and scales.
+        const float *query - query histogram (index.dim values).
+        QueryCodes &q - output codes.
+
+    Returns:
+        void.
+*/
+static void quantize_query(const QHistIndex &index, const float *query,
+                           QueryCodes &q) {
+    if (index.bits == 8) {
+        q.c8.resize(index.dim);
+        encode(index, query, q.c8.data());
+    } else {
+        q.c16.resize(index.dim);
+        encode(index, query, q.c16.data());
+    }
+}
+
+/*
+    min_sum_batch
+
+    Integer intersection kernel for either code width.
+*/
+static void min_sum_batch(const uint8_t *q, const uint8_t *rows, size_t n,
+                          size_t stride, size_t len, uint32_t *out) {
+    kernel_min_sum_u8_batch(q, rows, n, stride, len, out);
+}
+
+static void min_sum_batch(const uint16_t *q, const uint16_t *rows, size_t n,
+                          size_t stride, size_t len, uint32_t *out) {
+    kernel_min_sum_u16_batch(q, rows, n, stride, len, out);
+}
+
+/*
+    block_distances
+
+    Quantized distances from a query to rows [begin, begin + n): each
+    segment's integer intersection is scaled back and weighted as in the
+    task's float distance.
+
+    Arguments:
+        const QHistIndex &index - segment layout and scales.
+        const T *q - query codes.
+        const T *codes - code matrix of the index.
+        size_t begin - first row.
+        size_t n - number of rows (at most QHIST_BLOCK).
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+template <typename T>
+static void block_distances(const QHistIndex &index, const T *q,
+                            const T *codes, size_t begin, size_t n,
+                            float *out) {
+    uint32_t sums[QHIST_BLOCK];
+    double acc[QHIST_BLOCK] = {0.0};
+    const T *rows = codes + begin * index.dim;
+    for (const QHistSegment &s : index.segments) {
+        min_sum_batch(q + s.offset, rows + s.offset, n, index.dim, s.len,
+                      sums);
+        for (size_t r = 0; r < n; r++)
+            acc[r] += s.weight * (1.0 - (double)s.scale * sums[r]);
+    }
+    for (size_t r = 0; r < n; r++)
+        out[r] = (float)acc[r];
+}
+
+/*
+    code_distances
+
+    block_distances for the index's code width.
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+        const QueryCodes &q - query codes.
+        size_t begin - first row.
+        size_t n - number of rows (at most QHIST_BLOCK).
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+static void code_distances(const QHistIndex &index, const QueryCodes &q,
+                           size_t begin, size_t n, float *out) {
+    if (index.bits == 8)
+        block_distances(index, q.c8.data(), index.codes8.data(), begin, n,
+                        out);
+    else
+        block_distances(index, q.c16.data(), index.codes16.data(), begin, n,
+                        out);
+}
+
+/*
+    qhist_build
+
+    Set each segment's scale from its largest value in the database, then
+    encode every row.
+
+    Arguments:
+        const FeatureDBView &db - histograms to encode.
+        int task_id - task of the rows (sets the segment layout).
+        int bits - code width, 8 or 16.
+        QHistIndex &index - output index.
+
+    Returns:
+        true on success, false for an unsupported task, dimension or
+        width, or a negative bin value.
+*/
+bool qhist_build(const FeatureDBView &db, int task_id, int bits,
+                 QHistIndex &index) {
+    index = QHistIndex();
+    if ((bits != 8 && bits != 16) ||
+        !qhist_layout(task_id, db.dim, index.segments))
+        return false;
+    index.task_id = task_id;
+    index.dim = db.dim;
+    index.bits = bits;
+    index.rows = db.rows;
+    index.decode_scale = db.decode_scale;
+
+    // names travel with the codes, so the file stands on its own
+    const uint64_t names_bytes = db.name_offsets[db.rows];
+    index.name_offsets.assign(db.name_offsets, db.name_offsets + db.rows + 1);
+    index.name_chars.assign(db.name_chars, names_bytes);
+
+    // largest value of each segment sets its scale
+    std::vector<float> top(index.segments.size(), 0.0f);
+    for (size_t r = 0; r < db.rows; r++) {
+        const float *x = feature_db_row(db, r);
+        for (size_t s = 0; s < index.segments.size(); s++) {
+            const QHistSegment &seg = index.segments[s];
+            for (size_t i = seg.offset; i < seg.offset + seg.len; i++) {
+                if (!(x[i] >= 0.0f))
+                    return false; // not a histogram (or NaN)
+                top[s] = std::max(top[s], x[i]);
+            }
+        }
+    }
+    for (size_t s = 0; s < index.segments.size(); s++)
+        index.segments[s].scale =
+            top[s] > 0.0f ? (float)(top[s] / top_code(bits)) : 1.0f;
+
+    if (bits == 8) {
+        index.codes8.resize(db.rows * db.dim);
+        for (size_t r = 0; r < db.rows; r++)
+            encode(index, feature_db_row(db, r), &index.codes8[r * db.dim]);
+    } else {
+        index.codes16.resize(db.rows * db.dim);
+        for (size_t r = 0; r < db.rows; r++)
+            encode(index, feature_db_row(db, r), &index.codes16[r * db.dim]);
+    }
+    return true;
+}
+
+/*
+    qhist_error_bound
+
+    Largest possible difference between a quantized and a float distance:
+    every stored or query bin is within scale / 2 of its value, so each
+    minimum is too.
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+
+    Returns:
+        sum over segments of weight * bins * scale / 2.
+*/
+double qhist_error_bound(const QHistIndex &index) {
+    double bound = 0.0;
+    for (const QHistSegment &s : index.segments)
+        bound += s.weight * (double)s.len * s.scale * 0.5;
+    return bound;
+}
+
+/*
+    qhist_check
+
+    Rank every row against query rows sampled evenly from the database,
+    once by quantized and once by float distance, and compare.
+
+    Arguments:
+        const QHistIndex &index - codes of `db`.
+        const FeatureDBView &db - float histograms.
+        BatchDistFunc dist - the task's float distance.
+        size_t queries - query rows to sample.
+        size_t k - ranking depth for the recall.
+        QHistCheck &check - output statistics.
+
+    Returns:
+        true if every error is within the bound (plus float rounding).
+*/
+bool qhist_check(const QHistIndex &index, const FeatureDBView &db,
+                 BatchDistFunc dist, size_t queries, size_t k,
+                 QHistCheck &check) {
+    check = QHistCheck();
+    check.bound = qhist_error_bound(index);
+    if (!dist || db.rows != index.rows || db.dim != index.dim ||
+        index.rows < 2)
+        return false;
+
+    const size_t nq = std::min(queries, index.rows);
+    std::vector<float> approx(QHIST_BLOCK);
+    std::vector<float> exact(QHIST_BLOCK);
+    std::vector<RowMatch> top_q;
+    std::vector<RowMatch> top_f;
+    double err_sum = 0.0;
+    size_t hits = 0;
+    size_t kept = 0;
+    QueryCodes q;
+    for (size_t j = 0; j < nq; j++) {
+        const size_t qrow = j * index.rows / nq;
+        const float *query = feature_db_row(db, qrow);
+        quantize_query(index, query, q);
+
+        TopK rank_q(k);
+        TopK rank_f(k);
+        for (size_t begin = 0; begin < index.rows; begin += QHIST_BLOCK) {
+            const size_t n = std::min<size_t>(QHIST_BLOCK, index.rows - begin);
+            code_distances(index, q, begin, n, approx.data());
+            dist(query, feature_db_row(db, begin), n, db.dim, exact.data());
+            for (size_t r = 0; r < n; r++) {
+                if (begin + r == qrow)
+                    continue;
+                const double err = std::fabs((double)approx[r] - exact[r]);
+                check.max_error = std::max(check.max_error, err);
+                err_sum += err;
+                check.pairs++;
+                rank_q.push(begin + r, approx[r]);
+                rank_f.push(begin + r, exact[r]);
+            }
+        }
+        rank_q.sorted(top_q);
+        rank_f.sorted(top_f);
+        for (const RowMatch &f : top_f)
+            for (const RowMatch &m : top_q)
+                hits += (m.row == f.row);
+        kept += top_f.size();
+    }
+
+    check.queries = nq;
+    check.mean_error = check.pairs ? err_sum / check.pairs : 0.0;
+    check.recall = kept ? (double)hits / kept : 1.0;
+    // float distances carry their own rounding on top of the bound
+    return check.max_error <= check.bound + 1e-5;
+}
+
+/*
+    qhist_search
+
+    Rank every row by quantized distance (integer intersections per
+    segment), then re-rank the best `rerank` candidates exactly.
+
+    Arguments:
+        const QHistIndex &index - codes of `db`.
+        const FeatureDBView &db - float histograms (read only for re-rank).
+        BatchDistFunc dist - exact distance used for re-ranking.
+        const float *query - query histogram (index.dim values).
+        size_t k - number of matches to return.
+        size_t rerank - candidates to re-rank exactly (0 = none).
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        void.
+*/
+void qhist_search(const QHistIndex &index, const FeatureDBView &db,
+                  BatchDistFunc dist, const float *query, size_t k,
+                  size_t rerank, size_t skip_row,
+                  std::vector<RowMatch> &matches) {
+    matches.clear();
+    QueryCodes q;
+    quantize_query(index, query, q);
+
+    // first pass over the codes only
+    TopK approx(std::max(k, rerank));
+    std::vector<float> d(QHIST_BLOCK);
+    for (size_t begin = 0; begin < index.rows; begin += QHIST_BLOCK) {
+        const size_t n = std::min<size_t>(QHIST_BLOCK, index.rows - begin);
+        code_distances(index, q, begin, n, d.data());
+        for (size_t r = 0; r < n; r++)
+            if (begin + r != skip_row)
+                approx.push(begin + r, d[r]);
+    }
+    approx.sorted(matches);
+    if (rerank == 0 || !dist || !db.data) {
+        if (matches.size() > k)
+            matches.resize(k);
+        return;
+    }
+
+    // second pass: exact distances for the candidates only
+    TopK exact(k);
+    for (const RowMatch &c : matches) {
+        float e;
+        dist(query, feature_db_row(db, c.row), 1, db.dim, &e);
+        exact.push(c.row, e);
+    }
+    exact.sorted(matches);
+}
+
+/*
+    qhist_name
+
+    Return the filename of row i (view into the packed name storage).
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+        size_t i - row index.
+
+    Returns:
+        filename view, valid while the index is unchanged.
+*/
+std::string_view qhist_name(const QHistIndex &index, size_t i) {
+    const uint64_t begin = index.name_offsets[i];
+    return std::string_view(index.name_chars.data() + begin,
+                            index.name_offsets[i + 1] - begin);
+}
+
+/*
+    qhist_find
+
+    Find the row index of a filename (linear scan).
+
+    Arguments:
+        const QHistIndex &index - quantized histograms.
+        std::string_view name - filename to look up.
+        size_t &row - output row index.
+
+    Returns:
+        true if found, false otherwise.
+*/
+bool qhist_find(const QHistIndex &index, std::string_view name,
+                size_t &row) {
+    for (size_t i = 0; i < index.rows; i++) {
+        if (qhist_name(index, i) == name) {
+            row = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    is_qhist_file
+
+    Check whether a file starts with the quantized histogram magic.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true if the file is a quantized histogram file.
+*/
+bool is_qhist_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8] = {0};
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return std::memcmp(magic, QHIST_MAGIC, sizeof(QHIST_MAGIC)) == 0;
+}
+
+/*
+    write_qhist_index
+
+    Write segment scales, row names and codes to disk.
+
+    Arguments:
+        const std::string &path - output file path.
+        const QHistIndex &index - index to write.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_qhist_index(const std::string &path, const QHistIndex &index) {
+    if (index.segments.size() > QHIST_MAX_SEGMENTS)
+        return false;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    QHistHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, QHIST_MAGIC, sizeof(QHIST_MAGIC));
+    hdr.version = QHIST_VERSION;
+    hdr.task_id = index.task_id;
+    hdr.dim = (uint32_t)index.dim;
+    hdr.bits = (uint32_t)index.bits;
+    hdr.segments = (uint32_t)index.segments.size();
+    hdr.decode_scale = (uint32_t)std::max(1, index.decode_scale);
+    hdr.rows = index.rows;
+    hdr.names_bytes = index.name_chars.size();
+    for (size_t s = 0; s < index.segments.size(); s++)
+        hdr.scales[s] = index.segments[s].scale;
+
+    out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char *>(index.name_offsets.data()),
+              (index.rows + 1) * sizeof(uint64_t));
+    out.write(index.name_chars.data(), index.name_chars.size());
+    if (index.bits == 8)
+        out.write(reinterpret_cast<const char *>(index.codes8.data()),
+                  index.codes8.size());
+    else
+        out.write(reinterpret_cast<const char *>(index.codes16.data()),
+                  index.codes16.size() * sizeof(uint16_t));
+    return out.good();
+}
+
+/*
+    read_qhist_index
+
+    Read segment scales, row names and codes from disk, checking the
+    header against the task's layout, the file size and the name table.
+
+    Arguments:
+        const std::string &path - input file path.
+        QHistIndex &index - output index.
+
+    Returns:
+        true on success, false on failure (bad magic, version, task,
+        layout, or size).
+*/
+bool read_qhist_index(const std::string &path, QHistIndex &index) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        return false;
+
+    QHistHeader hdr;
+    if (!in.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+        return false;
+    std::vector<QHistSegment> segments;
+    if (std::memcmp(hdr.magic, QHIST_MAGIC, sizeof(QHIST_MAGIC)) != 0 ||
+        hdr.version != QHIST_VERSION || (hdr.bits != 8 && hdr.bits != 16) ||
+        !qhist_layout(hdr.task_id, hdr.dim, segments) ||
+        segments.size() != hdr.segments)
+        return false;
+
+    // every row costs at least its name offset and codes, so a row count
+    // beyond the file size is rejected before any product can overflow
+    in.seekg(0, std::ios::end);
+    const uint64_t file_size = (uint64_t)in.tellg();
+    const uint64_t row_bytes = sizeof(uint64_t) + hdr.dim * (hdr.bits / 8);
+    if (hdr.rows > file_size / row_bytes || hdr.names_bytes > file_size)
+        return false;
+    const uint64_t expect = sizeof(QHistHeader) + sizeof(uint64_t) +
+                            hdr.rows * row_bytes + hdr.names_bytes;
+    if (file_size != expect)
+        return false;
+    in.seekg(sizeof(QHistHeader));
+
+    index = QHistIndex();
+    index.task_id = hdr.task_id;
+    index.dim = hdr.dim;
+    index.bits = (int)hdr.bits;
+    index.rows = hdr.rows;
+    index.decode_scale = hdr.decode_scale > 1 ? (int)hdr.decode_scale : 1;
+    index.segments = segments;
+    for (size_t s = 0; s < segments.size(); s++)
+        index.segments[s].scale = hdr.scales[s];
+
+    index.name_offsets.resize(index.rows + 1);
+    in.read(reinterpret_cast<char *>(index.name_offsets.data()),
+            (index.rows + 1) * sizeof(uint64_t));
+    index.name_chars.resize(hdr.names_bytes);
+    in.read(index.name_chars.data(), hdr.names_bytes);
+    if (!in || !name_offsets_are_valid(index.name_offsets, hdr.names_bytes))
+        return false;
+    if (index.bits == 8) {
+        index.codes8.resize(index.rows * index.dim);
+        in.read(reinterpret_cast<char *>(index.codes8.data()),
+                index.codes8.size());
+    } else {
+        index.codes16.resize(index.rows * index.dim);
+        in.read(reinterpret_cast<char *>(index.codes16.data()),
+                index.codes16.size() * sizeof(uint16_t));
+    }
+    return (bool)in;
+}
@@ -5,21 +5,30 @@
     CS5330 Project 2 - query_db.cpp
 
     This file implements the query program for Tasks 1–4, loading features
-    from a CSV, computing the target feature, and ranking top matches.
+    from a binary database or CSV, computing the target feature, and
+    ranking top matches. With --ivf only the cells of an inverted-file
+    index closest to the target are ranked; with --qhist the rows are
+    ranked from 8/16-bit quantized histograms.
 */
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include <opencv2/opencv.hpp>
 
-#include "../include/csv_io.h"
+#include "../include/build_pipeline.h"
+#include "../include/feature_db.h"
 #include "../include/features.h"
+#include "../include/ivf.h"
+#include "../include/qhist.h"
 #include "../include/ranking.h"
+#include "../include/search.h"
+#include "../include/shard.h"
 #include "../include/task_registry.h"
 #include "../include/utils.h"
 
@@ -27,7 +36,22 @@
     main
 
     Run a query against a feature database and print the top matches.
-    Usage: ./query_db <target_image> <image_dir> <feature_csv> <topN> [task_id]
+    Usage: ./query_db <target_image> <image_dir> <feature_db> <topN> [task_id]
+                      [--threads N] [--ivf <index> [--nprobe N]]
+                      [--qhist <index> [--rerank N]]
+    The task id defaults to the one stored in a binary database, else 1.
+    A target inside image_dir is matched to its row by its relative path,
+    so it is left out of its own results in --recursive builds too.
+    feature_db may be a shard manifest (build_db --shards): the shards are
+    ranked in parallel and their top matches merged.
+    --threads splits the scan across N threads (0 = all); the default is 1,
+    or one per shard (up to the hardware threads) for a sharded database.
+    --ivf scans only the --nprobe (default 8) closest cells of the index.
+    --qhist ranks quantized histograms and re-ranks the best --rerank
+    (default 100, 0 = none) rows with exact distances. Without re-ranking
+    the float database is not read; feature_db may also be the quantized
+    histogram file itself (build_index qhist), which is then all a query
+    needs.
 
     Arguments:
         int argc - argument count.
@@ -37,19 +61,108 @@
         0 on success, negative value on error.
 */
 int main(int argc, char **argv) {
-    if (argc < 5) {
+    RankOptions opt;
+    bool threads_given = false;
+    std::string ivf_path;
+    size_t nprobe = 8;
+    std::string qhist_path;
+    size_t rerank = 100;
+    bool rerank_given = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            opt.threads = std::atoi(argv[++i]);
+            threads_given = true;
+        } else if (arg == "--ivf" && i + 1 < argc)
+            ivf_path = argv[++i];
+        else if (arg == "--nprobe" && i + 1 < argc)
+            nprobe = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--qhist" && i + 1 < argc)
+            qhist_path = argv[++i];
+        else if (arg == "--rerank" && i + 1 < argc) {
+            rerank = std::max(0, std::atoi(argv[++i]));
+            rerank_given = true;
+        } else
+            args.push_back(arg);
+    }
+
+    if (args.size() < 4) {
         std::cerr << "usage: " << argv[0]
-                  << " <target_image> <image_dir> <feature_csv> <topN>\n";
+                  << " <target_image> <image_dir> <feature_db> <topN> "
+                     "[task_id] [--threads N] [--ivf <index> [--nprobe N]] "
+                     "[--qhist <index> [--rerank N]]\n";
+        return -1;
+    }
+
+    const std::string target_path = args[0];
+    const std::string image_dir = args[1];
+    const std::string db_path = args[2];
+    const int topN = std::max(1, std::atoi(args[3].c_str()));
+    opt.top_k = topN;
+
+    // a quantized histogram file given as the database is ranked on its
+    // own; it has no float rows to re-rank from
+    if (is_qhist_file(db_path)) {
+        if (!qhist_path.empty() || !ivf_path.empty() || rerank_given) {
+            std::cerr << db_path << " holds quantized histograms; pass the "
+                         "float database for --qhist, --ivf or --rerank\n";
+            return -1;
+        }
+        qhist_path = db_path;
+        rerank = 0;
+    }
+
+    // quantized histograms are read first: without re-ranking they stand
+    // in for the float database, which is then not opened at all
+    QHistIndex qindex;
+    if (!qhist_path.empty() && !read_qhist_index(qhist_path, qindex)) {
+        std::cerr << "Cannot read quantized histograms: " << qhist_path
+                  << "\n";
+        return -1;
+    }
+    const bool qhist_only = !qhist_path.empty() && rerank == 0;
+
+    // map the feature database (binary in place, CSV parsed), or every
+    // shard of a sharded one
+    ShardedDB sharded;
+    FeatureDBView db;
+    if (qhist_only) {
+        sharded.task_id = qindex.task_id;
+        sharded.dim = qindex.dim;
+        sharded.rows = qindex.rows;
+        sharded.decode_scale = qindex.decode_scale;
+    } else {
+        if (!open_sharded_db(db_path, sharded)) {
+            std::cerr << "Cannot load feature database: " << db_path << "\n";
+            return -1;
+        }
+        if (sharded.shards.size() > 1 &&
+            (!ivf_path.empty() || !qhist_path.empty())) {
+            std::cerr << "--ivf and --qhist need an unsharded database\n";
+            return -1;
+        }
+        // index searches run on the only shard
+        db = sharded.shards[0]->view;
+    }
+    if (sharded.rows == 0) {
+        std::cerr << "Feature database is empty: " << db_path << "\n";
         return -1;
     }
+    if (!threads_given && !qhist_only)
+        opt.threads = default_shard_threads(sharded);
 
-    const std::string target_path = argv[1];
-    const std::string image_dir = argv[2];
-    const std::string csv_path = argv[3];
-    const int topN = std::max(1, std::atoi(argv[4]));
+    // optional task id (default = database task, else 1)
+    const int task_id = (args.size() > 4)       ? std::atoi(args[4].c_str())
+                        : (sharded.task_id > 0) ? sharded.task_id
+                                                : 1;
+    if (sharded.task_id > 0 && sharded.task_id != task_id) {
+        std::cerr << "Database " << db_path << " holds task "
+                  << sharded.task_id << " features, not task " << task_id
+                  << "\n";
+        return -1;
+    }
 
-    // optional task id (default = 1)
-    const int task_id = (argc > 5) ? std::atoi(argv[5]) : 1;
     TaskSpec spec;
     try {
         spec = get_task(task_id);
@@ -58,11 +171,15 @@ int main(int argc, char **argv) {
                   << ")\n";
         return -1;
     }
+    if (!spec.feature) {
+        std::cerr << "Task " << task_id
+                  << " has no image feature; use its own query tool\n";
+        return -1;
+    }
 
-    const std::string target_name = basename_only(target_path);
 
-    // compute target feature
-    cv::Mat target_img = cv::imread(target_path, cv::IMREAD_UNCHANGED);
+    // compute target feature, decoded the way the database was built
+    cv::Mat target_img = decode_image(target_path, sharded.decode_scale);
     std::vector<float> target_feat;
     if (!spec.feature(target_img, target_feat)) {
         std::cerr << "Failed to compute target feature for: " << target_path
@@ -70,50 +187,80 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    // read db csv and compute distances
-    std::ifstream in(csv_path);
-    if (!in.is_open()) {
-        std::cerr << "Cannot open csv: " << csv_path << "\n";
+    // sanity: feature dimension should match (e.g. 147 for task 1)
+    if (sharded.dim != target_feat.size()) {
+        std::cerr << "Feature dimension mismatch: database has "
+                  << sharded.dim
+                  << ", target has " << target_feat.size() << "\n";
         return -1;
     }
 
-    std::vector<Match> matches;
-    std::string line;
+    // rank every database row, leaving the target itself out; rows of a
+    // --recursive build are named by their path under image_dir, so match
+    // that (a target outside image_dir falls back to its filename)
+    const std::string target_name = image_row_name(target_path, image_dir);
+    size_t target_row = NO_ROW;
+    if (qhist_only)
+        qhist_find(qindex, target_name, target_row);
+    else
+        sharded_db_find(sharded, target_name, target_row);
 
-    while (std::getline(in, line)) {
-        if (line.empty())
-            continue;
+    std::vector<RowMatch> matches;
+    if (ivf_path.empty() && qhist_path.empty()) {
+        // one scan per shard, merged
+        rank_sharded(sharded, target_feat, spec, target_row, opt, matches);
+    } else if (!qhist_path.empty()) {
+        if (qindex.rows != sharded.rows || qindex.dim != sharded.dim ||
+            qindex.task_id != task_id) {
+            std::cerr << "Quantized histograms " << qhist_path
+                      << " were built for task " << qindex.task_id << ", "
+                      << qindex.rows << " x " << qindex.dim
+                      << "; rebuild them\n";
+            return -1;
+        }
 
-        std::string fname;
-        std::vector<float> feat;
-        if (!parse_csv_row(line, fname, feat))
-            continue;
-
-        // skip the target image itself if it's in the database
-        if (fname == target_name)
-            continue;
-
-        // sanity: feature dimension should match (147)
-        if (feat.size() != target_feat.size())
-            continue;
-
-        float d = spec.dist(target_feat, feat);
-        matches.push_back({fname, d});
+        // every row but the target is a candidate
+        const size_t candidates =
+            qindex.rows - (target_row != NO_ROW ? 1 : 0);
+        const auto t0 = std::chrono::steady_clock::now();
+        qhist_search(qindex, db, spec.batch_dist, target_feat.data(), topN,
+                     rerank, target_row, matches);
+        const double q_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - t0)
+                                .count();
+        std::printf("QHIST: %d-bit codes (%zu bytes/row), %zu rows "
+                    "re-ranked, %.3f ms\n",
+                    qindex.bits, qindex.dim * (qindex.bits / 8),
+                    std::min(rerank, candidates), q_ms);
+    } else {
+        IvfIndex index;
+        if (!read_ivf_index(ivf_path, index)) {
+            std::cerr << "Cannot read IVF index: " << ivf_path << "\n";
+            return -1;
+        }
+        if (index.rows != db.rows || index.dim != db.dim ||
+            index.task_id != task_id) {
+            std::cerr << "IVF index " << ivf_path << " was built for task "
+                      << index.task_id << ", " << index.rows << " x "
+                      << index.dim << "; rebuild it\n";
+            return -1;
+        }
+        const size_t scanned = ivf_search(index, db, spec, target_feat, topN,
+                                          nprobe, target_row, matches);
+        std::cout << "IVF: nprobe=" << std::min(nprobe, index.nlist) << "/"
+                  << index.nlist << ", " << scanned << " of " << db.rows
+                  << " rows scanned\n";
     }
 
-    in.close();
-
-    // sort ascending by distance (smaller = more similar)
-    sort_matches(matches);
-
     std::cout << "Top " << topN << " matches for target: " << target_path
               << "\n";
     for (int i = 0; i < topN && i < (int)matches.size(); i++) {
         // print filename + distance; you can also print full path if you want
-        std::cout << (i + 1) << ") " << matches[i].filename
-                  << "  dist=" << matches[i].dist
-                  << "  fullpath=" << (image_dir + "/" + matches[i].filename)
-                  << "\n";
+        const std::string_view fname =
+            qhist_only ? qhist_name(qindex, matches[i].row)
+                       : sharded_db_name(sharded, matches[i].row);
+        std::cout << (i + 1) << ") " << fname << "  dist=" << matches[i].dist
+                  << "  fullpath=" << image_dir << "/" << fname << "\n";
     }
 
     return 0;
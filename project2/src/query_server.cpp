@@ -0,0 +1,488 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - query_server.cpp
+
+    This file implements a long-running query server. It maps one or more
+    feature databases once at startup and then answers top-N requests over
+    stdin/stdout or a Unix domain socket, so each query pays only for the
+    distance scan instead of reloading the database.
+
+    Protocol (one request per line, whitespace separated):
+        query <task_id> <target> <topN> [bottom]
+        tasks
+        quit
+    Responses:
+        ok <n> <elapsed_ms>     followed by n lines "<rank> <filename> <dist>"
+        err <message>
+    <target> is a row name already in the task's database (its stored
+    feature is used) or a path to an image (feature computed on the fly).
+    Composite tasks (Task 7) rank with the databases of all their
+    component tasks, which must be loaded too. A database may be a shard
+    manifest (build_db --shards); its shards are ranked in parallel and
+    their top-N merged.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "../include/build_pipeline.h"
+#include "../include/feature_db.h"
+#include "../include/ranking.h"
+#include "../include/search.h"
+#include "../include/shard.h"
+#include "../include/task_registry.h"
+#include "../include/utils.h"
+
+/*
+    LoadedDB
+
+    A database served for one task: the mapping (one or more shards), the
+    task's functions, and a filename -> global row index for constant-time
+    target lookup. Composite tasks also hold their component databases,
+    matched once at startup; those must be unsharded.
+*/
+struct LoadedDB {
+    std::string path;
+    TaskSpec spec;
+    std::unique_ptr<ShardedDB> sharded;
+    std::unordered_map<std::string_view, size_t> rows_by_name;
+    CompositeDB composite; // empty unless every component is loaded
+};
+
+// task id -> database; filled once at startup, read-only afterwards
+static std::map<int, LoadedDB> g_dbs;
+
+// threads each query's scan is split across (--threads); without it, one
+// per shard of the queried database (default_shard_threads)
+static int g_rank_threads = 1;
+static bool g_threads_given = false;
+
+// composite tasks: rows the first component passes on (--cascade, 0 = all)
+static size_t g_cascade = 0;
+
+// directory the databases were built from (--image-dir), "" if not given
+static std::string g_image_dir;
+
+/*
+    load_database
+
+    Map a database given as "<task_id>=<path>" or "<path>" (binary files
+    carry their own task id) and register it under its task. A second
+    database for a task that is already loaded is refused.
+
+    Arguments:
+        const std::string &arg - command-line database argument.
+
+    Returns:
+        true on success, false on failure.
+*/
+static bool load_database(const std::string &arg) {
+    int task_id = 0;
+    std::string path = arg;
+    const size_t eq = arg.find('=');
+    if (eq != std::string::npos) {
+        task_id = std::atoi(arg.substr(0, eq).c_str());
+        path = arg.substr(eq + 1);
+    }
+
+    LoadedDB entry;
+    entry.path = path;
+    entry.sharded = std::make_unique<ShardedDB>();
+    if (!open_sharded_db(path, *entry.sharded)) {
+        std::cerr << "Cannot load feature database: " << path << "\n";
+        return false;
+    }
+
+    const ShardedDB &db = *entry.sharded;
+    if (task_id == 0)
+        task_id = db.task_id;
+    if (task_id <= 0) {
+        std::cerr << path << " has no task id; pass it as <task_id>=<path>\n";
+        return false;
+    }
+    if (db.task_id > 0 && db.task_id != task_id) {
+        std::cerr << path << " holds task " << db.task_id
+                  << " features, not task " << task_id << "\n";
+        return false;
+    }
+    const auto loaded = g_dbs.find(task_id);
+    if (loaded != g_dbs.end()) {
+        std::cerr << "Task " << task_id << " is already served from "
+                  << loaded->second.path << "; cannot also load " << path
+                  << "\n";
+        return false;
+    }
+
+    try {
+        entry.spec = get_task(task_id);
+    } catch (const std::exception &e) {
+        std::cerr << "Invalid task id: " << task_id << " (" << e.what()
+                  << ")\n";
+        return false;
+    }
+
+    entry.rows_by_name.reserve(db.rows);
+    for (size_t i = 0; i < db.rows; i++)
+        entry.rows_by_name.emplace(sharded_db_name(db, i), i);
+
+    std::fprintf(stderr, "task %d: %zu rows x %zu dims in %zu shard(s) "
+                 "from %s\n",
+                 task_id, db.rows, db.dim, db.shards.size(), path.c_str());
+    g_dbs[task_id] = std::move(entry);
+    return true;
+}
+
+/*
+    link_composites
+
+    Match the component databases of every loaded composite task. A
+    composite task whose components are not all loaded stays unlinked
+    and its queries are refused.
+
+    Returns:
+        void.
+*/
+static void link_composites() {
+    for (auto &[task_id, entry] : g_dbs) {
+        if (entry.spec.components.empty())
+            continue;
+        std::vector<const FeatureDBView *> dbs;
+        for (const TaskComponent &comp : entry.spec.components) {
+            const auto it = g_dbs.find(comp.task_id);
+            if (it == g_dbs.end() || it->second.sharded->shards.size() != 1)
+                break;
+            dbs.push_back(&it->second.sharded->shards[0]->view);
+        }
+        if (dbs.size() != entry.spec.components.size() ||
+            !composite_db_build(entry.spec, dbs, entry.composite))
+            std::fprintf(stderr,
+                         "task %d: component databases missing, sharded "
+                         "or mismatched; its queries will be refused\n",
+                         task_id);
+    }
+}
+
+/*
+    component_query
+
+    Resolve a target's feature for one task: its stored row if the
+    target is in the task's database, else the task's feature of the
+    image. The target matches a row by its exact name (e.g. "sub/x.jpg"
+    from a --recursive build), by its path relative to --image-dir, or
+    by its filename.
+
+    Arguments:
+        int task_id - task (loaded) whose feature is wanted.
+        const std::string &target - filename or image path.
+        std::vector<float> &query - output feature.
+        size_t &row - output row of the target, or NO_ROW if computed.
+
+    Returns:
+        true on success, false if the feature cannot be resolved.
+*/
+static bool component_query(int task_id, const std::string &target,
+                            std::vector<float> &query, size_t &row) {
+    const LoadedDB &entry = g_dbs.at(task_id);
+    const ShardedDB &db = *entry.sharded;
+    row = NO_ROW;
+    auto row_it = entry.rows_by_name.find(target);
+    if (row_it == entry.rows_by_name.end())
+        row_it = entry.rows_by_name.find(image_row_name(target, g_image_dir));
+    if (row_it != entry.rows_by_name.end()) {
+        row = row_it->second;
+        const float *f = sharded_db_row(db, row);
+        query.assign(f, f + db.dim);
+        return true;
+    }
+    if (!entry.spec.feature)
+        return false;
+    cv::Mat img = decode_image(target, db.decode_scale);
+    return entry.spec.feature(img, query);
+}
+
+/*
+    answer_query
+
+    Resolve the target, rank the task's database, and write the response.
+
+    Arguments:
+        std::istringstream &args - remaining request tokens.
+        FILE *out - response stream.
+
+    Returns:
+        void.
+*/
+static void answer_query(std::istringstream &args, FILE *out) {
+    int task_id = 0;
+    std::string target;
+    int topN = 0;
+    std::string order;
+    if (!(args >> task_id >> target >> topN)) {
+        std::fprintf(out, "err usage: query <task_id> <target> <topN> "
+                          "[bottom]\n");
+        return;
+    }
+    args >> order;
+    const bool bottom = (order == "bottom");
+    topN = std::max(1, topN);
+
+    const auto it = g_dbs.find(task_id);
+    if (it == g_dbs.end()) {
+        std::fprintf(out, "err no database loaded for task %d\n", task_id);
+        return;
+    }
+    const LoadedDB &entry = it->second;
+    const ShardedDB &db = *entry.sharded;
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    RankOptions opt;
+    opt.top_k = topN;
+    opt.bottom = bottom;
+    opt.threads =
+        g_threads_given ? g_rank_threads : default_shard_threads(db);
+    opt.cascade = g_cascade;
+    std::vector<RowMatch> matches;
+
+    if (!entry.spec.components.empty()) {
+        if (entry.composite.dbs.empty()) {
+            std::fprintf(out, "err task %d needs the databases of all its "
+                              "component tasks\n", task_id);
+            return;
+        }
+        // one query per component; the base row is the one to skip
+        const std::vector<TaskComponent> &comps = entry.spec.components;
+        std::vector<std::vector<float>> queries(comps.size());
+        size_t skip_row = NO_ROW;
+        for (size_t c = 0; c < comps.size(); c++) {
+            size_t row;
+            if (!component_query(comps[c].task_id, target, queries[c],
+                                 row)) {
+                std::fprintf(out, "err no task %d feature for %s\n",
+                             comps[c].task_id, target.c_str());
+                return;
+            }
+            if (c == 0)
+                skip_row = row;
+        }
+        std::vector<StageCount> stages;
+        if (!rank_composite(entry.composite, queries, entry.spec, skip_row,
+                            opt, matches, stages)) {
+            std::fprintf(out, "err feature dimension does not match\n");
+            return;
+        }
+    } else {
+        // stored feature if the target is in the database, else compute it
+        std::vector<float> query;
+        size_t skip_row = NO_ROW;
+        if (!component_query(task_id, target, query, skip_row)) {
+            if (entry.spec.feature)
+                std::fprintf(out, "err cannot compute feature for %s\n",
+                             target.c_str());
+            else
+                std::fprintf(out, "err %s not in task %d database\n",
+                             target.c_str(), task_id);
+            return;
+        }
+        if (!rank_sharded(db, query, entry.spec, skip_row, opt, matches)) {
+            std::fprintf(out, "err feature dimension %zu != database %zu\n",
+                         query.size(), db.dim);
+            return;
+        }
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+
+    std::fprintf(out, "ok %zu %.3f\n", matches.size(), ms);
+    for (size_t k = 0; k < matches.size(); k++) {
+        const RowMatch &m = matches[k];
+        const std::string_view fname = sharded_db_name(db, m.row);
+        std::fprintf(out, "%zu %.*s %g\n", k + 1, (int)fname.size(),
+                     fname.data(), m.dist);
+    }
+}
+
+/*
+    serve_stream
+
+    Read requests line by line from `in` and answer on `out` until EOF or
+    a "quit" request.
+
+    Arguments:
+        FILE *in - request stream.
+        FILE *out - response stream.
+
+    Returns:
+        void.
+*/
+static void serve_stream(FILE *in, FILE *out) {
+    char *buf = nullptr;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&buf, &cap, in)) > 0) {
+        std::istringstream args(std::string(buf, (size_t)len));
+        std::string cmd;
+        if (!(args >> cmd))
+            continue;
+
+        if (cmd == "quit")
+            break;
+        if (cmd == "query") {
+            answer_query(args, out);
+        } else if (cmd == "tasks") {
+            std::fprintf(out, "ok %zu 0\n", g_dbs.size());
+            for (const auto &[task_id, entry] : g_dbs)
+                std::fprintf(out, "%d %zu %zu %s\n", task_id,
+                             entry.sharded->rows, entry.sharded->dim,
+                             entry.path.c_str());
+        } else {
+            std::fprintf(out, "err unknown command: %s\n", cmd.c_str());
+        }
+        std::fflush(out);
+    }
+    std::free(buf);
+}
+
+/*
+    serve_socket
+
+    Listen on a Unix domain socket and serve each client on its own thread.
+
+    Arguments:
+        const std::string &path - socket path (replaced if it exists).
+
+    Returns:
+        0 on clean shutdown, negative value on error.
+*/
+static int serve_socket(const std::string &path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::perror("socket");
+        return -1;
+    }
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << "\n";
+        close(fd);
+        return -1;
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0) {
+        std::perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    std::fprintf(stderr, "listening on %s\n", path.c_str());
+
+    while (true) {
+        const int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            std::perror("accept");
+            break;
+        }
+
+        // databases are read-only after startup, so clients run in parallel
+        std::thread([client]() {
+            FILE *in = fdopen(client, "r");
+            FILE *out = fdopen(dup(client), "w");
+            if (in && out)
+                serve_stream(in, out);
+            if (out)
+                std::fclose(out);
+            if (in)
+                std::fclose(in);
+        }).detach();
+    }
+
+    close(fd);
+    unlink(path.c_str());
+    return -1;
+}
+
+/*
+    main
+
+    Load the databases and serve queries.
+    Usage: ./query_server [--socket <path>] [--threads N] [--cascade N]
+                          [--image-dir <dir>] <[task_id=]db> [...]
+    --image-dir names the directory the databases were built from, so a
+    target path inside it finds its row even in a --recursive build.
+
+    Arguments:
+        int argc - argument count.
+        char **argv - argument values.
+
+    Returns:
+        0 on success, negative value on error.
+*/
+int main(int argc, char **argv) {
+    std::string socket_path;
+    std::vector<std::string> db_args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) {
+            g_rank_threads = std::atoi(argv[++i]);
+            g_threads_given = true;
+        } else if (arg == "--cascade" && i + 1 < argc)
+            g_cascade = (size_t)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--image-dir" && i + 1 < argc)
+            g_image_dir = argv[++i];
+        else
+            db_args.push_back(arg);
+    }
+
+    if (db_args.empty()) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--socket <path>] [--threads N] [--cascade N]"
+                     " [--image-dir <dir>] <[task_id=]db> [...]\n";
+        return -1;
+    }
+
+    for (const std::string &arg : db_args) {
+        if (!load_database(arg))
+            return -1;
+    }
+    link_composites();
+
+    // a client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!socket_path.empty())
+        return serve_socket(socket_path);
+
+    serve_stream(stdin, stdout);
+    return 0;
+}
@@ -5,105 +5,358 @@
     CS5330 Project 2 - query_task5.cpp
 
     This file implements the Task 5 query program using deep embedding
-    features and cosine distance ranking.
+    features and cosine distance ranking. With --hnsw the ranking comes
+    from an approximate HNSW index, and with --pq from product-quantized
+    codes, instead of an exhaustive scan; --recall compares either against
+    the exhaustive result. --batch ranks a whole list of targets at once
+    and writes every top-N list to a results file. A sharded database
+    (build_db --shards manifest) is scanned shard by shard in parallel.
 */
 
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
-#include "../include/csv_io.h"
+#include "../include/feature_db.h"
+#include "../include/hnsw.h"
+#include "../include/pq.h"
 #include "../include/ranking.h"
+#include "../include/search.h"
+#include "../include/shard.h"
+#include "../include/task_registry.h"
+
+// values per embedding (ResNet18 penultimate layer)
+#define EMBEDDING_DIM 512
 
 /*
-    main
+    check_embedding_db
 
-    Query the embedding CSV by filename and print top cosine matches.
-    Usage: ./query_task5 <target_filename> <embedding_csv> <topN>
+    Check that a database holds Task 5 embeddings: its task id, when
+    recorded, must be 5 and its rows EMBEDDING_DIM values long.
 
     Arguments:
-        int argc - argument count.
-        char **argv - argument values.
+        const std::string &path - database path, for the message.
+        int task_id - task id stored in the database (0 = unknown).
+        size_t dim - values per row.
 
     Returns:
-        0 on success, negative value on error.
+        true if the database can be queried, false (after a message) if not.
 */
-int main(int argc, char **argv) {
-    if (argc < 4) {
-        std::cerr << "usage: " << argv[0]
-                  << " <target_filename> <embedding_csv> <topN>\n";
-        return -1;
+static bool check_embedding_db(const std::string &path, int task_id,
+                               size_t dim) {
+    if (task_id > 0 && task_id != 5) {
+        std::cerr << "Database " << path << " holds task " << task_id
+                  << " features, not task 5\n";
+        return false;
+    }
+    if (dim != EMBEDDING_DIM) {
+        std::cerr << "Database " << path << " holds " << dim
+                  << "-value rows, not " << EMBEDDING_DIM
+                  << "-value embeddings\n";
+        return false;
     }
+    return true;
+}
 
-    const std::string target_name = argv[1]; // e.g., pic.0535.jpg
-    const std::string csv_path = argv[2];
-    const int topN = std::max(1, std::atoi(argv[3]));
+/*
+    run_batch
+
+    Rank every target listed in a file (one filename per line) against
+    the embedding database and write "target,rank,match,dist" rows. The
+    database is normalized in memory first (from the rows already read)
+    if it was not stored that way, so all targets are ranked with one
+    tiled matrix product.
 
-    std::ifstream in(csv_path);
-    if (!in.is_open()) {
-        std::cerr << "Cannot open csv: " << csv_path << "\n";
+    Arguments:
+        const std::string &list_path - file of target filenames.
+        const std::string &db_path - embedding database (binary or CSV).
+        const RankOptions &opt - top-N and thread settings.
+        const std::string &out_path - results file, "-" for stdout.
+
+    Returns:
+        0 on success, negative value on error.
+*/
+static int run_batch(const std::string &list_path, const std::string &db_path,
+                     const RankOptions &opt, const std::string &out_path) {
+    if (is_shard_manifest(db_path)) {
+        std::cerr << "--batch needs an unsharded database\n";
+        return -1;
+    }
+    MappedFeatureDB mapped;
+    if (!map_feature_db(db_path, mapped)) {
+        std::cerr << "Cannot load embedding database: " << db_path << "\n";
         return -1;
     }
+    if (!check_embedding_db(db_path, mapped.view.task_id, mapped.view.dim))
+        return -1;
 
-    // 1) read all embeddings
-    std::vector<std::pair<std::string, std::vector<float>>> rows;
-    rows.reserve(2000);
+    // the tiled path needs unit rows: normalize a copy if not stored so
+    FeatureDB unit_db;
+    FeatureDBView db = mapped.view;
+    if (!db.normalized) {
+        std::cerr << "Normalizing " << db_path
+                  << " in memory (convert_db --normalize avoids this)\n";
+        if (mapped.map_base == nullptr) {
+            // CSV: already parsed into memory, normalize those rows
+            unit_db = std::move(mapped.owned);
+        } else {
+            // binary: the mapping is read-only, copy its rows out
+            unit_db.task_id = db.task_id;
+            unit_db.dim = db.dim;
+            unit_db.rows = db.rows;
+            unit_db.decode_scale = db.decode_scale;
+            unit_db.name_offsets.assign(db.name_offsets,
+                                        db.name_offsets + db.rows + 1);
+            unit_db.name_chars.assign(db.name_chars,
+                                      db.name_offsets[db.rows]);
+            unit_db.data.assign(db.data, db.data + db.rows * db.dim);
+        }
+        feature_db_normalize(unit_db);
+        db = feature_db_view(unit_db);
+    }
 
+    std::ifstream list(list_path);
+    if (!list.is_open()) {
+        std::cerr << "Cannot open target list: " << list_path << "\n";
+        return -1;
+    }
+    std::vector<std::string> names;
+    std::vector<std::vector<float>> queries;
+    std::vector<size_t> skip;
     std::string line;
-    while (std::getline(in, line)) {
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
         if (line.empty())
             continue;
-        std::string fname;
-        std::vector<float> feat;
-        if (!parse_csv_row(line, fname, feat))
+        size_t row = 0;
+        if (!feature_db_find(db, line, row)) {
+            std::cerr << "Target filename not found in embedding database: "
+                      << line << "\n";
             continue;
-        rows.push_back({fname, feat});
+        }
+        const float *r = feature_db_row(db, row);
+        names.push_back(line);
+        queries.emplace_back(r, r + db.dim);
+        skip.push_back(row);
     }
-    in.close();
 
-    // 2) find target embedding
-    std::vector<float> target_feat;
-    bool found = false;
-    for (const auto &r : rows) {
-        if (r.first == target_name) {
-            target_feat = r.second;
-            found = true;
-            break;
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::vector<RowMatch>> results;
+    rank_database_batch(db, queries, get_task(5), skip, opt, results);
+    const double sec = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - t0)
+                           .count();
+
+    std::ofstream file;
+    if (out_path != "-") {
+        file.open(out_path, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Cannot write results: " << out_path << "\n";
+            return -1;
         }
     }
-    if (!found) {
-        std::cerr << "Target filename not found in embedding csv: "
-                  << target_name << "\n";
+    std::ostream &out = out_path != "-" ? file : std::cout;
+    out << "target,rank,match,dist\n";
+    for (size_t q = 0; q < results.size(); q++) {
+        for (size_t k = 0; k < results[q].size(); k++)
+            out << names[q] << "," << (k + 1) << ","
+                << feature_db_name(db, results[q][k].row) << ","
+                << results[q][k].dist << "\n";
+    }
+    if (!out) {
+        std::cerr << "Cannot write results: " << out_path << "\n";
         return -1;
     }
 
-    // 3) compute distances (exclude itself)
-    std::vector<Match> matches;
-    matches.reserve(rows.size());
+    std::fprintf(stderr, "Ranked %zu targets x %zu rows in %.3f s -> %s\n",
+                 queries.size(), db.rows, sec, out_path.c_str());
+    return 0;
+}
 
-    for (const auto &r : rows) {
-        if (r.first == target_name)
-            continue;
+/*
+    main
 
-        // sanity: should be 512 dims
-        if (r.second.size() != target_feat.size())
-            continue;
+    Query the embedding database by filename and print top cosine matches.
+    Usage: ./query_task5 <target_filename> <embedding_db|csv> <topN>
+                         [--threads N] [--hnsw <index> [--ef N]]
+                         [--pq <index> [--rerank N]] [--recall]
+           ./query_task5 <target_list> <embedding_db|csv> <topN> --batch
+                         [--out results.csv] [--threads N]
 
-        float d = cosine_distance(target_feat, r.second);
-        matches.push_back({r.first, d});
+    Arguments:
+        int argc - argument count.
+        char **argv - argument values.
+
+    Returns:
+        0 on success, negative value on error.
+*/
+int main(int argc, char **argv) {
+    RankOptions opt;
+    bool threads_given = false;
+    std::string hnsw_path;
+    std::string pq_path;
+    size_t ef = 64;
+    size_t rerank = 100;
+    bool recall = false;
+    bool batch = false;
+    std::string out_path = "-";
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            opt.threads = std::atoi(argv[++i]);
+            threads_given = true;
+        } else if (arg == "--hnsw" && i + 1 < argc)
+            hnsw_path = argv[++i];
+        else if (arg == "--ef" && i + 1 < argc)
+            ef = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--pq" && i + 1 < argc)
+            pq_path = argv[++i];
+        else if (arg == "--rerank" && i + 1 < argc)
+            rerank = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--recall")
+            recall = true;
+        else if (arg == "--batch")
+            batch = true;
+        else if (arg == "--out" && i + 1 < argc)
+            out_path = argv[++i];
+        else
+            args.push_back(arg);
+    }
+
+    if (args.size() < 3) {
+        std::cerr << "usage: " << argv[0]
+                  << " <target_filename> <embedding_db|csv> <topN> "
+                     "[--threads N] [--hnsw <index> [--ef N]] "
+                     "[--pq <index> [--rerank N]] [--recall]\n"
+                  << "       " << argv[0]
+                  << " <target_list> <embedding_db|csv> <topN> --batch "
+                     "[--out results.csv] [--threads N]\n";
+        return -1;
+    }
+
+    const std::string target_name = args[0]; // e.g., pic.0535.jpg
+    const std::string db_path = args[1];
+    const int topN = std::max(1, std::atoi(args[2].c_str()));
+    opt.top_k = topN;
+    if (batch)
+        return run_batch(args[0], db_path, opt, out_path);
+
+    // 1) map all embeddings (binary in place, CSV parsed), or every shard
+    ShardedDB sharded;
+    if (!open_sharded_db(db_path, sharded)) {
+        std::cerr << "Cannot load embedding database: " << db_path << "\n";
+        return -1;
+    }
+    if (sharded.rows == 0) {
+        std::cerr << "Embedding database is empty: " << db_path << "\n";
+        return -1;
+    }
+    if (!check_embedding_db(db_path, sharded.task_id, sharded.dim))
+        return -1;
+    if (sharded.shards.size() > 1 &&
+        (!hnsw_path.empty() || !pq_path.empty())) {
+        std::cerr << "--hnsw and --pq need an unsharded database\n";
+        return -1;
     }
+    // index searches run on the only shard
+    const FeatureDBView &db = sharded.shards[0]->view;
+    if (!threads_given)
+        opt.threads = default_shard_threads(sharded);
 
-    // 4) sort ascending
-    std::sort(
-        matches.begin(), matches.end(),
-        [](const Match &m1, const Match &m2) { return m1.dist < m2.dist; });
+    // 2) find target embedding
+    size_t target_idx = 0;
+    if (!sharded_db_find(sharded, target_name, target_idx)) {
+        std::cerr << "Target filename not found in embedding database: "
+                  << target_name << "\n";
+        return -1;
+    }
+    const float *target_row = sharded_db_row(sharded, target_idx);
+    const std::vector<float> target_feat(target_row,
+                                         target_row + sharded.dim);
+
+    // 3) compute distances (exclude itself) and keep the topN closest
+    const TaskSpec spec = get_task(5);
+    std::vector<RowMatch> matches;
+    if (hnsw_path.empty() && pq_path.empty()) {
+        rank_sharded(sharded, target_feat, spec, target_idx, opt, matches);
+    } else if (!hnsw_path.empty()) {
+        HnswIndex index;
+        if (!read_hnsw_index(hnsw_path, index)) {
+            std::cerr << "Cannot read HNSW index: " << hnsw_path << "\n";
+            return -1;
+        }
+        if (index.rows != db.rows || index.dim != db.dim) {
+            std::cerr << "HNSW index " << hnsw_path << " was built for "
+                      << index.rows << " x " << index.dim
+                      << ", database is " << db.rows << " x " << db.dim
+                      << "; rebuild it\n";
+            return -1;
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        const size_t evals =
+            hnsw_search(index, db, spec.batch_dist, target_row, topN, ef,
+                        target_idx, matches);
+        const double ann_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - t0)
+                                  .count();
+        std::printf("HNSW: efSearch=%zu, %zu distance evaluations, "
+                    "%.3f ms\n",
+                    std::max(ef, (size_t)topN + 1), evals, ann_ms);
+    } else {
+        PQIndex index;
+        if (!read_pq_index(pq_path, index)) {
+            std::cerr << "Cannot read PQ index: " << pq_path << "\n";
+            return -1;
+        }
+        if (index.rows != db.rows || index.dim != db.dim) {
+            std::cerr << "PQ index " << pq_path << " was built for "
+                      << index.rows << " x " << index.dim
+                      << ", database is " << db.rows << " x " << db.dim
+                      << "; rebuild it\n";
+            return -1;
+        }
+
+        const auto t0 = std::chrono::steady_clock::now();
+        pq_search(index, db, spec.batch_dist, target_row, topN, rerank,
+                  target_idx, matches);
+        const double ann_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - t0)
+                                  .count();
+        std::printf("PQ: m=%zu (%zu bytes/row), %zu rows re-ranked, "
+                    "%.3f ms\n",
+                    index.m, index.m, std::min(rerank, db.rows - 1), ann_ms);
+    }
+
+    if (recall && (!hnsw_path.empty() || !pq_path.empty())) {
+        const auto t1 = std::chrono::steady_clock::now();
+        std::vector<RowMatch> exact;
+        rank_database(db, target_feat, spec, target_idx, opt, exact);
+        const double exact_ms = std::chrono::duration<double, std::milli>(
+                                    std::chrono::steady_clock::now() - t1)
+                                    .count();
+
+        size_t hits = 0;
+        for (const RowMatch &e : exact)
+            for (const RowMatch &m : matches)
+                hits += (m.row == e.row);
+        std::printf("Exact: %zu distance evaluations, %.3f ms\n"
+                    "recall@%d = %.3f\n",
+                    db.rows - 1, exact_ms, topN,
+                    exact.empty() ? 1.0 : (double)hits / exact.size());
+    }
 
     std::cout << "Top " << topN
               << " matches (Task5 cosine) for target: " << target_name << "\n";
     for (int i = 0; i < topN && i < (int)matches.size(); i++) {
-        std::cout << (i + 1) << ") " << matches[i].filename
+        std::cout << (i + 1) << ") "
+                  << sharded_db_name(sharded, matches[i].row)
                   << "  dist=" << matches[i].dist << "\n";
     }
 
@@ -5,46 +5,46 @@
     CS5330 Project 2 - query_task7_grass.cpp
 
     This file implements Task 7 querying by combining deep embeddings
-    with green grass features for lawn/grass detection.
+    with green grass features for lawn/grass detection. The fusion is
+    Task 7's composite TaskSpec, ranked by the shared search engine.
+    Grass features come from a Task 7 feature database when one is given,
+    so a query decodes only the target image (or none).
 */
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
-#include <fstream>
+#include <cstdio>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "../include/csv_io.h"
-#include "../include/features.h"
-#include "../include/ranking.h"
-
-/*
-    basename_only
-
-    Return the filename portion of a path for matching target names.
-
-    Arguments:
-        const std::string &path - input path.
-
-    Returns:
-        filename without parent directories.
-*/
-static std::string basename_only(const std::string &path) {
-    // Find the last occurrence of '/' or '\\' in the path
-    const size_t pos = path.find_last_of("/\\");
-    // If not found, return the whole path; otherwise, return the substring
-    // after the last separator
-    return (pos == std::string::npos) ? path : path.substr(pos + 1);
-}
+#include "../include/build_pipeline.h"
+#include "../include/feature_db.h"
+#include "../include/search.h"
+#include "../include/task_registry.h"
+#include "../include/utils.h"
 
 /*
     main
 
     Query Task 7 by fusing embedding and grass-feature distances.
-    Usage: ./query_task7_grass <target_image> <image_dir> <emb_csv> <topN>
-   [--bottom]
+    Usage: ./query_task7_grass <target_image> <image_dir> <emb_db> <topN>
+   [--bottom] [--grass-db <grass_db>] [--threads N] [--cascade N]
+   [--recall]
+
+    The fusion (components, weights, green cutoff) is Task 7's composite
+    TaskSpec and ranking runs in rank_composite. The target is matched to
+    its rows by its path under image_dir, as in query_db. With --grass-db,
+    database grass features are read from a Task 7 feature database
+    (build_db <image_dir> <grass_db> 7); otherwise they are computed from
+    the images in image_dir at full resolution. The target is decoded at
+    the grass database's scale. --cascade N passes
+    only the N best rows by grass distance on to the embedding distance;
+    --recall also runs the exact ranking and reports how many of its
+    matches the cascade found.
 
     Arguments:
         int argc - argument count.
@@ -54,126 +54,181 @@ static std::string basename_only(const std::string &path) {
         0 on success, negative value on error.
 */
 int main(int argc, char **argv) {
+    // split options from positional arguments
+    std::vector<std::string> pos;
+    bool show_bottom = false;
+    std::string grass_path;
+    int threads = 1;
+    size_t cascade = 0;
+    bool recall = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--bottom") {
+            show_bottom = true;
+        } else if (arg == "--grass-db" && i + 1 < argc) {
+            grass_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else if (arg == "--cascade" && i + 1 < argc) {
+            cascade = (size_t)std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--recall") {
+            recall = true;
+        } else {
+            pos.push_back(arg);
+        }
+    }
+
     // validate arguments
-    if (argc < 5) {
-        std::cerr
-            << "Usage: " << argv[0]
-            << " <target_image> <image_dir> <emb_csv> <topN> [--bottom]\n";
+    if (pos.size() < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <target_image> <image_dir> <emb_db> <topN> [--bottom]"
+                     " [--grass-db <grass_db>] [--threads N] [--cascade N]"
+                     " [--recall]\n";
         return -1;
     }
 
     // parse arguments
-    const std::string target_path = argv[1];
-    const std::string image_dir = argv[2];
-    const std::string emb_csv = argv[3];
+    const std::string target_path = pos[0];
+    const std::string image_dir = pos[1];
+    const std::string emb_path = pos[2];
     const int topN =
         std::max(1,
-                 std::atoi(argv[4])); // atoi: convert string to int
-    const bool show_bottom = (argc >= 6 && std::string(argv[5]) == "--bottom");
-    const std::string target_name = basename_only(target_path);
-
-    // Read embeddings
-    std::ifstream in(emb_csv); // input file stream
-    if (!in.is_open()) {
-        std::cerr << "Cannot open " << emb_csv << "\n";
+                 std::atoi(pos[3].c_str())); // atoi: convert string to int
+    // rows of a --recursive build are named by their path under
+    // image_dir (a target outside image_dir falls back to its filename)
+    const std::string target_name = image_row_name(target_path, image_dir);
+    const TaskSpec spec = get_task(7);
+
+    // Map embeddings (binary in place, CSV parsed)
+    MappedFeatureDB mapped;
+    if (!map_feature_db(emb_path, mapped)) {
+        std::cerr << "Cannot open " << emb_path << "\n";
         return -1;
     }
+    const FeatureDBView &db = mapped.view;
 
-    // Parallel arrays: names[i] corresponds to embs[i]
-    std::vector<std::string> names;
-    std::vector<std::vector<float>> embs;
-    std::vector<float> target_emb;
-    bool found_target = false;
-
-    std::string line;
-    while (std::getline(in, line)) { // read line by line until EOF(end of file)
-        if (line.empty())
-            continue; // skip empty lines
-        std::string fname;
+    size_t target_idx = 0;
+    if (!feature_db_find(db, target_name, target_idx)) {
+        std::cerr << "Target not found in database\n";
+        return -1;
+    }
+    const float *target_row = feature_db_row(db, target_idx);
+
+    // Grass features: mapped from a Task 7 database, or computed from the
+    // images of the embedding database's rows
+    MappedFeatureDB grass_mapped;
+    FeatureDB grass_built;
+    FeatureDBView grass;
+    int decode_scale = 1;
+    if (!grass_path.empty()) {
+        if (!map_feature_db(grass_path, grass_mapped)) {
+            std::cerr << "Cannot open " << grass_path << "\n";
+            return -1;
+        }
+        grass = grass_mapped.view;
+        if (grass.task_id != 7 && grass.task_id != 0) {
+            std::cerr << grass_path << " is not a Task 7 grass database\n";
+            return -1;
+        }
+        decode_scale = grass.decode_scale;
+    } else {
+        grass_built.task_id = 7;
+        grass_built.decode_scale = decode_scale;
         std::vector<float> feat;
-        if (!parse_csv_row(line, fname, feat))
-            continue;
-        if (feat.size() != 512)
-            continue;
-
-        names.push_back(fname);
-        embs.push_back(feat);
-        if (fname == target_name) {
-            target_emb = feat;
-            found_target = true;
+        for (size_t i = 0; i < db.rows; ++i) {
+            const std::string name(feature_db_name(db, i));
+            cv::Mat img = decode_image(image_dir + "/" + name, decode_scale);
+            if (img.empty() || !spec.feature(img, feat))
+                continue;
+            feature_db_append(grass_built, name, feat);
         }
+        grass = feature_db_view(grass_built);
     }
-    in.close();
 
-    if (!found_target) {
-        std::cerr << "Target not found in CSV\n";
+    CompositeDB cdb;
+    if (!composite_db_build(spec, {&grass, &db}, cdb)) {
+        std::cerr << "Databases do not match Task 7 (grass features need "
+                  << spec.components[0].dim << " values, embeddings "
+                  << spec.components[1].dim << ")\n";
         return -1;
     }
 
-    // Extract target features
-    cv::Mat target_img = cv::imread(target_path);
-    if (target_img.empty()) {
-        std::cerr << "Cannot read target\n";
-        return -1;
+    // Target features: stored rows if present, else decode the target
+    std::vector<std::vector<float>> queries(2);
+    size_t skip_row = NO_ROW;
+    if (feature_db_find(grass, target_name, skip_row)) {
+        const float *f = feature_db_row(grass, skip_row);
+        queries[0].assign(f, f + grass.dim);
+    } else {
+        cv::Mat target_img = decode_image(target_path, decode_scale);
+        if (target_img.empty()) {
+            std::cerr << "Cannot read target\n";
+            return -1;
+        }
+        if (!spec.feature(target_img, queries[0])) {
+            std::cerr << "Failed to extract target features\n";
+            return -1;
+        }
     }
-
-    std::vector<float> target_feat;
-    if (!extract_grass_features(target_img, target_feat)) {
-        std::cerr << "Failed to extract target features\n";
+    queries[1].assign(target_row, target_row + db.dim);
+
+    std::cout << "Target green ratio: " << queries[0][0] << "\n";
+
+    RankOptions opt;
+    opt.top_k = topN;
+    opt.bottom = show_bottom;
+    opt.threads = threads;
+    opt.cascade = cascade;
+    std::vector<RowMatch> matches;
+    std::vector<StageCount> stages;
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!rank_composite(cdb, queries, spec, skip_row, opt, matches,
+                        stages)) {
+        std::cerr << "Target feature dimension does not match\n";
         return -1;
     }
-
-    std::cout << "Target green ratio: " << target_feat[0] << "\n";
-
-    // Compute distances
-    std::vector<Match> matches;
-    for (size_t i = 0; i < names.size(); ++i) {
-        if (names[i] == target_name)
-            continue;
-
-        cv::Mat img = cv::imread(image_dir + "/" + names[i]);
-        if (img.empty())
-            continue;
-
-        std::vector<float> db_feat;
-        if (!extract_grass_features(img, db_feat))
-            continue;
-
-        // Skip images with very little green
-        if (db_feat[0] < 0.05)
-            continue;
-
-        float d_emb = cosine_distance(target_emb, embs[i]);
-        float d_grass = grass_distance(target_feat, db_feat);
-
-        // Fusion: 40% DNN + 60% grass features
-        float d = 0.4f * d_emb + 0.6f * d_grass;
-
-        matches.push_back({names[i], d});
+    const double ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+
+    if (cascade > 0 || recall) {
+        for (size_t c = 0; c < stages.size(); ++c)
+            std::printf("Stage %zu (task %d): %zu in, %zu scored, %zu "
+                        "passed on\n",
+                        c + 1, spec.components[c].task_id, stages[c].in,
+                        stages[c].scored, stages[c].out);
+        std::printf("Ranking: %.3f ms\n", ms);
+    }
+    if (recall) {
+        RankOptions exact_opt = opt;
+        exact_opt.cascade = 0;
+        std::vector<RowMatch> exact;
+        std::vector<StageCount> exact_stages;
+        rank_composite(cdb, queries, spec, skip_row, exact_opt, exact,
+                       exact_stages);
+        size_t hits = 0;
+        for (const RowMatch &e : exact)
+            for (const RowMatch &m : matches)
+                hits += (m.row == e.row);
+        std::printf("recall@%d = %.3f\n", topN,
+                    exact.empty() ? 1.0 : (double)hits / exact.size());
     }
 
-    // Sort and print
     if (show_bottom) {
-        std::sort(
-            matches.begin(), matches.end(),
-            [](const Match &a, const Match &b) { return a.dist > b.dist; });
         std::cout << "\nTask 7: Grass/Lawn Detection - Bottom " << topN
                   << " matches\n";
     } else {
-        std::sort(
-            matches.begin(), matches.end(),
-            [](const Match &a, const Match &b) { return a.dist < b.dist; });
         std::cout << "\nTask 7: Grass/Lawn Detection - Top " << topN
                   << " matches\n";
     }
     std::cout << "Target: " << target_path << "\n\n";
 
-    for (int k = 0; k < topN && k < (int)matches.size(); ++k) {
-        const std::string fullpath = image_dir + "/" + matches[k].filename;
-        std::cout << (k + 1) << ") " << matches[k].filename
-                  << " dist=" << matches[k].dist << " fullpath=" << fullpath
-                  << "\n";
+    for (size_t k = 0; k < matches.size(); ++k) {
+        const std::string_view fname = feature_db_name(grass, matches[k].row);
+        const std::string fullpath = image_dir + "/" + std::string(fname);
+        std::cout << (k + 1) << ") " << fname << " dist=" << matches[k].dist
+                  << " fullpath=" << fullpath << "\n";
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -11,8 +11,11 @@
 #include "../include/ranking.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 
+#include "../include/distance_kernels.h"
+
 /*
     ssd_distance
 
@@ -28,12 +31,7 @@
 float ssd_distance(const std::vector<float> &a, const std::vector<float> &b) {
     if (a.size() != b.size())
         return 1e30f;
-    double s = 0.0;
-    for (size_t i = 0; i < a.size(); ++i) {
-        const double d = static_cast<double>(a[i]) - static_cast<double>(b[i]);
-        s += d * d;
-    }
-    return static_cast<float>(s);
+    return kernel_ssd(a.data(), b.data(), a.size());
 }
 
 /*
@@ -53,6 +51,49 @@ void sort_matches(std::vector<Match> &matches) {
         [](const Match &m1, const Match &m2) { return m1.dist < m2.dist; });
 }
 
+// Task 4 feature layout: rg color histogram, magnitude, orientation
+#define T4_COLOR_DIM (16 * 16) // 256 (rg 2D hist)
+#define T4_MAG_DIM 16          // must match mag_bins
+#define T4_ORI_DIM 18          // must match ori_bins
+
+// rows scored per block by the batch functions that need scratch space
+#define BATCH_BLOCK 256
+
+/*
+    task3_combine / task4_combine / cosine_combine
+
+    Turn kernel sums into the final distance. Shared by the pairwise and
+    batch functions so both produce bit-identical results.
+*/
+static float task3_combine(float sim0, float sim1, float w_whole,
+                           float w_center) {
+    const double d0 = 1.0 - (double)sim0; // whole
+    const double d1 = 1.0 - (double)sim1; // center
+    return (float)((double)w_whole * d0 + (double)w_center * d1);
+}
+
+static float task4_combine(float sim_c, float sim_m, float sim_o) {
+    const double d_color = 1.0 - (double)sim_c;
+    const double d_mag = 1.0 - (double)sim_m;
+    const double d_ori = 1.0 - (double)sim_o;
+
+    // texture distance: equal weight between magnitude and orientation
+    const double d_tex = 0.5 * d_mag + 0.5 * d_ori;
+
+    // Task4 requirement: equal weight between color and texture
+    return (float)(0.5 * d_color + 0.5 * d_tex);
+}
+
+static float cosine_combine(float dot, float na, float nb) {
+    // finish in double as before; only the accumulation runs in float
+    const double denom = std::sqrt((double)na) * std::sqrt((double)nb);
+    if (denom <= 1e-12)
+        return 1e30f;
+
+    const double cosv = dot / denom; // in [-1,1] typically
+    return (float)(1.0 - cosv);      // cosine distance
+}
+
 /*
     hist_intersection_distance
 
@@ -69,10 +110,7 @@ float hist_intersection_distance(const std::vector<float> &a,
                                  const std::vector<float> &b) {
     if (a.size() != b.size())
         return 1e30f;
-    double sim = 0.0;
-    for (size_t i = 0; i < a.size(); i++) {
-        sim += std::min((double)a[i], (double)b[i]);
-    }
+    const double sim = kernel_min_sum(a.data(), b.data(), a.size());
     // distance: smaller = more similar
     return (float)(1.0 - sim);
 }
@@ -103,22 +141,10 @@ float task3_multi_hist_distance(const std::vector<float> &a,
         return 1e30f;
 
     const size_t seg_len = a.size() / 2;
-
-    // segment 0: whole
-    double sim0 = 0.0;
-    for (size_t i = 0; i < seg_len; i++)
-        sim0 += std::min((double)a[i], (double)b[i]);
-    double d0 = 1.0 - sim0;
-
-    // segment 1: center
-    double sim1 = 0.0;
-    for (size_t i = 0; i < seg_len; i++)
-        sim1 += std::min((double)a[seg_len + i], (double)b[seg_len + i]);
-    double d1 = 1.0 - sim1;
-
-    // weighted combination
-    double d = (double)w_whole * d0 + (double)w_center * d1;
-    return (float)d;
+    const float sim0 = kernel_min_sum(a.data(), b.data(), seg_len);
+    const float sim1 =
+        kernel_min_sum(a.data() + seg_len, b.data() + seg_len, seg_len);
+    return task3_combine(sim0, sim1, w_whole, w_center);
 }
 
 /*
@@ -152,40 +178,17 @@ float task3_distance(const std::vector<float> &a, const std::vector<float> &b) {
 float task4_distance(const std::vector<float> &a, const std::vector<float> &b) {
     if (a.size() != b.size())
         return 1e30f;
-
-    const size_t color_dim = 16 * 16; // 256 (rg 2D hist)
-    const size_t mag_dim = 16;        // must match mag_bins
-    const size_t ori_dim = 18;        // must match ori_bins
-
-    if (a.size() != color_dim + mag_dim + ori_dim)
+    if (a.size() != T4_COLOR_DIM + T4_MAG_DIM + T4_ORI_DIM)
         return 1e30f;
 
-    // color intersection distance
-    double sim_c = 0.0;
-    for (size_t i = 0; i < color_dim; i++)
-        sim_c += std::min((double)a[i], (double)b[i]);
-    double d_color = 1.0 - sim_c;
-
-    // magnitude intersection distance
-    const size_t mag_off = color_dim;
-    double sim_m = 0.0;
-    for (size_t i = 0; i < mag_dim; i++)
-        sim_m += std::min((double)a[mag_off + i], (double)b[mag_off + i]);
-    double d_mag = 1.0 - sim_m;
-
-    // orientation intersection distance
-    const size_t ori_off = color_dim + mag_dim;
-    double sim_o = 0.0;
-    for (size_t i = 0; i < ori_dim; i++)
-        sim_o += std::min((double)a[ori_off + i], (double)b[ori_off + i]);
-    double d_ori = 1.0 - sim_o;
-
-    // texture distance: equal weight between magnitude and orientation
-    double d_tex = 0.5 * d_mag + 0.5 * d_ori;
-
-    // Task4 requirement: equal weight between color and texture
-    double d = 0.5 * d_color + 0.5 * d_tex;
-    return (float)d;
+    const size_t mag_off = T4_COLOR_DIM;
+    const size_t ori_off = T4_COLOR_DIM + T4_MAG_DIM;
+    const float sim_c = kernel_min_sum(a.data(), b.data(), T4_COLOR_DIM);
+    const float sim_m =
+        kernel_min_sum(a.data() + mag_off, b.data() + mag_off, T4_MAG_DIM);
+    const float sim_o =
+        kernel_min_sum(a.data() + ori_off, b.data() + ori_off, T4_ORI_DIM);
+    return task4_combine(sim_c, sim_m, sim_o);
 }
 
 /*
@@ -205,21 +208,273 @@ float cosine_distance(const std::vector<float> &a,
     if (a.size() != b.size() || a.empty())
         return 1e30f;
 
-    double dot = 0.0, na = 0.0, nb = 0.0;
-    for (size_t i = 0; i < a.size(); i++) {
-        const double x = (double)a[i];
-        const double y = (double)b[i];
-        dot += x * y;
-        na += x * x;
-        nb += y * y;
+    float dot = 0.0f, na = 0.0f, nb = 0.0f;
+    kernel_dot_norms(a.data(), b.data(), a.size(), dot, na, nb);
+    return cosine_combine(dot, na, nb);
+}
+
+/*
+    ssd_distance_batch
+
+    Batched ssd_distance: query against n rows of a row-major matrix.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void ssd_distance_batch(const float *query, const float *rows, size_t n,
+                        size_t dim, float *out) {
+    kernel_ssd_batch(query, rows, n, dim, dim, out);
+}
+
+/*
+    hist_intersection_distance_batch
+
+    Batched hist_intersection_distance.
+
+    Arguments:
+        const float *query - query histogram (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void hist_intersection_distance_batch(const float *query, const float *rows,
+                                      size_t n, size_t dim, float *out) {
+    kernel_min_sum_batch(query, rows, n, dim, dim, out);
+    for (size_t r = 0; r < n; r++)
+        out[r] = (float)(1.0 - (double)out[r]);
+}
+
+/*
+    ssd_distance_bounded_batch
+
+    Batched ssd_distance that may stop rows that cannot reach `bound`.
+
+    Arguments:
+        const float *query - query feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float bound - current cut-off distance.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void ssd_distance_bounded_batch(const float *query, const float *rows,
+                                size_t n, size_t dim, float bound,
+                                float *out) {
+    kernel_ssd_bounded_batch(query, rows, n, dim, dim, bound, out);
+}
+
+/*
+    hist_intersection_distance_bounded_batch
+
+    Batched hist_intersection_distance that may stop rows that cannot
+    reach `bound`. A distance above the bound is an intersection below
+    1 - bound; the kernel's floor sits a little lower still, so that a
+    stopped row's distance stays above the bound after rounding.
+
+    Arguments:
+        const float *query - query histogram (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float bound - current cut-off distance.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void hist_intersection_distance_bounded_batch(const float *query,
+                                              const float *rows, size_t n,
+                                              size_t dim, float bound,
+                                              float *out) {
+    const double floor =
+        1.0 - (double)bound - 1e-5 * (1.0 + std::fabs((double)bound));
+    kernel_min_sum_bounded_batch(query, rows, n, dim, dim, (float)floor,
+                                 out);
+    for (size_t r = 0; r < n; r++)
+        out[r] = (float)(1.0 - (double)out[r]);
+}
+
+/*
+    task3_multi_hist_distance_batch
+
+    Batched task3_multi_hist_distance.
+
+    Arguments:
+        const float *query - query multi-histogram (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float w_whole - weight for whole-image histogram distance.
+        float w_center - weight for center-region histogram distance.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void task3_multi_hist_distance_batch(const float *query, const float *rows,
+                                     size_t n, size_t dim, float w_whole,
+                                     float w_center, float *out) {
+    if (dim % 2 != 0) {
+        std::fill(out, out + n, 1e30f);
+        return;
     }
 
-    const double denom = std::sqrt(na) * std::sqrt(nb);
-    if (denom <= 1e-12)
-        return 1e30f;
+    const size_t seg_len = dim / 2;
+    float sim1[BATCH_BLOCK];
+    for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+        const size_t m = std::min((size_t)BATCH_BLOCK, n - start);
+        const float *block = rows + start * dim;
+        float *sim0 = out + start; // whole-image sims, overwritten below
+        kernel_min_sum_batch(query, block, m, dim, seg_len, sim0);
+        kernel_min_sum_batch(query + seg_len, block + seg_len, m, dim, seg_len,
+                             sim1);
+        for (size_t r = 0; r < m; r++)
+            out[start + r] = task3_combine(sim0[r], sim1[r], w_whole, w_center);
+    }
+}
 
-    const double cosv = dot / denom; // in [-1,1] typically
-    return (float)(1.0 - cosv);      // cosine distance
+/*
+    task4_distance_batch
+
+    Batched task4_distance.
+
+    Arguments:
+        const float *query - query Task 4 feature (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void task4_distance_batch(const float *query, const float *rows, size_t n,
+                          size_t dim, float *out) {
+    if (dim != T4_COLOR_DIM + T4_MAG_DIM + T4_ORI_DIM) {
+        std::fill(out, out + n, 1e30f);
+        return;
+    }
+
+    const size_t mag_off = T4_COLOR_DIM;
+    const size_t ori_off = T4_COLOR_DIM + T4_MAG_DIM;
+    float sim_m[BATCH_BLOCK];
+    float sim_o[BATCH_BLOCK];
+    for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+        const size_t m = std::min((size_t)BATCH_BLOCK, n - start);
+        const float *block = rows + start * dim;
+        float *sim_c = out + start; // color sims, overwritten below
+        kernel_min_sum_batch(query, block, m, dim, T4_COLOR_DIM, sim_c);
+        kernel_min_sum_batch(query + mag_off, block + mag_off, m, dim,
+                             T4_MAG_DIM, sim_m);
+        kernel_min_sum_batch(query + ori_off, block + ori_off, m, dim,
+                             T4_ORI_DIM, sim_o);
+        for (size_t r = 0; r < m; r++)
+            out[start + r] = task4_combine(sim_c[r], sim_m[r], sim_o[r]);
+    }
+}
+
+/*
+    cosine_distance_batch
+
+    Batched cosine_distance.
+
+    Arguments:
+        const float *query - query embedding (dim values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void cosine_distance_batch(const float *query, const float *rows, size_t n,
+                           size_t dim, float *out) {
+    if (dim == 0) {
+        std::fill(out, out + n, 1e30f);
+        return;
+    }
+
+    float norms[BATCH_BLOCK];
+    for (size_t start = 0; start < n; start += BATCH_BLOCK) {
+        const size_t m = std::min((size_t)BATCH_BLOCK, n - start);
+        float *dots = out + start; // dot products, overwritten below
+        float nq = 0.0f;
+        kernel_dot_norms_batch(query, rows + start * dim, m, dim, dim, dots, nq,
+                               norms);
+        for (size_t r = 0; r < m; r++)
+            out[start + r] = cosine_combine(dots[r], nq, norms[r]);
+    }
+}
+
+/*
+    cosine_unit_distance
+
+    Cosine distance of two unit-length vectors: 1 - dot product.
+
+    Arguments:
+        const float *a - first vector (dim values).
+        const float *b - second vector (dim values).
+        size_t dim - feature dimension.
+
+    Returns:
+        cosine distance.
+*/
+float cosine_unit_distance(const float *a, const float *b, size_t dim) {
+    return (float)(1.0 - (double)kernel_dot(a, b, dim));
+}
+
+/*
+    cosine_unit_distance_batch
+
+    Batched cosine_unit_distance: one dot product per row.
+
+    Arguments:
+        const float *query - unit-length query (dim values).
+        const float *rows - first of n unit-length rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension.
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void cosine_unit_distance_batch(const float *query, const float *rows,
+                                size_t n, size_t dim, float *out) {
+    kernel_dot_batch(query, rows, n, dim, dim, out);
+    for (size_t r = 0; r < n; r++)
+        out[r] = (float)(1.0 - (double)out[r]);
+}
+
+/*
+    grass_combine
+
+    Weighted Euclidean distance of two 5D grass features. Shared by the
+    pairwise and batch functions so both give bit-identical results.
+*/
+static float grass_combine(const float *a, const float *b) {
+    float d = 0.0f;
+    d += 2.0f * (a[0] - b[0]) * (a[0] - b[0]); // green_ratio (important!)
+    d += 5.0f * (a[1] - b[1]) * (a[1] - b[1]); // H (color, very important!)
+    d += 3.0f * (a[2] - b[2]) * (a[2] - b[2]); // S
+    d += 1.0f * (a[3] - b[3]) * (a[3] - b[3]); // V
+    d += 0.5f * (a[4] - b[4]) * (a[4] - b[4]); // has_green flag
+
+    return std::sqrt(d);
 }
 
 /*
@@ -237,13 +492,30 @@ float cosine_distance(const std::vector<float> &a,
 float grass_distance(const std::vector<float> &a, const std::vector<float> &b) {
     if (a.size() != 5 || b.size() != 5)
         return 1e30f;
+    return grass_combine(a.data(), b.data());
+}
 
-    float d = 0.0f;
-    d += 2.0f * (a[0] - b[0]) * (a[0] - b[0]); // green_ratio (important!)
-    d += 5.0f * (a[1] - b[1]) * (a[1] - b[1]); // H (color, very important!)
-    d += 3.0f * (a[2] - b[2]) * (a[2] - b[2]); // S
-    d += 1.0f * (a[3] - b[3]) * (a[3] - b[3]); // V
-    d += 0.5f * (a[4] - b[4]) * (a[4] - b[4]); // has_green flag
+/*
+    grass_distance_batch
 
-    return std::sqrt(d);
-}
\ No newline at end of file
+    Batched grass_distance.
+
+    Arguments:
+        const float *query - query grass feature (5 values).
+        const float *rows - first of n rows, dim floats each.
+        size_t n - number of rows.
+        size_t dim - feature dimension (must be 5).
+        float *out - output distances, one per row.
+
+    Returns:
+        void.
+*/
+void grass_distance_batch(const float *query, const float *rows, size_t n,
+                          size_t dim, float *out) {
+    if (dim != 5) {
+        std::fill(out, out + n, 1e30f);
+        return;
+    }
+    for (size_t r = 0; r < n; r++)
+        out[r] = grass_combine(query, rows + r * dim);
+}
@@ -0,0 +1,727 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - search.cpp
+
+    This file implements the ranking engine shared by the query tools and
+    the query server.
+*/
+
+#include "../include/search.h"
+
+#include <algorithm>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "../include/distance_kernels.h"
+#include "../include/topk.h"
+
+// rows scored per batch distance call
+#define RANK_BLOCK 1024
+
+// multi-query tiles: rows per block (kept in L2) x queries per tile
+#define BATCH_ROW_BLOCK 128
+#define BATCH_QUERY_TILE 32
+
+// fewest rows worth handing to a thread of their own
+#define RANK_ROWS_PER_THREAD (64 * 1024)
+
+/*
+    scan_rows
+
+    Score rows [begin, end) against the query and offer them to `top`.
+    Tasks with a batch distance function are scored a block of rows at a
+    time straight from the matrix; others fall back to one pairwise call
+    per row. With `unit` set, rows are scored with the unit-vector
+    distance, and rows that were all zeros before normalization get the
+    cosine zero-vector sentinel, as in cosine_distance. Once `top` is
+    full, tasks with a bounded distance pass it the worst kept distance
+    so rows that cannot place stop early.
+
+    Arguments:
+        const FeatureDBView &db - database to scan.
+        const std::vector<float> &query - query feature (db.dim values).
+        const TaskSpec &spec - task distance functions.
+        bool unit - query and rows are unit length (normalized database).
+        size_t skip_row - row to leave out, or NO_ROW.
+        size_t begin - first row to score.
+        size_t end - one past the last row to score.
+        TopK &top - selector receiving the scores.
+
+    Returns:
+        void.
+*/
+static void scan_rows(const FeatureDBView &db, const std::vector<float> &query,
+                      const TaskSpec &spec, bool unit, size_t skip_row,
+                      size_t begin, size_t end, TopK &top) {
+    const BatchDistFunc batch = unit ? spec.unit_batch_dist : spec.batch_dist;
+    const BoundedBatchDistFunc bounded =
+        unit || top.bottom() ? nullptr : spec.bounded_batch_dist;
+    if (batch) {
+        std::vector<float> dists(std::min((size_t)RANK_BLOCK, end - begin));
+        for (size_t start = begin; start < end; start += RANK_BLOCK) {
+            const size_t n = std::min((size_t)RANK_BLOCK, end - start);
+            // once the selector is full, rows past its worst may stop early
+            if (bounded && top.full())
+                bounded(query.data(), feature_db_row(db, start), n, db.dim,
+                        top.worst(), dists.data());
+            else
+                batch(query.data(), feature_db_row(db, start), n, db.dim,
+                      dists.data());
+            for (size_t r = 0; unit && r < n; r++) {
+                if (db.norms[start + r] == 0.0f)
+                    dists[r] = 1e30f;
+            }
+            for (size_t r = 0; r < n; r++) {
+                if (start + r != skip_row)
+                    top.push(start + r, dists[r]);
+            }
+        }
+        return;
+    }
+
+    // reuse one row buffer for the vector-based distance functions
+    std::vector<float> feat(db.dim);
+    for (size_t i = begin; i < end; i++) {
+        if (i == skip_row)
+            continue;
+        const float *row = feature_db_row(db, i);
+        feat.assign(row, row + db.dim);
+        top.push(i, spec.dist(query, feat));
+    }
+}
+
+/*
+    rank_database
+
+    Score every row of the database against the query and keep the top_k
+    best rows in a bounded heap. With several threads, each scans one
+    contiguous slice of rows into its own heap and the heaps are merged;
+    distances do not depend on the slicing and ties are ordered by row,
+    so the output is identical to the serial scan. On a normalized
+    database, tasks with a unit-vector distance (cosine) normalize the
+    query once and rank by dot product alone.
+
+    Arguments:
+        const FeatureDBView &db - database to scan.
+        const std::vector<float> &query - query feature (db.dim values).
+        const TaskSpec &spec - task distance functions.
+        size_t skip_row - row to leave out (e.g. the target), or NO_ROW.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        true on success, false if the query dimension does not match.
+*/
+bool rank_database(const FeatureDBView &db, const std::vector<float> &query,
+                   const TaskSpec &spec, size_t skip_row,
+                   const RankOptions &opt, std::vector<RowMatch> &matches) {
+    matches.clear();
+    if (query.size() != db.dim)
+        return false;
+
+    // normalized rows: a unit query reduces cosine to one dot product
+    std::vector<float> unit_query;
+    bool unit = false;
+    if (db.normalized && spec.unit_batch_dist) {
+        unit_query = query;
+        unit = normalize_l2(unit_query.data(), db.dim) > 0.0f;
+    }
+    const std::vector<float> &q = unit ? unit_query : query;
+
+    size_t threads = opt.threads > 0
+                         ? (size_t)opt.threads
+                         : std::max(1u, std::thread::hardware_concurrency());
+    const size_t max_threads = db.rows / RANK_ROWS_PER_THREAD;
+    threads = std::max<size_t>(1, std::min(threads, max_threads));
+
+    TopK top(opt.top_k, opt.bottom);
+    if (threads <= 1) {
+        scan_rows(db, q, spec, unit, skip_row, 0, db.rows, top);
+        top.sorted(matches);
+        return true;
+    }
+
+    // contiguous slices, rounded to whole blocks
+    const size_t blocks = (db.rows + RANK_BLOCK - 1) / RANK_BLOCK;
+    std::vector<TopK> partial(threads, TopK(opt.top_k, opt.bottom));
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; t++) {
+        const size_t begin =
+            std::min(db.rows, blocks * t / threads * RANK_BLOCK);
+        const size_t end =
+            std::min(db.rows, blocks * (t + 1) / threads * RANK_BLOCK);
+        pool.emplace_back(scan_rows, std::cref(db), std::cref(q),
+                          std::cref(spec), unit, skip_row, begin, end,
+                          std::ref(partial[t]));
+    }
+    for (std::thread &th : pool)
+        th.join();
+
+    for (const TopK &p : partial)
+        top.merge(p);
+    top.sorted(matches);
+    return true;
+}
+
+/*
+    scan_unit_queries
+
+    Score queries [q_begin, q_end) of a unit-length query matrix against
+    every row of a normalized database, one block of rows at a time: each
+    block is multiplied with a tile of queries while it is in cache, and
+    the distances 1 - dot are offered to the queries' selectors.
+
+    Arguments:
+        const FeatureDBView &db - normalized database.
+        const std::vector<float> &qmat - unit queries, row-major, db.dim
+            floats each.
+        const std::vector<size_t> &skip - row to leave out per query.
+        size_t q_begin - first query.
+        size_t q_end - one past the last query.
+        std::vector<TopK> &tops - selector per query.
+
+    Returns:
+        void.
+*/
+static void scan_unit_queries(const FeatureDBView &db,
+                              const std::vector<float> &qmat,
+                              const std::vector<size_t> &skip, size_t q_begin,
+                              size_t q_end, std::vector<TopK> &tops) {
+    std::vector<float> dots(BATCH_QUERY_TILE * BATCH_ROW_BLOCK);
+    for (size_t start = 0; start < db.rows; start += BATCH_ROW_BLOCK) {
+        const size_t nr = std::min((size_t)BATCH_ROW_BLOCK, db.rows - start);
+        for (size_t qt = q_begin; qt < q_end; qt += BATCH_QUERY_TILE) {
+            const size_t nq = std::min((size_t)BATCH_QUERY_TILE, q_end - qt);
+            kernel_dot_tile(&qmat[qt * db.dim], nq, db.dim,
+                            feature_db_row(db, start), nr, db.dim, db.dim,
+                            dots.data(), BATCH_ROW_BLOCK);
+            for (size_t i = 0; i < nq; i++) {
+                const float *d = &dots[i * BATCH_ROW_BLOCK];
+                TopK &top = tops[qt + i];
+                for (size_t r = 0; r < nr; r++) {
+                    const size_t row = start + r;
+                    if (row == skip[qt + i])
+                        continue;
+                    // same value as cosine_unit_distance_batch
+                    top.push(row, db.norms[row] == 0.0f
+                                      ? 1e30f
+                                      : (float)(1.0 - (double)d[r]));
+                }
+            }
+        }
+    }
+}
+
+/*
+    rank_database_batch
+
+    Rank many queries against one database: a tiled matrix product for
+    cosine tasks on a normalized database, otherwise one rank_database
+    call per query.
+
+    Arguments:
+        const FeatureDBView &db - database to scan.
+        const std::vector<std::vector<float>> &queries - query features.
+        const TaskSpec &spec - task distance functions.
+        const std::vector<size_t> &skip_rows - row to leave out for each
+            query (NO_ROW for none); empty skips nothing.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<std::vector<RowMatch>> &results - output matches per
+            query, best first.
+
+    Returns:
+        true on success, false if a query dimension does not match.
+*/
+bool rank_database_batch(const FeatureDBView &db,
+                         const std::vector<std::vector<float>> &queries,
+                         const TaskSpec &spec,
+                         const std::vector<size_t> &skip_rows,
+                         const RankOptions &opt,
+                         std::vector<std::vector<RowMatch>> &results) {
+    results.assign(queries.size(), std::vector<RowMatch>());
+    for (const std::vector<float> &q : queries)
+        if (q.size() != db.dim)
+            return false;
+    std::vector<size_t> skip(skip_rows);
+    skip.resize(queries.size(), NO_ROW);
+
+    // unit queries go into one matrix; zero queries take the normal path
+    std::vector<size_t> tiled;
+    std::vector<float> qmat;
+    if (db.normalized && spec.unit_batch_dist) {
+        qmat.reserve(queries.size() * db.dim);
+        for (size_t i = 0; i < queries.size(); i++) {
+            std::vector<float> u(queries[i]);
+            if (normalize_l2(u.data(), db.dim) > 0.0f) {
+                tiled.push_back(i);
+                qmat.insert(qmat.end(), u.begin(), u.end());
+            }
+        }
+    }
+
+    std::vector<char> done(queries.size(), 0);
+    if (!tiled.empty()) {
+        std::vector<size_t> tiled_skip(tiled.size());
+        for (size_t t = 0; t < tiled.size(); t++)
+            tiled_skip[t] = skip[tiled[t]];
+        std::vector<TopK> tops(tiled.size(), TopK(opt.top_k, opt.bottom));
+
+        // whole query tiles per thread
+        size_t threads =
+            opt.threads > 0 ? (size_t)opt.threads
+                            : std::max(1u, std::thread::hardware_concurrency());
+        const size_t tiles =
+            (tiled.size() + BATCH_QUERY_TILE - 1) / BATCH_QUERY_TILE;
+        threads = std::max<size_t>(1, std::min(threads, tiles));
+        if (threads <= 1) {
+            scan_unit_queries(db, qmat, tiled_skip, 0, tiled.size(), tops);
+        } else {
+            std::vector<std::thread> pool;
+            for (size_t t = 0; t < threads; t++) {
+                const size_t begin = std::min(
+                    tiled.size(), tiles * t / threads * BATCH_QUERY_TILE);
+                const size_t end = std::min(
+                    tiled.size(), tiles * (t + 1) / threads * BATCH_QUERY_TILE);
+                pool.emplace_back(scan_unit_queries, std::cref(db),
+                                  std::cref(qmat), std::cref(tiled_skip),
+                                  begin, end, std::ref(tops));
+            }
+            for (std::thread &th : pool)
+                th.join();
+        }
+
+        for (size_t t = 0; t < tiled.size(); t++) {
+            tops[t].sorted(results[tiled[t]]);
+            done[tiled[t]] = 1;
+        }
+    }
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (!done[i])
+            rank_database(db, queries[i], spec, skip[i], opt, results[i]);
+    }
+    return true;
+}
+
+/*
+    align_rows
+
+    Find, for every row of `base`, the row of the same filename in
+    `other`. Databases built from one directory share their row order, so
+    names are compared in place first and a name index is built only
+    when they differ.
+
+    Arguments:
+        const FeatureDBView &base - database whose rows are matched.
+        const FeatureDBView &other - database searched for each name.
+        std::vector<size_t> &rows - output, row in `other` per base row,
+            or NO_ROW.
+
+    Returns:
+        void.
+*/
+static void align_rows(const FeatureDBView &base, const FeatureDBView &other,
+                       std::vector<size_t> &rows) {
+    rows.assign(base.rows, NO_ROW);
+    std::unordered_map<std::string_view, size_t> by_name;
+    for (size_t i = 0; i < base.rows; i++) {
+        const std::string_view name = feature_db_name(base, i);
+        if (i < other.rows && feature_db_name(other, i) == name) {
+            rows[i] = i;
+            continue;
+        }
+        if (by_name.empty()) {
+            by_name.reserve(other.rows);
+            for (size_t j = 0; j < other.rows; j++)
+                by_name.emplace(feature_db_name(other, j), j);
+        }
+        const auto it = by_name.find(name);
+        if (it != by_name.end())
+            rows[i] = it->second;
+    }
+}
+
+/*
+    composite_db_build
+
+    Check each database's dimension against its component, look up the
+    components' tasks, and match every database's rows to the base.
+
+    Arguments:
+        const TaskSpec &spec - composite task.
+        const std::vector<const FeatureDBView *> &dbs - one database per
+            component, in component order.
+        CompositeDB &cdb - output.
+
+    Returns:
+        true on success, false if the task is not composite or a database
+        is missing or has the wrong dimension.
+*/
+bool composite_db_build(const TaskSpec &spec,
+                        const std::vector<const FeatureDBView *> &dbs,
+                        CompositeDB &cdb) {
+    cdb = CompositeDB();
+    if (spec.components.empty() || dbs.size() != spec.components.size())
+        return false;
+    for (size_t c = 0; c < dbs.size(); c++) {
+        const TaskComponent &comp = spec.components[c];
+        if (!dbs[c] || (comp.dim != 0 && dbs[c]->dim != comp.dim))
+            return false;
+        cdb.specs.push_back(get_task(comp.task_id));
+    }
+
+    cdb.dbs = dbs;
+    cdb.rows.resize(dbs.size());
+    for (size_t c = 1; c < dbs.size(); c++)
+        align_rows(*dbs[0], *dbs[c], cdb.rows[c]);
+    return true;
+}
+
+/*
+    CompositeScan
+
+    Per-query state shared by the threads of rank_composite.
+*/
+struct CompositeScan {
+    const CompositeDB *cdb;
+    const TaskSpec *spec;
+    std::vector<std::vector<float>> queries; // unit length where `unit`
+    std::vector<char> unit; // component ranked by its unit distance
+    size_t skip_row;
+    bool prune; // drop rows that cannot reach the top-K (not for bottom)
+};
+
+/*
+    score_block
+
+    Run up to one block of candidates through components
+    [c_begin, c_end) and offer the survivors' sums to `top`. Each
+    component scores only the rows that are still candidates, in runs of
+    consecutive rows of its own database, and adds its weighted distance
+    to their sums. Between components, rows failing the next filter or
+    whose sum plus the remaining lower bounds is already worse than the
+    current top-K are dropped. The bound is accumulated in the same float
+    order as the sum, so it never exceeds the final value.
+
+    Arguments:
+        const CompositeScan &scan - query and task state.
+        size_t c_begin - first component to compute.
+        size_t c_end - one past the last component to compute.
+        std::vector<size_t> &cand - candidate base rows, ascending;
+            compacted in place.
+        std::vector<float> &sum - candidates' sums over the components
+            before c_begin (RANK_BLOCK floats); updated in place.
+        std::vector<float> &d - scratch (RANK_BLOCK floats).
+        TopK &top - selector receiving the sums.
+        std::vector<StageCount> &stages - per-component counts, added to.
+
+    Returns:
+        void.
+*/
+static void score_block(const CompositeScan &scan, size_t c_begin,
+                        size_t c_end, std::vector<size_t> &cand,
+                        std::vector<float> &sum, std::vector<float> &d,
+                        TopK &top, std::vector<StageCount> &stages) {
+    const CompositeDB &cdb = *scan.cdb;
+    const std::vector<TaskComponent> &comps = scan.spec->components;
+
+    for (size_t c = c_begin; c < c_end && !cand.empty(); c++) {
+        const TaskComponent &comp = comps[c];
+        const FeatureDBView &db = *cdb.dbs[c];
+        const auto row_of = [&](size_t r) {
+            return c == 0 ? r : cdb.rows[c][r];
+        };
+        stages[c].in += cand.size();
+
+        size_t kept = 0;
+        for (size_t i = 0; i < cand.size(); i++) {
+            if (comp.filter &&
+                !comp.filter(feature_db_row(db, row_of(cand[i])), db.dim))
+                continue;
+            sum[kept] = sum[i];
+            cand[kept++] = cand[i];
+        }
+        cand.resize(kept);
+        stages[c].scored += kept;
+
+        // score runs of consecutive rows with one batch call each
+        const BatchDistFunc batch = scan.unit[c]
+                                        ? cdb.specs[c].unit_batch_dist
+                                        : cdb.specs[c].batch_dist;
+        for (size_t i = 0; i < cand.size();) {
+            const size_t first = row_of(cand[i]);
+            size_t run = 1;
+            while (i + run < cand.size() &&
+                   row_of(cand[i + run]) == first + run)
+                run++;
+            batch(scan.queries[c].data(), feature_db_row(db, first), run,
+                  db.dim, &d[i]);
+            for (size_t j = 0; scan.unit[c] && j < run; j++) {
+                if (db.norms[first + j] == 0.0f)
+                    d[i + j] = 1e30f;
+            }
+            i += run;
+        }
+        for (size_t i = 0; i < cand.size(); i++)
+            sum[i] = (c == 0 ? 0.0f : sum[i]) + comp.weight * d[i];
+
+        if (scan.prune && c + 1 < c_end && top.full()) {
+            kept = 0;
+            for (size_t i = 0; i < cand.size(); i++) {
+                float bound = sum[i];
+                for (size_t k = c + 1; k < comps.size(); k++)
+                    bound = bound + comps[k].weight * comps[k].min_dist;
+                if (bound > top.worst())
+                    continue;
+                sum[kept] = sum[i];
+                cand[kept++] = cand[i];
+            }
+            cand.resize(kept);
+        }
+        stages[c].out += cand.size();
+    }
+
+    for (size_t i = 0; i < cand.size(); i++)
+        top.push(cand[i], sum[i]);
+}
+
+/*
+    scan_composite
+
+    Score base rows [begin, end) of a composite task through components
+    [0, c_end), a block at a time, skipping rows missing from any
+    component's database.
+
+    Arguments:
+        const CompositeScan &scan - query and task state.
+        size_t c_end - one past the last component to compute.
+        size_t begin - first base row to score.
+        size_t end - one past the last base row to score.
+        TopK &top - selector receiving the sums.
+        std::vector<StageCount> &stages - per-component counts, added to.
+
+    Returns:
+        void.
+*/
+static void scan_composite(const CompositeScan &scan, size_t c_end,
+                           size_t begin, size_t end, TopK &top,
+                           std::vector<StageCount> &stages) {
+    const CompositeDB &cdb = *scan.cdb;
+    std::vector<size_t> cand;
+    std::vector<float> sum(RANK_BLOCK);
+    std::vector<float> d(RANK_BLOCK);
+    cand.reserve(RANK_BLOCK);
+
+    for (size_t start = begin; start < end; start += RANK_BLOCK) {
+        const size_t n = std::min((size_t)RANK_BLOCK, end - start);
+
+        // rows present in every component's database
+        cand.clear();
+        for (size_t r = start; r < start + n; r++) {
+            bool present = r != scan.skip_row;
+            for (size_t c = 1; present && c < cdb.dbs.size(); c++)
+                present = cdb.rows[c][r] != NO_ROW;
+            if (present)
+                cand.push_back(r);
+        }
+        score_block(scan, 0, c_end, cand, sum, d, top, stages);
+    }
+}
+
+/*
+    scan_candidates
+
+    Finish scoring cascade candidates [begin, end) of `list` (rows
+    ascending, dist = sum over the first component) through the
+    remaining components, a block at a time.
+
+    Arguments:
+        const CompositeScan &scan - query and task state.
+        const std::vector<RowMatch> &list - candidates from the first
+            stage.
+        size_t begin - first candidate.
+        size_t end - one past the last candidate.
+        TopK &top - selector receiving the fused sums.
+        std::vector<StageCount> &stages - per-component counts, added to.
+
+    Returns:
+        void.
+*/
+static void scan_candidates(const CompositeScan &scan,
+                            const std::vector<RowMatch> &list, size_t begin,
+                            size_t end, TopK &top,
+                            std::vector<StageCount> &stages) {
+    std::vector<size_t> cand;
+    std::vector<float> sum(RANK_BLOCK);
+    std::vector<float> d(RANK_BLOCK);
+    cand.reserve(RANK_BLOCK);
+
+    for (size_t start = begin; start < end; start += RANK_BLOCK) {
+        const size_t n = std::min((size_t)RANK_BLOCK, end - start);
+        cand.clear();
+        for (size_t i = 0; i < n; i++) {
+            cand.push_back(list[start + i].row);
+            sum[i] = list[start + i].dist;
+        }
+        score_block(scan, 1, scan.spec->components.size(), cand, sum, d, top,
+                    stages);
+    }
+}
+
+/*
+    run_slices
+
+    Split [0, n) into contiguous slices of whole blocks, run `fn(begin,
+    end, top, stages)` on each slice with its own selector and counts
+    (on the calling thread when `threads` is 1), and merge the results.
+
+    Arguments:
+        size_t n - number of items.
+        size_t threads - slices to run in parallel.
+        const Fn &fn - slice scanner.
+        TopK &top - selector receiving the merged results.
+        std::vector<StageCount> &stages - per-component counts, added to.
+
+    Returns:
+        void.
+*/
+template <typename Fn>
+static void run_slices(size_t n, size_t threads, const Fn &fn, TopK &top,
+                       std::vector<StageCount> &stages) {
+    if (threads <= 1) {
+        fn(0, n, top, stages);
+        return;
+    }
+
+    const size_t blocks = (n + RANK_BLOCK - 1) / RANK_BLOCK;
+    std::vector<TopK> partial(threads, top);
+    std::vector<std::vector<StageCount>> counts(threads, stages);
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; t++) {
+        const size_t begin = std::min(n, blocks * t / threads * RANK_BLOCK);
+        const size_t end = std::min(n, blocks * (t + 1) / threads * RANK_BLOCK);
+        for (StageCount &sc : counts[t])
+            sc = StageCount();
+        pool.emplace_back([&, t, begin, end]() {
+            fn(begin, end, partial[t], counts[t]);
+        });
+    }
+    for (std::thread &th : pool)
+        th.join();
+
+    for (size_t t = 0; t < threads; t++) {
+        top.merge(partial[t]);
+        for (size_t c = 0; c < stages.size(); c++) {
+            stages[c].in += counts[t][c].in;
+            stages[c].scored += counts[t][c].scored;
+            stages[c].out += counts[t][c].out;
+        }
+    }
+}
+
+/*
+    rank_composite
+
+    Rank the base rows of a composite task by fused distance, splitting
+    the rows across threads as rank_database does. Components whose
+    database is normalized and whose task has a unit-vector distance are
+    scored by dot product against a normalized copy of their query.
+
+    With opt.cascade > 0 the ranking runs in two passes: the first
+    component scores every row and only its `cascade` best rows are
+    passed on to the remaining components (approximate; the exact pass
+    keeps every row that can still place).
+
+    Arguments:
+        const CompositeDB &cdb - the task's databases.
+        const std::vector<std::vector<float>> &queries - query feature per
+            component.
+        const TaskSpec &spec - composite task.
+        size_t skip_row - base row to leave out (e.g. the target), or
+            NO_ROW.
+        const RankOptions &opt - top-K, order, thread and cascade settings.
+        std::vector<RowMatch> &matches - output base rows, best first.
+        std::vector<StageCount> &stages - output counts per component.
+
+    Returns:
+        true on success, false if a query dimension does not match.
+*/
+bool rank_composite(const CompositeDB &cdb,
+                    const std::vector<std::vector<float>> &queries,
+                    const TaskSpec &spec, size_t skip_row,
+                    const RankOptions &opt, std::vector<RowMatch> &matches,
+                    std::vector<StageCount> &stages) {
+    matches.clear();
+    stages.assign(spec.components.size(), StageCount());
+    if (spec.components.empty() || cdb.dbs.size() != spec.components.size() ||
+        queries.size() != cdb.dbs.size())
+        return false;
+
+    CompositeScan scan;
+    scan.cdb = &cdb;
+    scan.spec = &spec;
+    scan.queries = queries;
+    scan.unit.assign(queries.size(), 0);
+    scan.skip_row = skip_row;
+    scan.prune = !opt.bottom && opt.top_k > 0;
+    for (size_t c = 0; c < queries.size(); c++) {
+        const FeatureDBView &db = *cdb.dbs[c];
+        if (queries[c].size() != db.dim)
+            return false;
+        if (db.normalized && cdb.specs[c].unit_batch_dist)
+            scan.unit[c] = normalize_l2(scan.queries[c].data(), db.dim) > 0.0f;
+        if (!scan.unit[c])
+            scan.queries[c] = queries[c];
+    }
+
+    const size_t rows = cdb.dbs[0]->rows;
+    size_t threads = opt.threads > 0
+                         ? (size_t)opt.threads
+                         : std::max(1u, std::thread::hardware_concurrency());
+    const auto threads_for = [&](size_t n) {
+        return std::max<size_t>(
+            1, std::min(threads, n / RANK_ROWS_PER_THREAD));
+    };
+    const size_t ncomp = spec.components.size();
+
+    TopK top(opt.top_k, opt.bottom);
+    if (opt.cascade == 0 || ncomp == 1) {
+        run_slices(
+            rows, threads_for(rows),
+            [&](size_t b, size_t e, TopK &t, std::vector<StageCount> &st) {
+                scan_composite(scan, ncomp, b, e, t, st);
+            },
+            top, stages);
+        top.sorted(matches);
+        return true;
+    }
+
+    // first stage: the cheap component picks the candidates
+    TopK first(opt.cascade, opt.bottom);
+    run_slices(
+        rows, threads_for(rows),
+        [&](size_t b, size_t e, TopK &t, std::vector<StageCount> &st) {
+            scan_composite(scan, 1, b, e, t, st);
+        },
+        first, stages);
+    std::vector<RowMatch> list;
+    first.sorted(list);
+    stages[0].out = list.size();
+    std::sort(list.begin(), list.end(),
+              [](const RowMatch &a, const RowMatch &b) {
+                  return a.row < b.row;
+              });
+
+    // later stages: survivors only
+    run_slices(
+        list.size(), threads_for(list.size()),
+        [&](size_t b, size_t e, TopK &t, std::vector<StageCount> &st) {
+            scan_candidates(scan, list, b, e, t, st);
+        },
+        top, stages);
+    top.sorted(matches);
+    return true;
+}
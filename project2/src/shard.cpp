@@ -0,0 +1,539 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - shard.cpp
+
+    This file implements sharded feature databases: splitting a database
+    into shard files with a text manifest, opening the shards together,
+    and scatter-gather ranking that merges the per-shard top-K.
+*/
+
+#include "../include/shard.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "../include/topk.h"
+
+/*
+    manifest_dir
+
+    Directory part of a manifest path, with a trailing '/', or "" for a
+    bare filename. Shard entries are resolved against it.
+
+    Arguments:
+        const std::string &path - manifest path.
+
+    Returns:
+        directory prefix.
+*/
+static std::string manifest_dir(const std::string &path) {
+    const size_t pos = path.find_last_of('/');
+    return pos == std::string::npos ? std::string() : path.substr(0, pos + 1);
+}
+
+/*
+    shard_of_name
+
+    Shard a filename belongs to under hash sharding (64-bit FNV-1a).
+
+    Arguments:
+        std::string_view name - row filename.
+        size_t shards - number of shards (> 0).
+
+    Returns:
+        shard index in [0, shards).
+*/
+size_t shard_of_name(std::string_view name, size_t shards) {
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : name)
+        h = (h ^ (unsigned char)c) * 1099511628211ULL;
+    return (size_t)(h % shards);
+}
+
+/*
+    split_feature_db
+
+    Partition the rows of a database into `n` shards by filename hash or
+    into contiguous runs of equal size, keeping row order in each shard.
+
+    Arguments:
+        const FeatureDB &db - database to split.
+        size_t n - number of shards (> 0).
+        bool by_hash - hash sharding instead of count sharding.
+        std::vector<FeatureDB> &shards - output shards.
+
+    Returns:
+        void.
+*/
+void split_feature_db(const FeatureDB &db, size_t n, bool by_hash,
+                      std::vector<FeatureDB> &shards) {
+    shards.assign(n, FeatureDB());
+    for (FeatureDB &s : shards) {
+        s.task_id = db.task_id;
+        s.dim = db.dim;
+        s.decode_scale = db.decode_scale;
+    }
+    const bool has_stamps = db.stamps.size() == db.rows && db.rows > 0;
+    for (size_t r = 0; r < db.rows; r++) {
+        const std::string_view name = feature_db_name(db, r);
+        const size_t s = by_hash ? shard_of_name(name, n) : r * n / db.rows;
+        feature_db_append_row(shards[s], name, feature_db_row(db, r), db.dim,
+                              has_stamps ? &db.stamps[r] : nullptr);
+        // rows are already unit length; carry their original norms over
+        if (db.normalized)
+            shards[s].norms.push_back(db.norms[r]);
+    }
+    for (FeatureDB &s : shards)
+        s.normalized = db.normalized;
+}
+
+/*
+    write_sharded_db
+
+    Split a database into `n` binary shard files named <path>.shard<i>
+    and write the manifest to `path`. Every file is written to a
+    temporary first; the old files are replaced only once all of them
+    are written, the manifest last. On failure the temporaries are
+    removed.
+
+    Arguments:
+        const std::string &path - manifest path.
+        const FeatureDB &db - database to write.
+        size_t n - number of shards (> 0).
+        bool by_hash - hash sharding instead of count sharding.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool write_sharded_db(const std::string &path, const FeatureDB &db, size_t n,
+                      bool by_hash) {
+    if (n == 0)
+        return false;
+    std::vector<FeatureDB> shards;
+    split_feature_db(db, n, by_hash, shards);
+
+    std::ostringstream manifest;
+    manifest << SHARD_MAGIC << " " << SHARD_VERSION << "\n"
+             << "task " << db.task_id << "\n"
+             << "dim " << db.dim << "\n"
+             << "by " << (by_hash ? "hash" : "count") << "\n"
+             << "shards " << n << "\n";
+    const std::string dir = manifest_dir(path);
+    std::vector<std::string> shard_paths, tmp_paths;
+    for (size_t s = 0; s < n; s++) {
+        shard_paths.push_back(path + ".shard" + std::to_string(s));
+        tmp_paths.push_back(shard_paths.back() + ".tmp");
+        manifest << shard_paths.back().substr(dir.size()) << "\n";
+    }
+    tmp_paths.push_back(path + ".tmp");
+
+    // write everything before replacing anything, so a failed write
+    // leaves the old shards and manifest as they were
+    auto remove_temps = [&tmp_paths]() {
+        for (const std::string &t : tmp_paths)
+            std::remove(t.c_str());
+    };
+    for (size_t s = 0; s < n; s++) {
+        if (!write_feature_db(tmp_paths[s], shards[s])) {
+            remove_temps();
+            return false;
+        }
+    }
+    std::ofstream out(tmp_paths[n], std::ios::trunc);
+    out << manifest.str();
+    out.close();
+    if (!out.good()) {
+        remove_temps();
+        return false;
+    }
+
+    // shards first, the manifest that lists them last
+    for (size_t s = 0; s < n; s++) {
+        if (std::rename(tmp_paths[s].c_str(), shard_paths[s].c_str()) != 0) {
+            remove_temps();
+            return false;
+        }
+    }
+    if (std::rename(tmp_paths[n].c_str(), path.c_str()) != 0) {
+        remove_temps();
+        return false;
+    }
+    // the manifest no longer lists shards from an earlier, larger split
+    remove_stale_shards(path, n);
+    return true;
+}
+
+/*
+    remove_stale_shards
+
+    Delete <path>.shard<i> for i = keep, keep + 1, ... up to the first
+    index with no file. Shards are always numbered from 0 without gaps.
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        size_t keep - number of shards still in use.
+
+    Returns:
+        void.
+*/
+void remove_stale_shards(const std::string &path, size_t keep) {
+    for (size_t s = keep;; s++) {
+        const std::string shard_path = path + ".shard" + std::to_string(s);
+        if (std::remove(shard_path.c_str()) != 0)
+            break;
+    }
+}
+
+/*
+    is_shard_manifest
+
+    Check whether a file starts with SHARD_MAGIC.
+
+    Arguments:
+        const std::string &path - file path.
+
+    Returns:
+        true for shard manifests.
+*/
+bool is_shard_manifest(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(SHARD_MAGIC) - 1];
+    return in.read(magic, sizeof(magic)) &&
+           std::memcmp(magic, SHARD_MAGIC, sizeof(magic)) == 0;
+}
+
+/*
+    read_manifest_paths
+
+    Parse a shard manifest into its task, dimension and shard file paths.
+
+    Arguments:
+        const std::string &path - manifest path.
+        int &task_id - output task id.
+        size_t &dim - output feature dimension.
+        std::string &by - output sharding mode.
+        std::vector<std::string> &paths - output shard paths, resolved
+            against the manifest's directory.
+
+    Returns:
+        true on success, false if the manifest is malformed.
+*/
+static bool read_manifest_paths(const std::string &path, int &task_id,
+                                size_t &dim, std::string &by,
+                                std::vector<std::string> &paths) {
+    std::ifstream in(path);
+    std::string magic, key;
+    int version = 0;
+    size_t n = 0;
+    if (!(in >> magic >> version) || magic != SHARD_MAGIC ||
+        version != SHARD_VERSION)
+        return false;
+    if (!(in >> key >> task_id) || key != "task" || !(in >> key >> dim) ||
+        key != "dim" || !(in >> key >> by) || key != "by" ||
+        !(in >> key >> n) || key != "shards" || n == 0)
+        return false;
+
+    const std::string dir = manifest_dir(path);
+    paths.clear();
+    std::string line;
+    std::getline(in, line); // rest of the "shards" line
+    while (paths.size() < n && std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        paths.push_back(line[0] == '/' ? line : dir + line);
+    }
+    return paths.size() == n;
+}
+
+/*
+    open_sharded_db
+
+    Map every shard of a manifest, or a plain database as one shard, and
+    check that every shard's header matches the manifest's task and
+    dimension, and that the shards share a decode scale.
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        ShardedDB &db - output database.
+
+    Returns:
+        true on success, false if a file cannot be read or the shards
+        disagree.
+*/
+bool open_sharded_db(const std::string &path, ShardedDB &db) {
+    std::vector<std::string> paths;
+    const bool manifest = is_shard_manifest(path);
+    int task_id = 0;
+    size_t dim = 0;
+    db.by.clear();
+    if (manifest) {
+        if (!read_manifest_paths(path, task_id, dim, db.by, paths)) {
+            std::fprintf(stderr, "Malformed shard manifest %s\n",
+                         path.c_str());
+            return false;
+        }
+    } else {
+        paths.push_back(path);
+    }
+
+    db.shards.clear();
+    db.offsets.assign(1, 0);
+    for (const std::string &p : paths) {
+        auto shard = std::make_unique<MappedFeatureDB>();
+        if (!map_feature_db(p, *shard)) {
+            std::fprintf(stderr, "Cannot load shard %s\n", p.c_str());
+            return false;
+        }
+        const FeatureDBView &v = shard->view;
+        // an empty shard may not know its dimension
+        if (manifest && (v.task_id != task_id ||
+                         (v.dim != dim && (v.rows > 0 || v.dim != 0)))) {
+            std::fprintf(stderr,
+                         "Shard %s holds task %d, %zu dims; manifest %s "
+                         "lists task %d, %zu dims\n",
+                         p.c_str(), v.task_id, v.dim, path.c_str(), task_id,
+                         dim);
+            return false;
+        }
+        if (db.shards.empty()) {
+            db.task_id = v.task_id;
+            db.dim = v.dim;
+            db.decode_scale = v.decode_scale;
+        } else if (v.task_id != db.task_id ||
+                   (v.rows > 0 && db.dim > 0 && v.dim != db.dim) ||
+                   v.decode_scale != db.decode_scale) {
+            std::fprintf(stderr, "Shard %s does not match the others\n",
+                         p.c_str());
+            return false;
+        }
+        // an empty shard has no dimension yet
+        if (db.dim == 0)
+            db.dim = v.dim;
+        db.offsets.push_back(db.offsets.back() + v.rows);
+        db.shards.push_back(std::move(shard));
+    }
+    db.rows = db.offsets.back();
+    if (manifest)
+        db.dim = dim;
+    return true;
+}
+
+/*
+    read_sharded_db
+
+    Read every row of a manifest's shards, or of a plain database, into
+    one in-memory database.
+
+    Arguments:
+        const std::string &path - manifest or database path.
+        FeatureDB &db - output database.
+
+    Returns:
+        true on success, false on failure.
+*/
+bool read_sharded_db(const std::string &path, FeatureDB &db) {
+    if (!is_shard_manifest(path))
+        return load_feature_db(path, db);
+
+    ShardedDB sharded;
+    if (!open_sharded_db(path, sharded))
+        return false;
+    db = FeatureDB();
+    db.task_id = sharded.task_id;
+    db.dim = sharded.dim;
+    db.decode_scale = sharded.decode_scale;
+    bool normalized = true;
+    for (const auto &shard : sharded.shards) {
+        const FeatureDBView &v = shard->view;
+        normalized = normalized && v.normalized;
+        for (size_t r = 0; r < v.rows; r++)
+            feature_db_append_row(db, feature_db_name(v, r),
+                                  feature_db_row(v, r), v.dim,
+                                  v.stamps ? &v.stamps[r] : nullptr);
+    }
+    // rows were copied as stored; keep the norms if every shard had them
+    if (normalized && db.rows > 0) {
+        for (const auto &shard : sharded.shards)
+            db.norms.insert(db.norms.end(), shard->view.norms,
+                            shard->view.norms + shard->view.rows);
+        db.normalized = true;
+    }
+    return true;
+}
+
+/*
+    shard_of_row
+
+    Shard holding a global row index.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+        size_t row - global row index (< db.rows).
+
+    Returns:
+        shard index.
+*/
+static size_t shard_of_row(const ShardedDB &db, size_t row) {
+    return std::upper_bound(db.offsets.begin(), db.offsets.end(), row) -
+           db.offsets.begin() - 1;
+}
+
+/*
+    sharded_db_name
+
+    Return the filename of a global row.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+        size_t row - global row index.
+
+    Returns:
+        view of the name (valid while db is open).
+*/
+std::string_view sharded_db_name(const ShardedDB &db, size_t row) {
+    const size_t s = shard_of_row(db, row);
+    return feature_db_name(db.shards[s]->view, row - db.offsets[s]);
+}
+
+/*
+    sharded_db_row
+
+    Return a pointer to the features of a global row.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+        size_t row - global row index.
+
+    Returns:
+        pointer to db.dim floats.
+*/
+const float *sharded_db_row(const ShardedDB &db, size_t row) {
+    const size_t s = shard_of_row(db, row);
+    return feature_db_row(db.shards[s]->view, row - db.offsets[s]);
+}
+
+/*
+    sharded_db_find
+
+    Find the global row of a filename. Under hash sharding only the
+    name's shard is searched.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+        std::string_view name - filename to look up.
+        size_t &row - output global row index.
+
+    Returns:
+        true if found.
+*/
+bool sharded_db_find(const ShardedDB &db, std::string_view name,
+                     size_t &row) {
+    const size_t n = db.shards.size();
+    const bool hashed = db.by == "hash";
+    for (size_t s = hashed ? shard_of_name(name, n) : 0; s < n; s++) {
+        size_t r;
+        if (feature_db_find(db.shards[s]->view, name, r)) {
+            row = db.offsets[s] + r;
+            return true;
+        }
+        if (hashed)
+            break;
+    }
+    return false;
+}
+
+/*
+    default_shard_threads
+
+    Threads to rank with when none are requested: one per shard, capped
+    at the hardware threads, so shards are scanned side by side.
+
+    Arguments:
+        const ShardedDB &db - sharded database.
+
+    Returns:
+        thread count (1 for an unsharded database).
+*/
+int default_shard_threads(const ShardedDB &db) {
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    return (int)std::min(db.shards.size(), hw);
+}
+
+/*
+    rank_sharded
+
+    Scatter-gather ranking: rank every shard with rank_database, up to
+    opt.threads shards at a time, and merge the per-shard top-K by
+    global row index.
+
+    Arguments:
+        const ShardedDB &db - database to scan.
+        const std::vector<float> &query - query feature (db.dim values).
+        const TaskSpec &spec - task distance functions.
+        size_t skip_row - global row to leave out, or NO_ROW.
+        const RankOptions &opt - top-K, order and thread settings.
+        std::vector<RowMatch> &matches - output matches, best first.
+
+    Returns:
+        true on success, false if the query dimension does not match.
+*/
+bool rank_sharded(const ShardedDB &db, const std::vector<float> &query,
+                  const TaskSpec &spec, size_t skip_row,
+                  const RankOptions &opt, std::vector<RowMatch> &matches) {
+    matches.clear();
+    if (query.size() != db.dim)
+        return false;
+    const size_t n = db.shards.size();
+    if (n == 1)
+        return rank_database(db.shards[0]->view, query, spec, skip_row, opt,
+                             matches);
+
+    const size_t threads =
+        opt.threads > 0 ? (size_t)opt.threads
+                        : std::max(1u, std::thread::hardware_concurrency());
+    // shards run side by side; leftover threads split each shard's scan
+    RankOptions shard_opt = opt;
+    shard_opt.threads = (int)std::max<size_t>(1, threads / n);
+
+    std::vector<std::vector<RowMatch>> partial(n);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    auto worker = [&]() {
+        size_t s;
+        while ((s = next.fetch_add(1)) < n) {
+            const FeatureDBView &v = db.shards[s]->view;
+            if (v.rows == 0)
+                continue;
+            const size_t off = db.offsets[s];
+            const size_t skip = skip_row != NO_ROW && skip_row >= off &&
+                                        skip_row < off + v.rows
+                                    ? skip_row - off
+                                    : NO_ROW;
+            if (!rank_database(v, query, spec, skip, shard_opt, partial[s]))
+                ok = false;
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min(threads, n); t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread &th : pool)
+        th.join();
+    if (!ok)
+        return false;
+
+    TopK top(opt.top_k, opt.bottom);
+    for (size_t s = 0; s < n; s++)
+        for (const RowMatch &m : partial[s])
+            top.push(db.offsets[s] + m.row, m.dist);
+    top.sorted(matches);
+    return true;
+}
@@ -18,7 +18,8 @@
 /*
     get_task
 
-    Return the TaskSpec (feature + distance) for a given task id.
+    Return the TaskSpec (feature + distance + batch distance, and the
+    fused sources of a composite task) for a given task id.
 
     Arguments:
         int task_id - task identifier.
@@ -32,20 +33,55 @@
 TaskSpec get_task(int task_id) {
     switch (task_id) {
     case 1:
-        return {compute_task1_feature, ssd_distance};
+        // the 7x7 center patch is raw pixels, so it needs full resolution
+        return {compute_task1_feature, ssd_distance, ssd_distance_batch,
+                nullptr, ssd_distance_bounded_batch, 1, {}};
     case 2:
-        return {compute_task2_feature, hist_intersection_distance};
+        // color histograms barely move when the image is shrunk
+        return {compute_task2_feature, hist_intersection_distance,
+                hist_intersection_distance_batch, nullptr,
+                hist_intersection_distance_bounded_batch, 4, {}};
     case 3:
         return {compute_task3_feature,
                 [](const std::vector<float> &a, const std::vector<float> &b) {
                     return task3_multi_hist_distance(a, b, 0.5f, 0.5f);
-                }};
+                },
+                [](const float *query, const float *rows, size_t n,
+                   size_t dim, float *out) {
+                    task3_multi_hist_distance_batch(query, rows, n, dim, 0.5f,
+                                                    0.5f, out);
+                },
+                nullptr, nullptr, 4, {}};
 
     case 4:
         return {compute_task4_feature,
                 [](const std::vector<float> &a, const std::vector<float> &b) {
                     return task4_distance(a, b);
-                }};
+                },
+                // Sobel responses depend on scale, so shrink only 2x
+                task4_distance_batch, nullptr, nullptr, 2, {}};
+
+    case 5:
+        // DNN embeddings are precomputed externally; no image feature
+        return {nullptr, cosine_distance, cosine_distance_batch,
+                cosine_unit_distance_batch, nullptr, 1, {}};
+
+    case 7:
+        // stored feature: grass statistics; ranking fuses 60% grass
+        // distance (cheap, 5 values, skips images with < 5% green) with
+        // 40% Task 5 embedding distance. The grass mask uses fixed-size
+        // morphology, so the image is decoded at full resolution.
+        return {extract_grass_features,
+                grass_distance,
+                grass_distance_batch,
+                nullptr,
+                nullptr,
+                1,
+                {{7, 5, 0.6f, 0.0f,
+                  [](const float *row, size_t) { return row[0] >= 0.05; }},
+                 // 512-value embeddings only; rounding can leave cosine
+                 // distance slightly below 0
+                 {5, 512, 0.4f, -1e-3f, nullptr}}};
     default:
         throw std::invalid_argument("Unknown task id: " +
                                     std::to_string(task_id));
@@ -0,0 +1,101 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - topk.cpp
+
+    This file implements the bounded top-K selector.
+*/
+
+#include "../include/topk.h"
+
+#include <algorithm>
+
+/*
+    TopK
+
+    Create an empty selector.
+
+    Arguments:
+        size_t k - number of matches to keep (0 keeps every match).
+        bool bottom - keep the largest distances instead of the smallest.
+*/
+TopK::TopK(size_t k, bool bottom) : k_(k), bottom_(bottom) {
+    if (k_ != 0)
+        heap_.reserve(k_);
+}
+
+/*
+    insert
+
+    Add a match while the heap still has room.
+
+    Arguments:
+        const RowMatch &m - match to add.
+
+    Returns:
+        void.
+*/
+void TopK::insert(const RowMatch &m) {
+    const auto cmp = [this](const RowMatch &a, const RowMatch &b) {
+        return better(a, b);
+    };
+    heap_.push_back(m);
+    if (k_ != 0)
+        std::push_heap(heap_.begin(), heap_.end(), cmp);
+}
+
+/*
+    replace_worst
+
+    Drop the worst kept match in favour of a better one.
+
+    Arguments:
+        const RowMatch &m - match to add (must beat the current worst).
+
+    Returns:
+        void.
+*/
+void TopK::replace_worst(const RowMatch &m) {
+    const auto cmp = [this](const RowMatch &a, const RowMatch &b) {
+        return better(a, b);
+    };
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    heap_.back() = m;
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+}
+
+/*
+    merge
+
+    Offer every match kept by another selector.
+
+    Arguments:
+        const TopK &other - selector to merge in.
+
+    Returns:
+        void.
+*/
+void TopK::merge(const TopK &other) {
+    for (const RowMatch &m : other.heap_)
+        push(m.row, m.dist);
+}
+
+/*
+    sorted
+
+    Return the kept matches, best first.
+
+    Arguments:
+        std::vector<RowMatch> &out - output matches.
+
+    Returns:
+        void.
+*/
+void TopK::sorted(std::vector<RowMatch> &out) const {
+    out = heap_;
+    std::sort(out.begin(), out.end(),
+              [this](const RowMatch &a, const RowMatch &b) {
+                  return better(a, b);
+              });
+}
@@ -10,6 +10,7 @@
 #include "../include/utils.h"
 
 #include <cstring>
+#include <filesystem>
 
 /*
     basename_only
@@ -27,3 +28,31 @@ std::string basename_only(const std::string &path) {
     const char *p = std::strrchr(s, '/');
     return p ? std::string(p + 1) : path;
 }
+
+/*
+    image_row_name
+
+    Resolve an image path against the directory a database was built
+    from. Both paths are made absolute and normalized lexically, so
+    "./imgs/a.jpg" and "imgs/" agree without touching the filesystem.
+
+    Arguments:
+        const std::string &path - image path.
+        const std::string &image_dir - build directory, or "" if unknown.
+
+    Returns:
+        path relative to image_dir if inside it, else the basename.
+*/
+std::string image_row_name(const std::string &path,
+                           const std::string &image_dir) {
+    namespace fs = std::filesystem;
+    if (!image_dir.empty()) {
+        std::error_code ec;
+        const fs::path dir = fs::absolute(image_dir, ec).lexically_normal();
+        const fs::path file = fs::absolute(path, ec).lexically_normal();
+        const fs::path rel = file.lexically_relative(dir);
+        if (!ec && !rel.empty() && rel != "." && *rel.begin() != "..")
+            return rel.generic_string();
+    }
+    return basename_only(path);
+}
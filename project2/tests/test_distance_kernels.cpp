@@ -0,0 +1,351 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - test_distance_kernels.cpp
+
+    This file checks the distance kernels against double-precision
+    reference loops. ctest runs it once per CBIR_SIMD level (and once
+    unset), so each ISA's variants, tails and masks are exercised on
+    lengths that are not a multiple of any vector width.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../include/distance_kernels.h"
+
+// vector lengths: a lone value, short tails, one past a check block, and a
+// multi-block length with a tail (Task 3 uses 2 x 8^3 = 1024, Task 4 290)
+static const size_t LENGTHS[] = {1, 7, 63, 65, 290, 1027};
+
+// rows per batch: odd, so the 2 x 2 tile kernels also hit their edges
+#define ROWS 5
+
+// relative tolerance against the reference, scaled by the sum of |terms|
+#define TOLERANCE 1e-5
+
+static int failures = 0;
+
+/*
+    check_close
+
+    Compare a kernel result with its double reference and report a
+    mismatch larger than TOLERANCE times `scale`.
+
+    Arguments:
+        const char *what - kernel name for the report.
+        size_t len - vector length.
+        double got - kernel result.
+        double want - reference result.
+        double scale - sum of the absolute values of the terms.
+
+    Returns:
+        void.
+*/
+static void check_close(const char *what, size_t len, double got,
+                        double want, double scale) {
+    if (std::fabs(got - want) <= TOLERANCE * (scale + 1e-30))
+        return;
+    std::fprintf(stderr, "FAIL %s len %zu: got %.9g, want %.9g\n", what, len,
+                 got, want);
+    failures++;
+}
+
+/*
+    check_equal
+
+    Require two results to be bit-identical.
+
+    Arguments:
+        const char *what - kernel name for the report.
+        size_t len - vector length.
+        double got - result under test.
+        double want - expected result.
+
+    Returns:
+        void.
+*/
+static void check_equal(const char *what, size_t len, double got,
+                        double want) {
+    if (got == want)
+        return;
+    std::fprintf(stderr, "FAIL %s len %zu: got %.9g, expected exactly %.9g\n",
+                 what, len, got, want);
+    failures++;
+}
+
+/*
+    reference_ssd / reference_min_sum / reference_dot
+
+    Double-precision reference loops; `scale` receives the sum of the
+    absolute values of the terms.
+*/
+static double reference_ssd(const float *a, const float *b, size_t n,
+                            double &scale) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const double d = (double)a[i] - b[i];
+        s += d * d;
+    }
+    scale = s;
+    return s;
+}
+
+static double reference_min_sum(const float *a, const float *b, size_t n,
+                                double &scale) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; i++)
+        s += a[i] < b[i] ? a[i] : b[i];
+    scale = s;
+    return s;
+}
+
+static double reference_dot(const float *a, const float *b, size_t n,
+                            double &scale) {
+    double s = 0.0;
+    scale = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        s += (double)a[i] * b[i];
+        scale += std::fabs((double)a[i] * b[i]);
+    }
+    return s;
+}
+
+/*
+    test_float_kernels
+
+    Single-pair, batch, tile and dot-norm kernels on random signed data
+    (SSD, dot) and non-negative histograms (intersection).
+
+    Arguments:
+        size_t len - vector length.
+        std::mt19937 &rng - random source.
+
+    Returns:
+        void.
+*/
+static void test_float_kernels(size_t len, std::mt19937 &rng) {
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> q(len), rows(ROWS * len), hq(len), hrows(ROWS * len);
+    for (float &v : q)
+        v = normal(rng);
+    for (float &v : rows)
+        v = normal(rng);
+    for (float &v : hq)
+        v = uniform(rng) / (float)len;
+    for (float &v : hrows)
+        v = uniform(rng) / (float)len;
+
+    float ssd[ROWS], mins[ROWS], dots[ROWS], ndots[ROWS], nr[ROWS];
+    float tile[2 * ROWS], nq = 0.0f;
+    kernel_ssd_batch(q.data(), rows.data(), ROWS, len, len, ssd);
+    kernel_min_sum_batch(hq.data(), hrows.data(), ROWS, len, len, mins);
+    kernel_dot_batch(q.data(), rows.data(), ROWS, len, len, dots);
+    kernel_dot_norms_batch(q.data(), rows.data(), ROWS, len, len, ndots, nq,
+                           nr);
+    // queries are the first two rows, so the tile covers a 2 x 2 block and
+    // an odd edge column
+    kernel_dot_tile(rows.data(), 2, len, rows.data(), ROWS, len, len, tile,
+                    ROWS);
+
+    double scale;
+    for (size_t r = 0; r < ROWS; r++) {
+        const float *row = rows.data() + r * len;
+        const float *hrow = hrows.data() + r * len;
+
+        const double want_ssd = reference_ssd(q.data(), row, len, scale);
+        check_close("kernel_ssd", len, kernel_ssd(q.data(), row, len),
+                    want_ssd, scale);
+        check_equal("kernel_ssd_batch", len, ssd[r],
+                    kernel_ssd(q.data(), row, len));
+
+        const double want_min =
+            reference_min_sum(hq.data(), hrow, len, scale);
+        check_close("kernel_min_sum", len,
+                    kernel_min_sum(hq.data(), hrow, len), want_min, scale);
+        check_equal("kernel_min_sum_batch", len, mins[r],
+                    kernel_min_sum(hq.data(), hrow, len));
+
+        const double want_dot = reference_dot(q.data(), row, len, scale);
+        check_close("kernel_dot", len, kernel_dot(q.data(), row, len),
+                    want_dot, scale);
+        check_equal("kernel_dot_batch", len, dots[r],
+                    kernel_dot(q.data(), row, len));
+        check_close("kernel_dot_norms_batch", len, ndots[r], want_dot,
+                    scale);
+        const double want_nr = reference_dot(row, row, len, scale);
+        check_close("kernel_dot_norms_batch (row norm)", len, nr[r], want_nr,
+                    scale);
+
+        for (size_t i = 0; i < 2; i++)
+            check_equal("kernel_dot_tile", len, tile[i * ROWS + r],
+                        kernel_dot(rows.data() + i * len, row, len));
+    }
+    const double want_nq = reference_dot(q.data(), q.data(), len, scale);
+    check_close("kernel_dot_norms_batch (query norm)", len, nq, want_nq,
+                scale);
+
+    float dot, na, nb;
+    kernel_dot_norms(q.data(), rows.data(), len, dot, na, nb);
+    check_close("kernel_dot_norms", len, dot,
+                reference_dot(q.data(), rows.data(), len, scale), scale);
+}
+
+/*
+    test_bounded_kernels
+
+    Early-abandoning kernels: with no limit they must match the unbounded
+    batch exactly; with a limit, every row either matches exactly or
+    stopped with a value past the limit that its true value is past too.
+
+    Arguments:
+        size_t len - vector length.
+        std::mt19937 &rng - random source.
+
+    Returns:
+        void.
+*/
+static void test_bounded_kernels(size_t len, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> q(len), rows(ROWS * len);
+    for (float &v : q)
+        v = uniform(rng) / (float)len;
+    for (float &v : rows)
+        v = uniform(rng) / (float)len;
+
+    float ssd[ROWS], mins[ROWS], out[ROWS];
+    kernel_ssd_batch(q.data(), rows.data(), ROWS, len, len, ssd);
+    kernel_min_sum_batch(q.data(), rows.data(), ROWS, len, len, mins);
+
+    kernel_ssd_bounded_batch(q.data(), rows.data(), ROWS, len, len, INFINITY,
+                             out);
+    for (size_t r = 0; r < ROWS; r++)
+        check_equal("kernel_ssd_bounded_batch (no bound)", len, out[r],
+                    ssd[r]);
+    kernel_min_sum_bounded_batch(q.data(), rows.data(), ROWS, len, len,
+                                 -INFINITY, out);
+    for (size_t r = 0; r < ROWS; r++)
+        check_equal("kernel_min_sum_bounded_batch (no floor)", len, out[r],
+                    mins[r]);
+
+    // limits near the smallest / largest row so some rows stop and some
+    // run to the end
+    float bound = ssd[0], floor = mins[0];
+    for (size_t r = 1; r < ROWS; r++) {
+        bound = std::fmin(bound, ssd[r]);
+        floor = std::fmax(floor, mins[r]);
+    }
+    for (double f : {0.25, 1.0, 1.5}) {
+        kernel_ssd_bounded_batch(q.data(), rows.data(), ROWS, len, len,
+                                 (float)(bound * f), out);
+        for (size_t r = 0; r < ROWS; r++)
+            if (out[r] != ssd[r] &&
+                !(out[r] > bound * f && ssd[r] > bound * f)) {
+                std::fprintf(stderr,
+                             "FAIL kernel_ssd_bounded_batch len %zu: row %zu "
+                             "stopped at %.9g, exact %.9g, bound %.9g\n",
+                             len, r, out[r], ssd[r], bound * f);
+                failures++;
+            }
+        kernel_min_sum_bounded_batch(q.data(), rows.data(), ROWS, len, len,
+                                     (float)(floor / f), out);
+        for (size_t r = 0; r < ROWS; r++)
+            if (out[r] != mins[r] &&
+                !(out[r] < floor / f && mins[r] < floor / f)) {
+                std::fprintf(stderr,
+                             "FAIL kernel_min_sum_bounded_batch len %zu: row "
+                             "%zu stopped at %.9g, exact %.9g, floor %.9g\n",
+                             len, r, out[r], mins[r], floor / f);
+                failures++;
+            }
+    }
+}
+
+/*
+    test_integer_kernels
+
+    Quantized intersection kernels must equal the integer reference sum.
+
+    Arguments:
+        size_t len - vector length.
+        std::mt19937 &rng - random source.
+
+    Returns:
+        void.
+*/
+static void test_integer_kernels(size_t len, std::mt19937 &rng) {
+    std::uniform_int_distribution<int> byte(0, 255), word(0, 32767);
+    std::vector<uint8_t> q8(len), r8(ROWS * len);
+    std::vector<uint16_t> q16(len), r16(ROWS * len);
+    for (uint8_t &v : q8)
+        v = (uint8_t)byte(rng);
+    for (uint8_t &v : r8)
+        v = (uint8_t)byte(rng);
+    for (uint16_t &v : q16)
+        v = (uint16_t)word(rng);
+    for (uint16_t &v : r16)
+        v = (uint16_t)word(rng);
+
+    uint32_t out8[ROWS], out16[ROWS];
+    kernel_min_sum_u8_batch(q8.data(), r8.data(), ROWS, len, len, out8);
+    kernel_min_sum_u16_batch(q16.data(), r16.data(), ROWS, len, len, out16);
+    for (size_t r = 0; r < ROWS; r++) {
+        uint32_t want8 = 0, want16 = 0;
+        for (size_t i = 0; i < len; i++) {
+            want8 += std::min(q8[i], r8[r * len + i]);
+            want16 += std::min(q16[i], r16[r * len + i]);
+        }
+        check_equal("kernel_min_sum_u8_batch", len, out8[r], want8);
+        check_equal("kernel_min_sum_u16_batch", len, out16[r], want16);
+    }
+}
+
+/*
+    main
+
+    Run every check at every length and report the ISA under test.
+
+    Returns:
+        0 if every kernel agrees, 1 otherwise.
+*/
+int main() {
+    const char *env = std::getenv("CBIR_SIMD");
+    const char *isa = distance_kernel_isa();
+    std::printf("CBIR_SIMD=%s -> %s kernels\n", env ? env : "(unset)", isa);
+
+    // a forced level caps the dispatch; the CPU may support less
+    static const char *levels[] = {"scalar", "sse", "avx2", "avx512"};
+    int cap = 3, got = -1;
+    for (int l = 0; l < 4; l++) {
+        if (env && std::strcmp(env, levels[l]) == 0)
+            cap = l;
+        if (std::strcmp(isa, levels[l]) == 0)
+            got = l;
+    }
+    if (got < 0 || got > cap) {
+        std::fprintf(stderr, "FAIL dispatch picked %s above CBIR_SIMD=%s\n",
+                     isa, env ? env : "(unset)");
+        failures++;
+    }
+
+    std::mt19937 rng(5330);
+    for (size_t len : LENGTHS) {
+        test_float_kernels(len, rng);
+        test_bounded_kernels(len, rng);
+        test_integer_kernels(len, rng);
+    }
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("all kernels agree\n");
+    return 0;
+}
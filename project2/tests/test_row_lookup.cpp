@@ -0,0 +1,152 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - test_row_lookup.cpp
+
+    This file checks how query targets are matched to database rows. A
+    --recursive build names rows by their path under the image directory,
+    so a target inside it must find its row by that path (and be left out
+    of its own results), while flat databases keep matching by filename.
+    The lookup is checked on a plain database and a hash-sharded one.
+*/
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "../include/feature_db.h"
+#include "../include/shard.h"
+#include "../include/utils.h"
+
+static int failures = 0;
+
+/*
+    check_row
+
+    Resolve a target path against an image directory and compare the row
+    it finds with the expected row name.
+
+    Arguments:
+        const ShardedDB &db - database to search.
+        const std::string &target - target image path.
+        const std::string &image_dir - directory the database was built from.
+        const char *want - expected row name, or nullptr for no match.
+
+    Returns:
+        void.
+*/
+static void check_row(const ShardedDB &db, const std::string &target,
+                      const std::string &image_dir, const char *want) {
+    size_t row = NO_ROW;
+    const bool found =
+        sharded_db_find(db, image_row_name(target, image_dir), row);
+    const std::string got =
+        found ? std::string(sharded_db_name(db, row)) : "(none)";
+    if (want ? (found && got == want) : !found)
+        return;
+    std::fprintf(stderr, "FAIL %s in %s: got %s, want %s\n", target.c_str(),
+                 image_dir.c_str(), got.c_str(), want ? want : "(none)");
+    failures++;
+}
+
+/*
+    check_database
+
+    Run every lookup case against one database built from /data/imgs.
+
+    Arguments:
+        const ShardedDB &db - database to search.
+        bool recursive - rows carry subdirectory paths.
+
+    Returns:
+        void.
+*/
+static void check_database(const ShardedDB &db, bool recursive) {
+    if (recursive) {
+        // nested targets match their own row, not a same-named file
+        check_row(db, "/data/imgs/sub/x.jpg", "/data/imgs", "sub/x.jpg");
+        check_row(db, "/data/imgs/sub/deep/y.jpg", "/data/imgs/",
+                  "sub/deep/y.jpg");
+        check_row(db, "/data/imgs/./sub/../sub/x.jpg", "/data/imgs",
+                  "sub/x.jpg");
+        check_row(db, "/data/imgs/sub/missing.jpg", "/data/imgs", nullptr);
+    }
+    // top-level targets and targets outside image_dir match by filename
+    check_row(db, "/data/imgs/x.jpg", "/data/imgs", "x.jpg");
+    check_row(db, "/elsewhere/x.jpg", "/data/imgs", "x.jpg");
+    check_row(db, "/elsewhere/y.jpg", "/data/imgs", recursive ? nullptr
+                                                              : "y.jpg");
+}
+
+/*
+    build_database
+
+    Write a small database with the given row names and open it.
+
+    Arguments:
+        const std::string &path - output path (a manifest if shards > 1).
+        const std::vector<std::string> &names - row names.
+        size_t shards - number of shards.
+        ShardedDB &db - output, the opened database.
+
+    Returns:
+        true on success.
+*/
+static bool build_database(const std::string &path,
+                           const std::vector<std::string> &names,
+                           size_t shards, ShardedDB &db) {
+    FeatureDB fdb;
+    fdb.task_id = 2;
+    for (size_t i = 0; i < names.size(); i++)
+        feature_db_append(fdb, names[i], {(float)i, 1.0f});
+    const bool ok = shards > 1 ? write_sharded_db(path, fdb, shards, true)
+                               : save_feature_db(path, fdb);
+    return ok && open_sharded_db(path, db);
+}
+
+/*
+    main
+
+    Check lookups on flat and recursive databases, plain and sharded.
+
+    Returns:
+        0 if every lookup matches, 1 otherwise.
+*/
+int main() {
+    namespace fs = std::filesystem;
+    const fs::path dir =
+        fs::temp_directory_path() / ("cbir_row_lookup_" +
+                                     std::to_string((long)::getpid()));
+    fs::create_directories(dir);
+
+    const std::vector<std::string> flat = {"x.jpg", "y.jpg", "z.jpg"};
+    const std::vector<std::string> nested = {"sub/deep/y.jpg", "sub/x.jpg",
+                                             "x.jpg", "z.jpg"};
+    for (size_t shards : {1, 3}) {
+        const std::string suffix = std::to_string(shards);
+        ShardedDB flat_db, nested_db;
+        if (!build_database((dir / ("flat" + suffix)).string(), flat, shards,
+                            flat_db) ||
+            !build_database((dir / ("nested" + suffix)).string(), nested,
+                            shards, nested_db)) {
+            std::fprintf(stderr, "FAIL cannot write test databases in %s\n",
+                         dir.string().c_str());
+            failures++;
+            break;
+        }
+        check_database(flat_db, false);
+        check_database(nested_db, true);
+    }
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("all targets matched their rows\n");
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+    Ding, Junrui
+    Februray 2026
+
+    CS5330 Project 2 - test_task4_feature.cpp
+
+    This file checks the fused Task 4 extractor against the pipeline it
+    replaced: cv::cvtColor to gray, cv::Sobel, cv::magnitude, cv::minMaxLoc
+    and cv::phase over whole images, with the Task 2 rg histogram for the
+    color part. Every bin must match exactly. Each image given on the
+    command line is checked whole and as crops whose widths hit short
+    rows and SIMD tails, together with a synthetic noise image. Crops
+    under PHASE_MIN_LEN pixels are skipped: on those the reference's
+    cv::magnitude and cv::phase take their scalar loops, which may differ
+    in the last bit. ctest runs it with IPP on and off (OPENCV_IPP).
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "../include/features.h"
+
+// crop widths and heights: single pixels, short rows, and odd lengths
+// either side of the SIMD block sizes
+static const int SIZES[] = {1, 2, 7, 31, 33, 97};
+
+// smallest crop checked (see features.cpp)
+#define PHASE_MIN_LEN 32
+
+static int failures = 0;
+
+/*
+    reference_texture
+
+    Magnitude and orientation histograms computed as the original
+    per-part Task 4 extractors did, from whole-image OpenCV calls.
+
+    Arguments:
+        const cv::Mat &img - input image (BGR, 8-bit).
+        int mag_bins - magnitude bins.
+        int ori_bins - orientation bins.
+        std::vector<float> &hist - output, mag_bins + ori_bins values.
+
+    Returns:
+        void.
+*/
+static void reference_texture(const cv::Mat &img, int mag_bins, int ori_bins,
+                              std::vector<float> &hist) {
+    cv::Mat gray;
+    cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat gx, gy;
+    cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
+    cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
+
+    cv::Mat mag, ang;
+    cv::magnitude(gx, gy, mag);
+    cv::phase(gx, gy, ang, true);
+    double maxv = 0.0;
+    cv::minMaxLoc(mag, nullptr, &maxv);
+    const float denom = (float)(maxv + 1e-6);
+
+    std::vector<float> m(mag_bins, 0.0f), o(ori_bins, 0.0f);
+    for (int i = 0; i < img.rows; i++) {
+        const float *mp = mag.ptr<float>(i);
+        const float *ap = ang.ptr<float>(i);
+        for (int j = 0; j < img.cols; j++) {
+            const float v = std::clamp(mp[j] / denom, 0.0f, 1.0f);
+            m[std::min((int)(v * mag_bins), mag_bins - 1)] += 1.0f;
+
+            float a = ap[j];
+            if (a >= 180.0f)
+                a -= 180.0f;
+            float t = a / 180.0f;
+            if (t < 0.0f)
+                t = 0.0f;
+            if (t >= 1.0f)
+                t = std::nextafter(1.0f, 0.0f);
+            o[std::min((int)(t * ori_bins), ori_bins - 1)] += 1.0f;
+        }
+    }
+
+    const float total = (float)(img.rows * img.cols);
+    hist.clear();
+    for (const float c : m)
+        hist.push_back(c / total);
+    for (const float c : o)
+        hist.push_back(c / total);
+}
+
+/*
+    check_image
+
+    Compare compute_task4_feature with the reference on one image.
+
+    Arguments:
+        const std::string &what - image description for the report.
+        const cv::Mat &img - input image (BGR, 8-bit).
+
+    Returns:
+        void.
+*/
+static void check_image(const std::string &what, const cv::Mat &img) {
+    std::vector<float> feat, color, texture;
+    if (!compute_task4_feature(img, feat) || feat.size() != 256 + 16 + 18 ||
+        !compute_task2_feature_rg_hist(img, color, 16)) {
+        std::fprintf(stderr, "FAIL %s (%d x %d): no feature\n", what.c_str(),
+                     img.cols, img.rows);
+        failures++;
+        return;
+    }
+    reference_texture(img, 16, 18, texture);
+
+    std::vector<float> want = color;
+    want.insert(want.end(), texture.begin(), texture.end());
+    for (size_t i = 0; i < want.size(); i++) {
+        if (feat[i] == want[i])
+            continue;
+        std::fprintf(stderr, "FAIL %s (%d x %d): bin %zu got %.9g, want %.9g\n",
+                     what.c_str(), img.cols, img.rows, i, feat[i], want[i]);
+        failures++;
+        return;
+    }
+}
+
+/*
+    check_crops
+
+    Check an image whole and as top-left crops of every SIZES width and
+    height that fits and has at least PHASE_MIN_LEN pixels.
+
+    Arguments:
+        const std::string &what - image description for the report.
+        const cv::Mat &img - input image (BGR, 8-bit).
+
+    Returns:
+        void.
+*/
+static void check_crops(const std::string &what, const cv::Mat &img) {
+    check_image(what, img);
+    for (const int w : SIZES)
+        for (const int h : SIZES)
+            if (w <= img.cols && h <= img.rows && w * h >= PHASE_MIN_LEN)
+                check_image(what + " crop",
+                            img(cv::Rect(0, 0, w, h)).clone());
+}
+
+/*
+    main
+
+    Check the Task 4 extractor on the given images and a noise image.
+    Usage: ./test_task4_feature [image ...]
+
+    Arguments:
+        int argc - argument count.
+        char **argv - argument values.
+
+    Returns:
+        0 if every feature matches, 1 otherwise.
+*/
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const cv::Mat img = cv::imread(argv[i], cv::IMREAD_COLOR);
+        if (img.empty()) {
+            std::fprintf(stderr, "FAIL cannot read %s\n", argv[i]);
+            failures++;
+            continue;
+        }
+        check_crops(argv[i], img);
+    }
+
+    // uniform noise: gradients in every direction and of every size
+    std::mt19937 rng(5330);
+    cv::Mat noise(101, 67, CV_8UC3);
+    for (int i = 0; i < noise.rows; i++) {
+        uchar *p = noise.ptr<uchar>(i);
+        for (int j = 0; j < 3 * noise.cols; j++)
+            p[j] = (uchar)(rng() & 0xff);
+    }
+    check_crops("noise", noise);
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d Task 4 feature mismatches\n", failures);
+        return 1;
+    }
+    std::printf("Task 4 features match the OpenCV pipeline\n");
+    return 0;
+}